@@ -0,0 +1,248 @@
+/**
+ * @file    pipeline_bench.c
+ * @brief   End to end benchmark of the publish pipeline on the host.
+ * 
+ * Synthetic controller reports from the report generator (rep_gen.h) are
+ * pushed through the same path the firmware uses: load_stadia_rep,
+ * ingest_stadia_rep into the report queue, batch dequeue and
+ * update_controller_batch formatting the output into the shim UART. The
+ * generator and clock are deterministic, so two runs of the same build with
+ * the same options emit the same bytes.
+ * 
+ * Usage: pipeline_bench [-n reports] [-f asc|bin] [-b batch] [-c] [-o file]
+ *                       [-s seed] [-w rest,sweep,circle,ramp,mash]
+ *   -n  Number of reports, default 2000000.
+ *   -f  Output format, default asc.
+ *   -b  Reports ingested between drains of the queue, default 4.
+ *   -c  Enable conflation in the report queue.
+ *   -o  Write the emitted bytes to a file, to compare output between builds.
+ *   -s  Seed of the report generator, default 1.
+ *   -w  Weights of the generator's scenarios, default 1,1,1,1,1. For the
+ *       worst case, e.g. 0,0,1,0,0 keeps both sticks moving on every report.
+ * 
+ * Throughput, heap allocations during the run (when built with the malloc
+ * wrappers) and the bytes and writes emitted are printed to stdout.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "rep_queue.h"
+#include "rep_gen.h"
+#include "con_state.h"
+#include "globalconst.h"
+#include "host_shim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Reports dequeued at once, as in main.c
+#define BENCH_BATCH_LEN 16
+
+// The global report queue, defined by main.c in the firmware
+RepQueue_t *repQueue;
+
+#ifdef BENCH_WRAP_MALLOC
+// Heap calls made while counting is enabled. The benchmark is linked with
+// --wrap for each of these functions so every call reaches the wrappers.
+static volatile int allocCounting = 0;
+static unsigned long allocCalls = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void* ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    if (allocCounting) {
+        allocCalls++;
+    }
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    if (allocCounting) {
+        allocCalls++;
+    }
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void* ptr, size_t size) {
+    if (allocCounting) {
+        allocCalls++;
+    }
+    return __real_realloc(ptr, size);
+}
+#endif
+
+// Time of the pipeline clock
+static int64_t benchNow = 0;
+
+/**
+ * @brief The clock of the pipeline, advanced by the generator.
+ * 
+ * @return The time in microseconds.
+*/
+static int64_t bench_clock(void) {
+    return benchNow;
+}
+
+/**
+ * @brief Read the monotonic clock.
+ * 
+ * @return The time in seconds.
+*/
+static double wall_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Move every pending report through the controller state.
+ * 
+ * @param state The controller state.
+*/
+static void drain(ConState_t* state) {
+    StadiaRep_t batch[BENCH_BATCH_LEN];
+    size_t count;
+    while ((count = dequeue_stadia_rep_batch(repQueue, batch,
+                                             BENCH_BATCH_LEN)) > 0) {
+        update_controller_batch(state, batch, count);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    unsigned long reports = 2000000;
+    unsigned long drain_every = 4;
+    bool conflate = false;
+    const char *out_path = NULL;
+    RepGenCfg_t gen_cfg;
+    rep_gen_default_cfg(&gen_cfg, 1);
+    int opt;
+    while ((opt = getopt(argc, argv, "n:f:b:co:s:w:")) != -1) {
+        switch (opt) {
+            case 'n':
+                reports = strtoul(optarg, NULL, 10);
+                break;
+            case 'f':
+                if (strcmp(optarg, "asc") == 0) {
+                    output_format = OUTPUT_ASCII;
+                } else if (strcmp(optarg, "bin") == 0) {
+                    output_format = OUTPUT_BINARY;
+                } else {
+                    fprintf(stderr, "unknown format %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'b':
+                drain_every = strtoul(optarg, NULL, 10);
+                break;
+            case 'c':
+                conflate = true;
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            case 's':
+                gen_cfg.seed = strtoul(optarg, NULL, 10);
+                break;
+            case 'w': {
+                // Comma separated weights, in RepGenScenario_t order
+                char *pos = optarg;
+                for (int i = 0; i < REP_GEN_NUM_SCENARIOS; i++) {
+                    gen_cfg.weights[i] = strtoul(pos, &pos, 10);
+                    if (*pos == ',') {
+                        pos++;
+                    }
+                }
+                break;
+            }
+            default:
+                fprintf(stderr, "usage: %s [-n reports] [-f asc|bin] "
+                        "[-b batch] [-c] [-o file] [-s seed] "
+                        "[-w rest,sweep,circle,ramp,mash]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (drain_every == 0 || drain_every > REP_QUEUE_LEN) {
+        fprintf(stderr, "batch must be 1-%d\n", REP_QUEUE_LEN);
+        return 1;
+    }
+
+    set_rep_clock(bench_clock);
+    repQueue = create_stadia_rep_queue(xTaskGetCurrentTaskHandle(),
+                                       REP_QUEUE_LEN, REP_QUEUE_DROP_NEWEST, 0);
+    if (repQueue == NULL) {
+        fprintf(stderr, "invalid report queue configuration\n");
+        return 1;
+    }
+    set_rep_queue_conflation(repQueue, conflate);
+    static ConState_t state;
+    init_controller(&state);
+    host_uart_capture(out_path != NULL);
+    host_uart_reset();
+
+    static RepGen_t gen;
+    rep_gen_init(&gen, &gen_cfg);
+    uint8_t raw[STADIA_REP_LEN];
+    StadiaRep_t rep;
+#ifdef BENCH_WRAP_MALLOC
+    allocCounting = 1;
+#endif
+    double start = wall_time();
+    for (unsigned long i = 0; i < reports; i++) {
+        // Through the raw bytes, as the notification handler receives them
+        rep_gen_next(&gen, &rep);
+        rep_gen_raw(&rep, raw);
+        benchNow = gen.now_us;
+        rep.stamp_us = (uint32_t) benchNow;
+        if (load_stadia_rep(&rep, raw, sizeof(raw))) {
+            ingest_stadia_rep(repQueue, &rep);
+        }
+        if ((i + 1) % drain_every == 0) {
+            drain(&state);
+        }
+    }
+    drain(&state);
+    double elapsed = wall_time() - start;
+#ifdef BENCH_WRAP_MALLOC
+    allocCounting = 0;
+#endif
+
+    RepQueueStats_t stats;
+    get_rep_queue_stats(repQueue, &stats);
+    uint64_t bytes = host_uart_bytes();
+    uint64_t writes = host_uart_writes();
+    printf("reports      %lu\n", reports);
+    printf("seconds      %.3f\n", elapsed);
+    printf("reports/s    %.0f\n", reports / elapsed);
+    printf("ns/report    %.1f\n", elapsed * 1e9 / reports);
+#ifdef BENCH_WRAP_MALLOC
+    printf("allocations  %lu\n", allocCalls);
+#else
+    printf("allocations  n/a\n");
+#endif
+    printf("bytes        %llu\n", (unsigned long long) bytes);
+    printf("bytes/report %.2f\n", (double) bytes / reports);
+    printf("uart writes  %llu\n", (unsigned long long) writes);
+    printf("enqueued     %lu\n", (unsigned long) stats.enqueued);
+    printf("dropped      %lu\n", (unsigned long) stats.dropped);
+    printf("conflated    %lu\n", (unsigned long) stats.conflated);
+    printf("duplicates   %lu\n", (unsigned long) stats.duplicates);
+
+    if (out_path != NULL) {
+        size_t len;
+        const uint8_t *out = host_uart_output(&len);
+        FILE *file = fopen(out_path, "wb");
+        if (file == NULL || fwrite(out, 1, len, file) != len) {
+            fprintf(stderr, "could not write %s\n", out_path);
+            return 1;
+        }
+        fclose(file);
+    }
+    return 0;
+}
@@ -0,0 +1,310 @@
+/**
+ * @file    queue_bench.c
+ * @brief   Throughput of the report queue against the linked list it replaced.
+ * 
+ * Both queues are driven the way the firmware drives them. The linked list
+ * queue is the one the firmware used before the ring: every report and every
+ * list element is allocated on the heap, a mutex guards the list, and a
+ * counting semaphore given per insert wakes the consumer, which dequeues and
+ * frees one report per take. The ring is the report queue of rep_queue.h,
+ * with the consumer woken by task notifications and draining in batches.
+ * 
+ * Usage: queue_bench [-n reports] [-b batch] [-t]
+ *   -n  Number of reports, default 2000000.
+ *   -b  Reports inserted between drains of the queue, default 4.
+ *   -t  Insert from a producer task while the main task consumes, instead of
+ *       alternating both in one thread. The ring blocks the producer while it
+ *       is full, so no report is dropped.
+ * 
+ * The reports per second and time per report of each queue are printed to
+ * stdout, with the reports never consumed. The firmware's semaphore counted
+ * at most INT8_MAX reports; here it counts every report of the run, so a
+ * lagging consumer does not leave reports in the list and both queues are
+ * timed on the same work.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "rep_queue.h"
+#include "globalconst.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Reports dequeued at once, as in main.c
+#define BENCH_BATCH_LEN 16
+
+// The global report queue, defined by main.c in the firmware
+RepQueue_t *repQueue;
+
+/**
+ * @brief An element of the linked list queue.
+*/
+typedef struct ListElement {
+    StadiaRep_t *rep;
+    struct ListElement *next;
+} ListElement_t;
+
+/**
+ * @brief The linked list queue, as the firmware used to queue reports.
+*/
+static struct {
+    ListElement_t *head;
+    ListElement_t *tail;
+    size_t size;
+    SemaphoreHandle_t mutex;    // Guards the list
+    SemaphoreHandle_t sem;      // Counts the reports queued
+} list;
+
+// Settings of the run
+static unsigned long reports = 2000000;
+static unsigned long drain_every = 4;
+
+// Set by the producer task once every report is inserted
+static atomic_bool produced;
+
+/**
+ * @brief Read the monotonic clock.
+ * 
+ * @return The time in seconds.
+*/
+static double wall_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Fill in the raw bytes of the i-th report.
+ * 
+ * @param raw The report bytes.
+ * @param i The number of the report.
+*/
+static void make_raw(uint8_t raw[STADIA_REP_LEN], unsigned long i) {
+    memset(raw, 0x80, STADIA_REP_LEN);
+    raw[0] = 0x08;
+    raw[3] = (uint8_t) i;
+}
+
+/**
+ * @brief Load a report onto the heap and queue it on the linked list.
+ * 
+ * @param raw The report bytes.
+*/
+static void list_insert(const uint8_t raw[STADIA_REP_LEN]) {
+    StadiaRep_t *rep = malloc(sizeof(StadiaRep_t));
+    if (rep == NULL || !load_stadia_rep(rep, raw, STADIA_REP_LEN)) {
+        free(rep);
+        return;
+    }
+    xSemaphoreTake(list.mutex, portMAX_DELAY);
+    ListElement_t *element = malloc(sizeof(ListElement_t));
+    if (element == NULL) {
+        xSemaphoreGive(list.mutex);
+        free(rep);
+        return;
+    }
+    element->rep = rep;
+    element->next = NULL;
+    if (list.size == 0) {
+        list.head = element;
+    } else {
+        list.tail->next = element;
+    }
+    list.tail = element;
+    list.size++;
+    xSemaphoreGive(list.mutex);
+    xSemaphoreGive(list.sem);
+}
+
+/**
+ * @brief Take the oldest report off the linked list.
+ * 
+ * @return The report, to be freed by the caller, or NULL if none is queued.
+*/
+static StadiaRep_t *list_dequeue(void) {
+    xSemaphoreTake(list.mutex, portMAX_DELAY);
+    if (list.size == 0) {
+        xSemaphoreGive(list.mutex);
+        return NULL;
+    }
+    ListElement_t *element = list.head;
+    StadiaRep_t *rep = element->rep;
+    list.head = element->next;
+    free(element);
+    list.size--;
+    xSemaphoreGive(list.mutex);
+    return rep;
+}
+
+/**
+ * @brief Consume every report queued on the linked list, one per take.
+ * 
+ * @param wait How long to wait for the first report.
+ * @return The number of reports consumed.
+*/
+static unsigned long list_drain(TickType_t wait) {
+    unsigned long count = 0;
+    while (xSemaphoreTake(list.sem, count == 0 ? wait : 0) == pdTRUE) {
+        StadiaRep_t *rep = list_dequeue();
+        if (rep != NULL) {
+            count++;
+            free(rep);
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Load a report and insert it into the ring.
+ * 
+ * @param raw The report bytes.
+*/
+static void ring_insert(const uint8_t raw[STADIA_REP_LEN]) {
+    StadiaRep_t rep;
+    if (load_stadia_rep(&rep, raw, STADIA_REP_LEN)) {
+        insert_stadia_rep(repQueue, &rep);
+    }
+}
+
+/**
+ * @brief Consume every report queued in the ring, in batches.
+ * 
+ * @param wait How long to wait for a notification first.
+ * @return The number of reports consumed.
+*/
+static unsigned long ring_drain(TickType_t wait) {
+    if (wait > 0) {
+        xTaskNotifyWait(0, REP_QUEUE_NOTIFY_BIT, NULL, wait);
+    }
+    StadiaRep_t batch[BENCH_BATCH_LEN];
+    unsigned long count = 0;
+    size_t got;
+    while ((got = dequeue_stadia_rep_batch(repQueue, batch,
+                                           BENCH_BATCH_LEN)) > 0) {
+        count += got;
+    }
+    return count;
+}
+
+/**
+ * @brief A queue under test.
+*/
+typedef struct BenchQueue {
+    const char *name;                      // Printed with the results.
+    void (*insert)(const uint8_t *);       // Inserts one report.
+    unsigned long (*drain)(TickType_t);    // Consumes every queued report.
+} BenchQueue_t;
+
+// The queues, in the order they are run
+static const BenchQueue_t queues[] = {
+    {"list", list_insert, list_drain},
+    {"ring", ring_insert, ring_drain},
+};
+
+/**
+ * @brief Producer task inserting every report into one of the queues.
+ * 
+ * @param arg The BenchQueue_t to insert into.
+*/
+static void producer_task(void* arg) {
+    const BenchQueue_t *queue = arg;
+    uint8_t raw[STADIA_REP_LEN];
+    for (unsigned long i = 0; i < reports; i++) {
+        make_raw(raw, i);
+        queue->insert(raw);
+    }
+    atomic_store(&produced, true);
+}
+
+/**
+ * @brief Run every report through one of the queues and print the results.
+ * 
+ * @param queue The queue.
+ * @param threaded Insert from a producer task instead of the main task.
+*/
+static void run(const BenchQueue_t* queue, bool threaded) {
+    unsigned long consumed = 0;
+    double start = wall_time();
+    if (threaded) {
+        atomic_store(&produced, false);
+        if (xTaskCreate(producer_task, "producer", 4096, (void *) queue, 1,
+                        NULL) != pdPASS) {
+            fprintf(stderr, "could not start the producer\n");
+            exit(1);
+        }
+        // Checking produced before draining catches the last reports
+        bool done = false;
+        while (!done) {
+            done = atomic_load(&produced);
+            consumed += queue->drain(pdMS_TO_TICKS(10));
+        }
+    } else {
+        uint8_t raw[STADIA_REP_LEN];
+        for (unsigned long i = 0; i < reports; i++) {
+            make_raw(raw, i);
+            queue->insert(raw);
+            if ((i + 1) % drain_every == 0) {
+                consumed += queue->drain(0);
+            }
+        }
+        consumed += queue->drain(0);
+    }
+    double elapsed = wall_time() - start;
+    printf("%-5s %12.0f %10.1f %10lu\n", queue->name, reports / elapsed,
+           elapsed * 1e9 / reports, reports - consumed);
+}
+
+int main(int argc, char* argv[]) {
+    bool threaded = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:b:t")) != -1) {
+        switch (opt) {
+            case 'n':
+                reports = strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                drain_every = strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                threaded = true;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n reports] [-b batch] [-t]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+    if (drain_every == 0 || drain_every > REP_QUEUE_LEN) {
+        fprintf(stderr, "batch must be 1-%d\n", REP_QUEUE_LEN);
+        return 1;
+    }
+
+    list.mutex = xSemaphoreCreateMutex();
+    list.sem = xSemaphoreCreateCounting(reports, 0);
+    repQueue = create_stadia_rep_queue(xTaskGetCurrentTaskHandle(),
+                                       REP_QUEUE_LEN, REP_QUEUE_BLOCK,
+                                       portMAX_DELAY);
+    if (repQueue == NULL) {
+        fprintf(stderr, "invalid report queue configuration\n");
+        return 1;
+    }
+
+    printf("%lu reports, %s\n", reports,
+           threaded ? "producer task" : "one thread");
+    printf("queue     reports/s  ns/report       lost\n");
+    for (size_t i = 0; i < sizeof(queues) / sizeof(queues[0]); i++) {
+        run(&queues[i], threaded);
+    }
+    return 0;
+}
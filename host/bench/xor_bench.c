@@ -0,0 +1,401 @@
+/**
+ * @file    xor_bench.c
+ * @brief   Cost of update_controller against the update path it replaced,
+ *          with and without the XOR skip.
+ * 
+ * The original update path is the one the firmware used before the XOR skip:
+ * every report makes all 20 update calls, the sticks and triggers are
+ * converted to float percentages and compared as floats, and each changed
+ * control is formatted into a heap allocated string with snprintf. It is
+ * kept below as it was, except that the IDs hold their terminator.
+ * 
+ * update_controller XORs each report against the previous one and skips the
+ * analog group when it did not change, then compares the changed fields as
+ * integers and formats them from tables. This benchmark times both paths on
+ * reports where nothing, only the buttons, only the sticks or everything
+ * changed. It is built twice: xor_bench with the skip, and xor_bench_noskip
+ * with con_state.c compiled with REP_XOR_SKIP set to 0, so the analog group
+ * is walked for every report. The output is not captured, only counted.
+ * 
+ * Usage: xor_bench [-n reports]
+ *   -n  Number of reports per case, default 5000000.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "rep_queue.h"
+#include "con_state.h"
+#include "globalconst.h"
+#include "host_shim.h"
+
+#include "driver/uart.h"
+#include "rom/ets_sys.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Set to 0 for xor_bench_noskip, along with con_state.c
+#ifndef REP_XOR_SKIP
+#define REP_XOR_SKIP 1
+#endif
+
+// The global report queue, defined by main.c in the firmware
+RepQueue_t *repQueue;
+
+// Time of the pipeline clock, advanced by one report interval per report
+static int64_t benchNow = 0;
+
+/**
+ * @brief The clock of the pipeline.
+ * 
+ * @return The time in microseconds.
+*/
+static int64_t bench_clock(void) {
+    return benchNow;
+}
+
+/**
+ * @brief A button, joystick, trigger and D-pad of the original update path.
+*/
+typedef struct OrigButton {
+    char id[4];
+    bool pressed;
+} OrigButton_t;
+typedef struct OrigJoystick {
+    char id[4];
+    float x;
+    float y;
+} OrigJoystick_t;
+typedef struct OrigTrigger {
+    char id[4];
+    float val;
+} OrigTrigger_t;
+typedef struct OrigDPad {
+    char id[4];
+    uint8_t dir;
+} OrigDPad_t;
+
+/**
+ * @brief The controller state of the original update path.
+*/
+typedef struct OrigConState {
+    OrigButton_t LAB, LBB, LXB, LYB, LTB, RTB, RSB, LSB, STB, MEN, CPT, GAS,
+                 OPT, RBP, LBP;
+    OrigJoystick_t LJS, RJS;
+    OrigTrigger_t LTR, RTR;
+    OrigDPad_t DPD;
+} OrigConState_t;
+
+static float orig_sign_pct(uint8_t val) {
+    return (float) ((int)val - 128) / 128.0 * 100.0;
+}
+
+static float orig_unsign_pct(uint8_t val) {
+    return (float) val / 255.0 * 100.0;
+}
+
+static char *orig_str_of_button(OrigButton_t* button) {
+    char *str_bldr = malloc(sizeof(char) * 7);
+    char *place = str_bldr;
+    strncpy(str_bldr, button->id, 3);
+    place += 3;
+    strcpy(place, ";");
+    place += 1;
+    strcpy(place, button->pressed ? "1" : "0");
+    place += 1;
+    strcpy(place, "\n");
+    return str_bldr;
+}
+
+static char *orig_str_of_joystick(OrigJoystick_t* joystick) {
+    char *str_bldr = malloc(sizeof(char) * 19);
+    char *place = str_bldr;
+    strncpy(str_bldr, joystick->id, 3);
+    place += strlen(joystick->id);
+    strcpy(place, ";");
+    place += 1;
+    char *x_str = malloc(sizeof(char) * 6);
+    snprintf(x_str, 6, "%.2f", joystick->x);
+    strcpy(place, x_str);
+    place += strlen(x_str);
+    free(x_str);
+    strcpy(place, ";");
+    place += 1;
+    char *y_str = malloc(sizeof(char) * 6);
+    snprintf(y_str, 6, "%.2f", joystick->y);
+    strcpy(place, y_str);
+    place += strlen(y_str);
+    free(y_str);
+    strcpy(place, "\n");
+    return str_bldr;
+}
+
+static char *orig_str_of_trigger(OrigTrigger_t* trigger) {
+    char *str_bldr = malloc(sizeof(char) * 11);
+    char *place = str_bldr;
+    char *extnt_str = malloc(sizeof(char) * 6);
+    strncpy(str_bldr, trigger->id, 3);
+    place += 3;
+    strcpy(place, ";");
+    place += 1;
+    snprintf(extnt_str, 6, "%.2f", trigger->val);
+    strcpy(place, extnt_str);
+    place += strlen(extnt_str);
+    free(extnt_str);
+    strcpy(place, "\n");
+    return str_bldr;
+}
+
+static char *orig_str_of_dpad(OrigDPad_t* dpad) {
+    static const char *const dirs[] = {
+        "N", "NE", "E", "SE", "S", "SW", "W", "NW", "NO",
+    };
+    char *str_bldr = malloc(sizeof(char) * 7);
+    char *place = str_bldr;
+    strncpy(str_bldr, dpad->id, 3);
+    place += strlen(dpad->id);
+    strcpy(place, ";");
+    place += 1;
+    const char *dir_str = dirs[dpad->dir <= 8 ? dpad->dir : 8];
+    strcpy(place, dir_str);
+    place += strlen(dir_str);
+    strcpy(place, "\n");
+    return str_bldr;
+}
+
+/**
+ * @brief Write a message of the original update path to the UART and free it.
+ * 
+ * @param msg The message.
+*/
+static void orig_publish(char* msg) {
+    if (UART_DEBUG) {
+        ets_printf("%s", msg);
+    }
+    uart_write_bytes(uart_num, msg, strlen(msg));
+    free(msg);
+}
+
+static void orig_update_button(OrigButton_t* button, bool value, bool publish) {
+    if (button->pressed == value) {
+        return;
+    }
+    button->pressed = value;
+    if (publish) {
+        orig_publish(orig_str_of_button(button));
+    }
+}
+
+static void orig_update_joystick(OrigJoystick_t* joystick, float x, float y,
+                                 bool publish) {
+    if (joystick->x == x && joystick->y == y) {
+        return;
+    }
+    joystick->x = x;
+    joystick->y = y;
+    if (publish) {
+        orig_publish(orig_str_of_joystick(joystick));
+    }
+}
+
+static void orig_update_trigger(OrigTrigger_t* trigger, float value,
+                                bool publish) {
+    if (trigger->val == value) {
+        return;
+    }
+    trigger->val = value;
+    if (publish) {
+        orig_publish(orig_str_of_trigger(trigger));
+    }
+}
+
+static void orig_update_dpad(OrigDPad_t* dpad, uint8_t dir, bool publish) {
+    if (dpad->dir == dir) {
+        return;
+    }
+    dpad->dir = dir;
+    if (publish) {
+        orig_publish(orig_str_of_dpad(dpad));
+    }
+}
+
+static void orig_init_controller(OrigConState_t* state) {
+    *state = (OrigConState_t) {
+        .LAB = {"LAB", false}, .LBB = {"LBB", false}, .LXB = {"LXB", false},
+        .LYB = {"LYB", false}, .LTB = {"LTB", false}, .RTB = {"RTB", false},
+        .RSB = {"RSB", false}, .LSB = {"LSB", false}, .STB = {"STB", false},
+        .MEN = {"MEN", false}, .CPT = {"CPT", false}, .GAS = {"GAS", false},
+        .OPT = {"OPT", false}, .RBP = {"RBP", false}, .LBP = {"LBP", false},
+        .LJS = {"LJS", 0.0, 0.0}, .RJS = {"RJS", 0.0, 0.0},
+        .LTR = {"LTR", 0.0}, .RTR = {"RTR", 0.0},
+        .DPD = {"DPD", 0x08},
+    };
+}
+
+static void orig_update_controller(OrigConState_t* state, StadiaRep_t* rep) {
+    orig_update_dpad(&state->DPD, rep->dpad, publish_controls[0]);
+
+    orig_update_button(&state->RSB, (rep->buttons1 & 0x80) != 0,
+                       publish_controls[1]);
+    orig_update_button(&state->OPT, (rep->buttons1 & 0x40) != 0,
+                       publish_controls[2]);
+    orig_update_button(&state->MEN, (rep->buttons1 & 0x20) != 0,
+                       publish_controls[3]);
+    orig_update_button(&state->STB, (rep->buttons1 & 0x10) != 0,
+                       publish_controls[4]);
+    orig_update_button(&state->RTB, (rep->buttons1 & 0x08) != 0,
+                       publish_controls[5]);
+    orig_update_button(&state->LTB, (rep->buttons1 & 0x04) != 0,
+                       publish_controls[6]);
+    orig_update_button(&state->GAS, (rep->buttons1 & 0x02) != 0,
+                       publish_controls[7]);
+    orig_update_button(&state->CPT, (rep->buttons1 & 0x01) != 0,
+                       publish_controls[8]);
+    orig_update_button(&state->LAB, (rep->buttons2 & 0x40) != 0,
+                       publish_controls[9]);
+    orig_update_button(&state->LBB, (rep->buttons2 & 0x20) != 0,
+                       publish_controls[10]);
+    orig_update_button(&state->LXB, (rep->buttons2 & 0x10) != 0,
+                       publish_controls[11]);
+    orig_update_button(&state->LYB, (rep->buttons2 & 0x08) != 0,
+                       publish_controls[12]);
+    orig_update_button(&state->LBP, (rep->buttons2 & 0x04) != 0,
+                       publish_controls[13]);
+    orig_update_button(&state->RBP, (rep->buttons2 & 0x02) != 0,
+                       publish_controls[14]);
+    orig_update_button(&state->LSB, (rep->buttons2 & 0x01) != 0,
+                       publish_controls[15]);
+
+    orig_update_joystick(&state->LJS, orig_sign_pct(rep->stickX),
+                         -orig_sign_pct(rep->stickY), publish_controls[16]);
+    orig_update_joystick(&state->RJS, orig_sign_pct(rep->stickZ),
+                         -orig_sign_pct(rep->stickRz), publish_controls[17]);
+
+    orig_update_trigger(&state->LTR, orig_unsign_pct(rep->brake),
+                        publish_controls[18]);
+    orig_update_trigger(&state->RTR, orig_unsign_pct(rep->throttle),
+                        publish_controls[19]);
+}
+
+/**
+ * @brief Read the monotonic clock.
+ * 
+ * @return The time in seconds.
+*/
+static double wall_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief The parts of a report that change between reports in a case.
+*/
+typedef enum BenchChange {
+    CHANGE_NONE,     // Every report is the same
+    CHANGE_BUTTONS,  // The A button toggles
+    CHANGE_STICKS,   // Both sticks move past their threshold
+    CHANGE_ALL,      // The buttons, sticks and triggers all change
+    NUM_CHANGES
+} BenchChange_t;
+
+// Names of the cases, indexed by BenchChange_t
+static const char *const change_names[NUM_CHANGES] = {
+    "unchanged", "buttons", "sticks", "all",
+};
+
+/**
+ * @brief Build the i-th report of a case.
+ * 
+ * @param change What changes between reports.
+ * @param i The number of the report.
+ * @param rep Filled in with the report.
+*/
+static void make_rep(BenchChange_t change, unsigned long i, StadiaRep_t* rep) {
+    uint8_t flip = i % 2;
+    rep->dpad = 0x08;
+    rep->buttons1 = 0x00;
+    rep->buttons2 = 0x00;
+    rep->stickX = 0xC0;
+    rep->stickY = 0x40;
+    rep->stickZ = 0xC0;
+    rep->stickRz = 0x40;
+    rep->brake = 0x00;
+    rep->throttle = 0x00;
+    rep->volume = 0x00;
+    if (change == CHANGE_BUTTONS || change == CHANGE_ALL) {
+        rep->buttons2 = flip ? 0x40 : 0x00;
+    }
+    if (change == CHANGE_STICKS || change == CHANGE_ALL) {
+        rep->stickX += flip * 0x10;
+        rep->stickRz += flip * 0x10;
+    }
+    if (change == CHANGE_ALL) {
+        rep->brake = flip ? 0xFF : 0x00;
+        rep->throttle = flip ? 0x00 : 0xFF;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    unsigned long reports = 5000000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n':
+                reports = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n reports]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    set_rep_clock(bench_clock);
+    host_uart_capture(false);
+    printf("%lu reports per case, XOR skip %s\n", reports,
+#if REP_XOR_SKIP
+           "on"
+#else
+           "off"
+#endif
+    );
+    printf("case         original ns  update ns  speedup  original B  update B"
+           "\n");
+    static ConState_t state;
+    static OrigConState_t orig;
+    for (int change = 0; change < NUM_CHANGES; change++) {
+        StadiaRep_t reps[2];
+        make_rep(change, 0, &reps[0]);
+        make_rep(change, 1, &reps[1]);
+        double ns[2];
+        double bytes[2];
+        for (int path = 0; path < 2; path++) {
+            init_controller(&state);
+            orig_init_controller(&orig);
+            host_uart_reset();
+            double start = wall_time();
+            for (unsigned long i = 0; i < reports; i++) {
+                // Far enough apart that no rate limit holds a control
+                benchNow += 100000;
+                StadiaRep_t rep = reps[i % 2];
+                rep.stamp_us = (uint32_t) benchNow;
+                if (path == 0) {
+                    orig_update_controller(&orig, &rep);
+                } else {
+                    update_controller(&state, &rep);
+                }
+            }
+            ns[path] = (wall_time() - start) * 1e9 / reports;
+            bytes[path] = (double) host_uart_bytes() / reports;
+        }
+        printf("%-12s %11.1f %10.1f %7.1fx %11.2f %9.2f\n",
+               change_names[change], ns[0], ns[1], ns[0] / ns[1], bytes[0],
+               bytes[1]);
+    }
+    return 0;
+}
@@ -0,0 +1,455 @@
+/**
+ * @file    bt_sim.c
+ * @brief   Run the firmware's BLE code against a scripted peer and measure how
+ *          long it takes to connect, discover and receive the first report.
+ * 
+ * main/ble runs unchanged on the simulated stack of fake_bt.h, started the way
+ * app_main starts it, and every report it receives is passed through the
+ * publish pipeline. The script sets the latency of each step, makes steps
+ * fail, and schedules events of the peer. Once the script's run time has
+ * passed on the simulated clock, the milestones of every connection attempt
+ * are printed along with the time to discover the peer, the time to the first
+ * report and, after each disconnection, the time until reports flowed again.
+ * The connection setup's own measurements of the last connection follow, and
+ * the connection parameters with the report cadence under each kind of them.
+ * 
+ * Usage: bt_sim [-v] [-f asc|bin] script
+ *   -v  Log the delivered GAP and GATT client events to stderr.
+ *   -f  Output format of the pipeline, default asc.
+ * 
+ * Script lines, with times in milliseconds and '#' starting a comment:
+ *   latency <step> <ms>         Latency of a step: privacy, scan_params,
+ *                               scan_start, adv, scan_stop, connect,
+ *                               conn_timeout, auth, encrypt, mtu, search,
+ *                               reg_notify, write_descr or conn_params.
+ *   fail <step> <status>        Answer a step with a status, 0 to succeed.
+ *   name <name>                 Name the peer advertises.
+ *   interval <units>            Connection interval, in units of 1.25 ms.
+ *   min_interval <units>        Shortest interval the peer accepts in an
+ *                               update.
+ *   seed <seed>                 Seed of the peer's reports.
+ *   bonded                      Start with the peer bonded.
+ *   secure_ccc                  The peer refuses to enable notifications
+ *                               until the link is encrypted.
+ *   crowd <devices>             Other devices advertising nearby.
+ *   at <ms> <event> [arg]       Schedule disconnect [reason], srvc_chg,
+ *                               conn_update <units>, adv_on, adv_off, quiet,
+ *                               resume, rest or play.
+ *   run <ms>                    Simulated time to run for, default 10000.
+ *   expect first_report <ms>    Fail unless the first report arrives in time.
+ *   expect reconnect <ms>       Fail unless reports flow again this soon after
+ *                               every disconnection.
+ * 
+ * The exit status is 1 if an expectation failed, so scripts can serve as
+ * regression checks of the connection path.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "fake_bt.h"
+#include "ble/bt_init.h"
+#include "ble/auth_gap.h"
+#include "ble/reconnect.h"
+#include "ble/discover.h"
+#include "ble/conn_setup.h"
+#include "ble/conn_params.h"
+#include "rep_queue.h"
+#include "con_state.h"
+#include "globalconst.h"
+#include "host_shim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Reports dequeued at once, as in main.c
+#define SIM_BATCH_LEN 16
+
+// Longest script line
+#define SIM_LINE_MAX_LEN 128
+
+// The global report queue, defined by main.c in the firmware
+RepQueue_t *repQueue;
+
+// Script names of the steps and events, indexed like FakeBtStep_t and
+// FakeBtAction_t
+static const char *const step_names[FAKE_BT_NUM_STEPS] = {
+    "privacy", "scan_params", "scan_start", "adv", "scan_stop", "connect",
+    "conn_timeout", "auth", "encrypt", "mtu", "search", "reg_notify",
+    "write_descr", "conn_params",
+};
+static const char *const action_names[FAKE_BT_NUM_ACTIONS] = {
+    "disconnect", "srvc_chg", "conn_update", "adv_on", "adv_off", "quiet",
+    "resume", "rest", "play",
+};
+
+/**
+ * @brief What the script asks for beyond the simulation's configuration.
+*/
+typedef struct SimScript {
+    int64_t run_us;             // Simulated time to run for.
+    int64_t first_report_us;    // Latest first report, -1 for no limit.
+    int64_t reconnect_us;       // Longest reconnection, -1 for no limit.
+} SimScript_t;
+
+/**
+ * @brief Find a name in a table.
+ * 
+ * @param names The table.
+ * @param count The number of names.
+ * @param name The name to find.
+ * @return Its index, or -1 if it is not in the table.
+*/
+static int find_name(const char *const* names, int count, const char* name) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(names[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Convert a number of milliseconds to microseconds.
+ * 
+ * @param str The number, which may have a fraction.
+ * @param us Set to the time in microseconds.
+ * @return true if str is a non negative number.
+*/
+static bool parse_ms(const char* str, int64_t* us) {
+    char *end;
+    if (str == NULL) {
+        return false;
+    }
+    double ms = strtod(str, &end);
+    if (*end != '\0' || ms < 0) {
+        return false;
+    }
+    *us = (int64_t) (ms * 1000 + 0.5);
+    return true;
+}
+
+/**
+ * @brief Parse an unsigned number, decimal or hexadecimal with 0x.
+ * 
+ * @param str The number.
+ * @param val Set to the number.
+ * @return true if str is a number.
+*/
+static bool parse_num(const char* str, unsigned long* val) {
+    char *end;
+    if (str == NULL || *str == '-') {
+        return false;
+    }
+    *val = strtoul(str, &end, 0);
+    return *end == '\0';
+}
+
+/**
+ * @brief Read a script, configuring the simulation.
+ * 
+ * @param path The script file.
+ * @param script Set to the rest of the script.
+ * @return true if every line was valid.
+*/
+static bool load_script(const char* path, SimScript_t* script) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+    script->run_us = 10000000;
+    script->first_report_us = -1;
+    script->reconnect_us = -1;
+    char line[SIM_LINE_MAX_LEN];
+    int line_num = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file) != NULL) {
+        line_num++;
+        char *comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        char *fields[4] = {NULL};
+        int count = 0;
+        char *save;
+        for (char *tok = strtok_r(line, " \t\r\n", &save);
+             tok != NULL && count < 4; tok = strtok_r(NULL, " \t\r\n", &save)) {
+            fields[count++] = tok;
+        }
+        if (count == 0) {
+            continue;
+        }
+        int64_t us;
+        unsigned long num;
+        int idx;
+        if (strcmp(fields[0], "latency") == 0 && count == 3 &&
+            (idx = find_name(step_names, FAKE_BT_NUM_STEPS, fields[1])) >= 0 &&
+            parse_ms(fields[2], &us) && us <= UINT32_MAX) {
+            fake_bt_set_latency(idx, us);
+        } else if (strcmp(fields[0], "fail") == 0 && count == 3 &&
+                   (idx = find_name(step_names, FAKE_BT_NUM_STEPS,
+                                    fields[1])) >= 0 &&
+                   parse_num(fields[2], &num) && num <= UINT8_MAX) {
+            fake_bt_set_status(idx, num);
+        } else if (strcmp(fields[0], "name") == 0 && count == 2) {
+            fake_bt_set_name(fields[1]);
+        } else if (strcmp(fields[0], "interval") == 0 && count == 2 &&
+                   parse_num(fields[1], &num) && num >= 6 && num <= 3200) {
+            fake_bt_set_interval(num);
+        } else if (strcmp(fields[0], "min_interval") == 0 && count == 2 &&
+                   parse_num(fields[1], &num) && num >= 6 && num <= 3200) {
+            fake_bt_set_min_interval(num);
+        } else if (strcmp(fields[0], "seed") == 0 && count == 2 &&
+                   parse_num(fields[1], &num)) {
+            fake_bt_set_seed(num);
+        } else if (strcmp(fields[0], "bonded") == 0 && count == 1) {
+            fake_bt_set_bonded(true);
+        } else if (strcmp(fields[0], "secure_ccc") == 0 && count == 1) {
+            fake_bt_set_secure_ccc(true);
+        } else if (strcmp(fields[0], "crowd") == 0 && count == 2 &&
+                   parse_num(fields[1], &num) && num <= FAKE_BT_MAX_CROWD) {
+            fake_bt_set_crowd(num);
+        } else if (strcmp(fields[0], "at") == 0 && count >= 3 &&
+                   parse_ms(fields[1], &us) &&
+                   (idx = find_name(action_names, FAKE_BT_NUM_ACTIONS,
+                                    fields[2])) >= 0) {
+            num = 0;
+            if (idx == FAKE_BT_DISCONNECT) {
+                num = 0x13;
+            }
+            if (count == 4 && !parse_num(fields[3], &num)) {
+                ok = false;
+            } else if (idx == FAKE_BT_CONN_UPDATE &&
+                       (count != 4 || num < 6 || num > 3200)) {
+                ok = false;
+            } else {
+                ok = fake_bt_at(us, idx, num);
+            }
+        } else if (strcmp(fields[0], "run") == 0 && count == 2 &&
+                   parse_ms(fields[1], &us)) {
+            script->run_us = us;
+        } else if (strcmp(fields[0], "expect") == 0 && count == 3 &&
+                   strcmp(fields[1], "first_report") == 0 &&
+                   parse_ms(fields[2], &us)) {
+            script->first_report_us = us;
+        } else if (strcmp(fields[0], "expect") == 0 && count == 3 &&
+                   strcmp(fields[1], "reconnect") == 0 &&
+                   parse_ms(fields[2], &us)) {
+            script->reconnect_us = us;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "%s:%d: invalid line\n", path, line_num);
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+/**
+ * @brief Move every pending report through the controller state.
+ * 
+ * @param state The controller state.
+*/
+static void drain(ConState_t* state) {
+    StadiaRep_t batch[SIM_BATCH_LEN];
+    size_t count;
+    while ((count = dequeue_stadia_rep_batch(repQueue, batch,
+                                             SIM_BATCH_LEN)) > 0) {
+        update_controller_batch(state, batch, count);
+    }
+}
+
+/**
+ * @brief Print a milestone in milliseconds, or '-' if it was not reached.
+ * 
+ * @param us The milestone.
+*/
+static void print_ms(int64_t us) {
+    if (us < 0) {
+        printf(" %10s", "-");
+    } else {
+        printf(" %10.3f", us / 1000.0);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    fake_bt_reset();
+    while ((opt = getopt(argc, argv, "vf:")) != -1) {
+        switch (opt) {
+            case 'v':
+                fake_bt_log(stderr);
+                break;
+            case 'f':
+                if (strcmp(optarg, "asc") == 0) {
+                    output_format = OUTPUT_ASCII;
+                } else if (strcmp(optarg, "bin") == 0) {
+                    output_format = OUTPUT_BINARY;
+                } else {
+                    fprintf(stderr, "unknown format %s\n", optarg);
+                    return 1;
+                }
+                break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+    if (argc - optind != 1) {
+        fprintf(stderr, "usage: %s [-v] [-f asc|bin] script\n", argv[0]);
+        return 1;
+    }
+    SimScript_t script;
+    if (!load_script(argv[optind], &script)) {
+        return 1;
+    }
+
+    // The pipeline runs on the simulated clock
+    set_rep_clock(fake_bt_now);
+    repQueue = create_stadia_rep_queue(xTaskGetCurrentTaskHandle(),
+                                       REP_QUEUE_LEN, REP_QUEUE_DROP_NEWEST, 0);
+    if (repQueue == NULL) {
+        fprintf(stderr, "invalid report queue configuration\n");
+        return 1;
+    }
+    static ConState_t state;
+    init_controller(&state);
+    host_uart_capture(false);
+    host_uart_reset();
+
+    // Start the BLE code as app_main does
+    bt_nvs_init();
+    bt_controller_init();
+    bt_stack_init();
+    bt_mtu_set();
+    gap_profile_init();
+    gattc_profile_init();
+    esp_auth_init();
+    reconnect_init();
+    conn_setup_init();
+    conn_params_init();
+    while (fake_bt_step(script.run_us)) {
+        drain(&state);
+    }
+
+    // Milestones of every connection attempt
+    size_t count;
+    const FakeBtConn_t *conns = fake_bt_conns(&count);
+    printf("%-4s %10s %10s %10s %10s %10s %10s %10s %8s\n", "conn", "open",
+           "connect", "auth", "discover", "subscribe", "report", "disconn",
+           "reports");
+    for (size_t i = 0; i < count; i++) {
+        printf("%-4zu", i);
+        print_ms(conns[i].open_us);
+        print_ms(conns[i].connect_us);
+        print_ms(conns[i].auth_us);
+        print_ms(conns[i].discover_us);
+        print_ms(conns[i].subscribe_us);
+        print_ms(conns[i].first_report_us);
+        print_ms(conns[i].disconnect_us);
+        printf(" %8lu\n", (unsigned long) conns[i].reports);
+    }
+
+    // The first report, and the reconnection after every disconnection
+    bool passed = true;
+    int64_t first_report = -1;
+    int64_t lost = -1;
+    unsigned long reconnects = 0;
+    unsigned long missed = 0;
+    int64_t worst = -1;
+    for (size_t i = 0; i < count; i++) {
+        int64_t report = conns[i].first_report_us;
+        if (report >= 0 && first_report < 0) {
+            first_report = report;
+        }
+        if (report >= 0 && lost >= 0) {
+            reconnects++;
+            if (report - lost > worst) {
+                worst = report - lost;
+            }
+            lost = -1;
+        }
+        if (report >= 0 && conns[i].disconnect_us >= 0) {
+            lost = conns[i].disconnect_us;
+        }
+    }
+    if (lost >= 0) {
+        missed++;
+    }
+    const DiscoverStats_t *disc = discover_get();
+    if (disc->discoveries > 0) {
+        printf("discovered     %lu ms, slowest %lu ms, %lu scan results%s\n",
+               (unsigned long) disc->last_ms, (unsigned long) disc->max_ms,
+               (unsigned long) disc->results,
+               disc->whitelisted ? ", whitelisted" : "");
+    }
+    if (first_report >= 0) {
+        printf("first report   %.3f ms\n", first_report / 1000.0);
+    } else {
+        printf("first report   never\n");
+    }
+    printf("reconnects     %lu", reconnects);
+    if (worst >= 0) {
+        printf(", slowest %.3f ms", worst / 1000.0);
+    }
+    if (missed > 0) {
+        printf(", last disconnection never recovered");
+    }
+    printf("\n");
+    const ReconnectStats_t *recon = reconnect_get();
+    printf("direct opens   %lu, scans %lu\n", (unsigned long) recon->attempts,
+           (unsigned long) recon->scans);
+    const ConnSetupStats_t *setup = conn_setup_get();
+    if (setup->setups > 0) {
+        printf("setup          %lu ms from open, %lu ms from boot%s\n",
+               (unsigned long) setup->connect_ms,
+               (unsigned long) setup->boot_ms,
+               setup->cached ? ", cached handles" : "");
+        printf("setup phases   search %lu ms, subscribe %lu ms, wait %lu ms, "
+               "encrypted at %lu ms\n",
+               (unsigned long) setup->phase_ms[SETUP_SEARCH],
+               (unsigned long) setup->phase_ms[SETUP_SUBSCRIBE],
+               (unsigned long) setup->phase_ms[SETUP_WAIT_REPORT],
+               (unsigned long) setup->encrypt_ms);
+    }
+    printf("setup retries  %lu, timeouts %lu, failures %lu\n",
+           (unsigned long) setup->retries, (unsigned long) setup->timeouts,
+           (unsigned long) setup->failures);
+    const ConnParamsStats_t *params = conn_params_get();
+    printf("conn params    interval %u, latency %u, fastest accepted %u, "
+           "%lu requests, %lu refused, relaxed %lu, tightened %lu\n",
+           params->interval, params->latency, params->fast_interval,
+           (unsigned long) params->requests, (unsigned long) params->refused,
+           (unsigned long) params->relaxed, (unsigned long) params->tightened);
+    static const char *const mode_names[CONN_PARAMS_NUM_MODES] = {
+        "controller", "fast", "idle",
+    };
+    for (int i = 0; i < CONN_PARAMS_NUM_MODES; i++) {
+        if (params->reports[i] > 0) {
+            printf("cadence %-10s %.3f ms over %lu reports\n", mode_names[i],
+                   params->period_us[i] / 1000.0,
+                   (unsigned long) params->reports[i]);
+        }
+    }
+    printf("output bytes   %llu\n", (unsigned long long) host_uart_bytes());
+
+    if (script.first_report_us >= 0 &&
+        (first_report < 0 || first_report > script.first_report_us)) {
+        printf("FAIL first report later than %.3f ms\n",
+               script.first_report_us / 1000.0);
+        passed = false;
+    }
+    if (script.reconnect_us >= 0 &&
+        (missed > 0 || worst > script.reconnect_us)) {
+        printf("FAIL reconnect slower than %.3f ms\n",
+               script.reconnect_us / 1000.0);
+        passed = false;
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,33 @@
+/**
+ * @file    esp_bt.h
+ * @brief   Host stand-in for the Bluetooth controller API. The controller
+ *          calls always succeed.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef FAKE_ESP_BT_H
+#define FAKE_ESP_BT_H
+
+#include "esp_bt_defs.h"
+
+typedef enum {
+    ESP_BT_MODE_IDLE       = 0x00,
+    ESP_BT_MODE_BLE        = 0x01,
+    ESP_BT_MODE_CLASSIC_BT = 0x02,
+    ESP_BT_MODE_BTDM       = 0x03,
+} esp_bt_mode_t;
+
+typedef struct {
+    uint8_t unused;
+} esp_bt_controller_config_t;
+
+#define BT_CONTROLLER_INIT_CONFIG_DEFAULT() {0}
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode);
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t* cfg);
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode);
+
+#endif /* #ifndef FAKE_ESP_BT_H */
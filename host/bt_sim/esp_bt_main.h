@@ -0,0 +1,18 @@
+/**
+ * @file    esp_bt_main.h
+ * @brief   Host stand-in for the Bluedroid enable API.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef FAKE_ESP_BT_MAIN_H
+#define FAKE_ESP_BT_MAIN_H
+
+#include "esp_bt_defs.h"
+
+esp_err_t esp_bluedroid_init(void);
+esp_err_t esp_bluedroid_enable(void);
+
+#endif /* #ifndef FAKE_ESP_BT_MAIN_H */
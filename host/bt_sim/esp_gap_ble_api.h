@@ -0,0 +1,294 @@
+/**
+ * @file    esp_gap_ble_api.h
+ * @brief   Host stand-in for the BLE GAP API.
+ * 
+ * Scanning, privacy, pairing and the whitelist are answered by events from the
+ * simulated stack after the latencies configured in fake_bt.h. The bond list
+ * holds the peer once it has paired. Security parameters are accepted and
+ * ignored.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef FAKE_ESP_GAP_BLE_API_H
+#define FAKE_ESP_GAP_BLE_API_H
+
+#include "esp_bt_defs.h"
+
+typedef enum {
+    ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT = 0,
+    ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT,
+    ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT,
+    ESP_GAP_BLE_SCAN_RESULT_EVT,
+    ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT,
+    ESP_GAP_BLE_SCAN_RSP_DATA_RAW_SET_COMPLETE_EVT,
+    ESP_GAP_BLE_ADV_START_COMPLETE_EVT,
+    ESP_GAP_BLE_SCAN_START_COMPLETE_EVT,
+    ESP_GAP_BLE_AUTH_CMPL_EVT,
+    ESP_GAP_BLE_KEY_EVT,
+    ESP_GAP_BLE_SEC_REQ_EVT,
+    ESP_GAP_BLE_PASSKEY_NOTIF_EVT,
+    ESP_GAP_BLE_PASSKEY_REQ_EVT,
+    ESP_GAP_BLE_OOB_REQ_EVT,
+    ESP_GAP_BLE_LOCAL_IR_EVT,
+    ESP_GAP_BLE_LOCAL_ER_EVT,
+    ESP_GAP_BLE_NC_REQ_EVT,
+    ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT,
+    ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT,
+    ESP_GAP_BLE_SET_STATIC_RAND_ADDR_EVT,
+    ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT,
+    ESP_GAP_BLE_SET_PKT_LENGTH_COMPLETE_EVT,
+    ESP_GAP_BLE_SET_LOCAL_PRIVACY_COMPLETE_EVT,
+    ESP_GAP_BLE_REMOVE_BOND_DEV_COMPLETE_EVT,
+    ESP_GAP_BLE_CLEAR_BOND_DEV_COMPLETE_EVT,
+    ESP_GAP_BLE_GET_BOND_DEV_COMPLETE_EVT,
+    ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT,
+    ESP_GAP_BLE_UPDATE_WHITELIST_COMPLETE_EVT,
+} esp_gap_ble_cb_event_t;
+
+typedef enum {
+    ESP_GAP_SEARCH_INQ_RES_EVT = 0,
+    ESP_GAP_SEARCH_INQ_CMPL_EVT,
+    ESP_GAP_SEARCH_DISC_RES_EVT,
+    ESP_GAP_SEARCH_DISC_BLE_RES_EVT,
+    ESP_GAP_SEARCH_DISC_CMPL_EVT,
+    ESP_GAP_SEARCH_DI_DISC_CMPL_EVT,
+    ESP_GAP_SEARCH_SEARCH_CANCEL_CMPL_EVT,
+    ESP_GAP_SEARCH_INQ_DISCARD_NUM_EVT,
+} esp_gap_search_evt_t;
+
+#define ESP_BLE_AD_TYPE_FLAG       0x01
+#define ESP_BLE_AD_TYPE_16SRV_CMPL 0x03
+#define ESP_BLE_AD_TYPE_NAME_SHORT 0x08
+#define ESP_BLE_AD_TYPE_NAME_CMPL  0x09
+#define ESP_BLE_AD_TYPE_APPEARANCE 0x19
+
+#define ESP_BLE_ADV_DATA_LEN_MAX      31
+#define ESP_BLE_SCAN_RSP_DATA_LEN_MAX 31
+
+typedef enum {
+    BLE_SCAN_TYPE_PASSIVE = 0x0,
+    BLE_SCAN_TYPE_ACTIVE  = 0x1,
+} esp_ble_scan_type_t;
+
+typedef enum {
+    BLE_SCAN_FILTER_ALLOW_ALL           = 0x0,
+    BLE_SCAN_FILTER_ALLOW_ONLY_WLST     = 0x1,
+    BLE_SCAN_FILTER_ALLOW_UND_RPA_DIR   = 0x2,
+    BLE_SCAN_FILTER_ALLOW_WLIST_RPA_DIR = 0x3,
+} esp_ble_scan_filter_t;
+
+typedef enum {
+    BLE_SCAN_DUPLICATE_DISABLE = 0x0,
+    BLE_SCAN_DUPLICATE_ENABLE  = 0x1,
+} esp_ble_scan_duplicate_t;
+
+typedef struct {
+    esp_ble_scan_type_t scan_type;
+    esp_ble_addr_type_t own_addr_type;
+    esp_ble_scan_filter_t scan_filter_policy;
+    uint16_t scan_interval;
+    uint16_t scan_window;
+    esp_ble_scan_duplicate_t scan_duplicate;
+} esp_ble_scan_params_t;
+
+typedef struct {
+    esp_bd_addr_t bda;
+    uint16_t min_int;
+    uint16_t max_int;
+    uint16_t latency;
+    uint16_t timeout;
+} esp_ble_conn_update_params_t;
+
+typedef enum {
+    ESP_BLE_WHITELIST_REMOVE = 0x0,
+    ESP_BLE_WHITELIST_ADD    = 0x1,
+    ESP_BLE_WHITELIST_CLEAR  = 0x2,
+} esp_ble_wl_operation_t;
+
+typedef uint8_t esp_ble_auth_req_t;
+#define ESP_LE_AUTH_NO_BOND          0x00
+#define ESP_LE_AUTH_BOND             0x01
+#define ESP_LE_AUTH_REQ_MITM         (1 << 2)
+#define ESP_LE_AUTH_REQ_BOND_MITM    (ESP_LE_AUTH_BOND | ESP_LE_AUTH_REQ_MITM)
+#define ESP_LE_AUTH_REQ_SC_ONLY      (1 << 3)
+#define ESP_LE_AUTH_REQ_SC_BOND      (ESP_LE_AUTH_BOND | ESP_LE_AUTH_REQ_SC_ONLY)
+#define ESP_LE_AUTH_REQ_SC_MITM      (ESP_LE_AUTH_REQ_MITM | \
+                                      ESP_LE_AUTH_REQ_SC_ONLY)
+#define ESP_LE_AUTH_REQ_SC_MITM_BOND (ESP_LE_AUTH_REQ_MITM | \
+                                      ESP_LE_AUTH_REQ_SC_ONLY | \
+                                      ESP_LE_AUTH_BOND)
+
+typedef uint8_t esp_ble_io_cap_t;
+#define ESP_IO_CAP_OUT    0
+#define ESP_IO_CAP_IO     1
+#define ESP_IO_CAP_IN     2
+#define ESP_IO_CAP_NONE   3
+#define ESP_IO_CAP_KBDISP 4
+
+#define ESP_BLE_ENC_KEY_MASK  (1 << 0)
+#define ESP_BLE_ID_KEY_MASK   (1 << 1)
+#define ESP_BLE_CSR_KEY_MASK  (1 << 2)
+#define ESP_BLE_LINK_KEY_MASK (1 << 3)
+
+#define ESP_BLE_OOB_DISABLE 0
+#define ESP_BLE_OOB_ENABLE  1
+
+typedef enum {
+    ESP_BLE_SM_PASSKEY = 0,
+    ESP_BLE_SM_AUTHEN_REQ_MODE,
+    ESP_BLE_SM_IOCAP_MODE,
+    ESP_BLE_SM_SET_INIT_KEY,
+    ESP_BLE_SM_SET_RSP_KEY,
+    ESP_BLE_SM_MAX_KEY_SIZE,
+    ESP_BLE_SM_MIN_KEY_SIZE,
+    ESP_BLE_SM_SET_STATIC_PASSKEY,
+    ESP_BLE_SM_CLEAR_STATIC_PASSKEY,
+    ESP_BLE_SM_ONLY_ACCEPT_SPECIFIED_SEC_AUTH,
+    ESP_BLE_SM_OOB_SUPPORT,
+    ESP_BLE_APP_ENC_KEY_SIZE,
+    ESP_BLE_SM_MAX_PARAM,
+} esp_ble_sm_param_t;
+
+typedef uint8_t esp_ble_key_type_t;
+#define ESP_LE_KEY_NONE  0x00
+#define ESP_LE_KEY_PENC  0x01
+#define ESP_LE_KEY_PID   0x02
+#define ESP_LE_KEY_PCSRK 0x04
+#define ESP_LE_KEY_PLK   0x08
+#define ESP_LE_KEY_LLK   (ESP_LE_KEY_PLK << 4)
+#define ESP_LE_KEY_LENC  (ESP_LE_KEY_PENC << 4)
+#define ESP_LE_KEY_LID   (ESP_LE_KEY_PID << 4)
+#define ESP_LE_KEY_LCSRK (ESP_LE_KEY_PCSRK << 4)
+
+typedef struct {
+    esp_bd_addr_t bd_addr;
+} esp_ble_sec_req_t;
+
+typedef struct {
+    esp_bd_addr_t bd_addr;
+    uint32_t passkey;
+} esp_ble_sec_key_notif_t;
+
+typedef struct {
+    esp_bd_addr_t bd_addr;
+    esp_ble_key_type_t key_type;
+} esp_ble_key_t;
+
+typedef struct {
+    esp_bd_addr_t bd_addr;
+    bool key_present;
+    uint8_t key_type;
+    bool success;
+    uint8_t fail_reason;
+    esp_ble_addr_type_t addr_type;
+    uint8_t dev_type;
+    esp_ble_auth_req_t auth_mode;
+} esp_ble_auth_cmpl_t;
+
+typedef struct {
+    uint8_t irk[16];
+    esp_ble_addr_type_t addr_type;
+    esp_bd_addr_t static_addr;
+} esp_ble_pid_keys_t;
+
+typedef uint8_t esp_ble_key_mask_t;
+
+typedef struct {
+    esp_ble_key_mask_t key_mask;
+    esp_ble_pid_keys_t pid_key;
+} esp_ble_bond_key_info_t;
+
+typedef struct {
+    esp_bd_addr_t bd_addr;
+    esp_ble_bond_key_info_t bond_key;
+} esp_ble_bond_dev_t;
+
+typedef union {
+    esp_ble_sec_key_notif_t key_notif;
+    esp_ble_sec_req_t ble_req;
+    esp_ble_key_t ble_key;
+    esp_ble_auth_cmpl_t auth_cmpl;
+} esp_ble_sec_t;
+
+typedef union {
+    struct ble_scan_param_cmpl_evt_param {
+        esp_bt_status_t status;
+    } scan_param_cmpl;
+
+    struct ble_scan_result_evt_param {
+        esp_gap_search_evt_t search_evt;
+        esp_bd_addr_t bda;
+        uint8_t dev_type;
+        esp_ble_addr_type_t ble_addr_type;
+        uint8_t ble_evt_type;
+        int rssi;
+        uint8_t ble_adv[ESP_BLE_ADV_DATA_LEN_MAX +
+                        ESP_BLE_SCAN_RSP_DATA_LEN_MAX];
+        int flag;
+        int num_resps;
+        uint8_t adv_data_len;
+        uint8_t scan_rsp_len;
+        uint32_t num_dis;
+    } scan_rst;
+
+    struct ble_scan_start_cmpl_evt_param {
+        esp_bt_status_t status;
+    } scan_start_cmpl;
+
+    esp_ble_sec_t ble_security;
+
+    struct ble_scan_stop_cmpl_evt_param {
+        esp_bt_status_t status;
+    } scan_stop_cmpl;
+
+    struct ble_update_conn_params_evt_param {
+        esp_bt_status_t status;
+        esp_bd_addr_t bda;
+        uint16_t min_int;
+        uint16_t max_int;
+        uint16_t latency;
+        uint16_t conn_int;
+        uint16_t timeout;
+    } update_conn_params;
+
+    struct ble_local_privacy_cmpl_evt_param {
+        esp_bt_status_t status;
+    } local_privacy_cmpl;
+
+    struct ble_update_whitelist_cmpl_evt_param {
+        esp_bt_status_t status;
+        esp_ble_wl_operation_t wl_operation;
+    } update_whitelist_cmpl;
+} esp_ble_gap_cb_param_t;
+
+typedef void (*esp_gap_ble_cb_t)(esp_gap_ble_cb_event_t event,
+                                 esp_ble_gap_cb_param_t *param);
+
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback);
+esp_err_t esp_ble_gap_config_local_privacy(bool privacy_enable);
+esp_err_t esp_ble_gap_set_scan_params(esp_ble_scan_params_t *scan_params);
+esp_err_t esp_ble_gap_start_scanning(uint32_t duration);
+esp_err_t esp_ble_gap_stop_scanning(void);
+esp_err_t esp_ble_gap_set_security_param(esp_ble_sm_param_t param_type,
+                                         void *value, uint8_t len);
+esp_err_t esp_ble_gap_security_rsp(esp_bd_addr_t bd_addr, bool accept);
+esp_err_t esp_ble_passkey_reply(esp_bd_addr_t bd_addr, bool accept,
+                                uint32_t passkey);
+esp_err_t esp_ble_confirm_reply(esp_bd_addr_t bd_addr, bool accept);
+esp_err_t esp_ble_oob_req_reply(esp_bd_addr_t bd_addr, uint8_t *TK,
+                                uint8_t len);
+esp_err_t esp_ble_gap_update_whitelist(bool add_remove, esp_bd_addr_t remote_bda,
+                                       esp_ble_wl_addr_type_t wl_addr_type);
+esp_err_t esp_ble_gap_clear_whitelist(void);
+esp_err_t esp_ble_gap_update_conn_params(
+                                    esp_ble_conn_update_params_t *params);
+int esp_ble_get_bond_device_num(void);
+esp_err_t esp_ble_get_bond_device_list(int *dev_num,
+                                       esp_ble_bond_dev_t *dev_list);
+uint8_t *esp_ble_resolve_adv_data(uint8_t *adv_data, uint8_t type,
+                                  uint8_t *length);
+
+#endif /* #ifndef FAKE_ESP_GAP_BLE_API_H */
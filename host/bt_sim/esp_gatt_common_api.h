@@ -0,0 +1,17 @@
+/**
+ * @file    esp_gatt_common_api.h
+ * @brief   Host stand-in for the GATT API shared by clients and servers.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef FAKE_ESP_GATT_COMMON_API_H
+#define FAKE_ESP_GATT_COMMON_API_H
+
+#include "esp_bt_defs.h"
+
+esp_err_t esp_ble_gatt_set_local_mtu(uint16_t mtu);
+
+#endif /* #ifndef FAKE_ESP_GATT_COMMON_API_H */
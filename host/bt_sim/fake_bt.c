@@ -0,0 +1,1687 @@
+/**
+ * @file    fake_bt.c
+ * @brief   Implementation of the simulated Bluedroid stack and peer
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "fake_bt.h"
+#include "esp_bt.h"
+#include "esp_bt_main.h"
+#include "esp_gap_ble_api.h"
+#include "esp_gattc_api.h"
+#include "esp_gatt_common_api.h"
+#include "nvs_flash.h"
+#include "esp_timer.h"
+#include "rep_gen.h"
+#include "globalconst.h"
+#include <string.h>
+
+// Events pending at once, scripted events included
+#define FAKE_BT_QUEUE_LEN 128
+
+// Interface handed to the registered GATT client application
+#define FAKE_BT_GATTC_IF 3
+
+// MTU of the peer, which only supports the BLE 4.0 default
+#define FAKE_BT_MTU_SIZE 23
+
+// Appearance the peer advertises, a gamepad
+#define FAKE_BT_APPEARANCE 0x03C4
+
+// Appearance every fourth other device advertises, a keyboard
+#define FAKE_BT_CROWD_APPEARANCE 0x03C1
+
+// Addresses the whitelist holds
+#define FAKE_BT_WHITELIST_LEN 8
+
+// Timers that can be created with esp_timer_create
+#define FAKE_BT_MAX_TIMERS 8
+
+// NVS namespaces and entries, and the longest value of an entry
+#define FAKE_BT_NVS_NAMESPACES 4
+#define FAKE_BT_NVS_ENTRIES 16
+#define FAKE_BT_NVS_VALUE_LEN 64
+
+// Handle bit of an NVS handle opened for writing
+#define FAKE_BT_NVS_WRITE 0x100
+
+/**
+ * @brief The kinds of pending events.
+*/
+typedef enum FakeBtEvtKind {
+    EVT_GAP,      // A GAP event to deliver
+    EVT_GATTC,    // A GATT client event to deliver
+    EVT_ACTION,   // A scripted event
+    EVT_LINK,     // The link to the peer comes up
+    EVT_OPEN_END, // A connection waiting for the peer times out
+    EVT_ADV,      // The peer, or another device, advertises
+    EVT_SCAN_END, // A scan runs out
+    EVT_REPORT,   // The peer sends a report
+    EVT_TIMER,    // An esp_timer expires
+} FakeBtEvtKind_t;
+
+/**
+ * @brief A pending event.
+*/
+typedef struct FakeBtEvt {
+    int64_t at_us;          // Time to deliver at.
+    FakeBtEvtKind_t kind;   // What the event is.
+    int event;              // GAP or GATT client event, or scripted action.
+    uint32_t arg;           // Argument of the scripted action, or index of
+                            // the timer.
+    uint32_t gen;           // Generation of the link, connection, scan, report
+                            // stream or timer the event belongs to, 0 for
+                            // none.
+    bool no_rsp;            // A write without response, whose errors the peer
+                            // never reports.
+    union {
+        esp_ble_gap_cb_param_t gap;
+        esp_ble_gattc_cb_param_t gattc;
+    } param;                // Parameters of a GAP or GATT client event.
+} FakeBtEvt_t;
+
+/**
+ * @brief A characteristic of the peer's HID service.
+*/
+typedef struct FakeBtChar {
+    uint16_t handle;            // Value handle.
+    uint16_t uuid;              // 16 bit UUID.
+    esp_gatt_char_prop_t prop;  // Properties.
+    uint16_t descr_uuids[2];    // UUIDs of the descriptors, which follow the
+                                // value handle. 0 for none.
+} FakeBtChar_t;
+
+// The peer's HID service
+#define FAKE_BT_SRVC_START 0x0010
+#define FAKE_BT_SRVC_END   0x001F
+#define FAKE_BT_RPT_HANDLE 0x0016
+#define FAKE_BT_CCC_HANDLE 0x0017
+static const FakeBtChar_t fakeChars[] = {
+    {0x0012, 0x2A4A, ESP_GATT_CHAR_PROP_BIT_READ, {0}},
+    {0x0014, 0x2A4B, ESP_GATT_CHAR_PROP_BIT_READ, {0}},
+    {FAKE_BT_RPT_HANDLE, 0x2A4D,
+     ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_NOTIFY,
+     {ESP_GATT_UUID_CHAR_CLIENT_CONFIG, ESP_GATT_UUID_RPT_REF_DESCR}},
+    {0x001A, 0x2A4C, ESP_GATT_CHAR_PROP_BIT_WRITE, {0}},
+};
+#define FAKE_BT_NUM_CHARS (sizeof(fakeChars) / sizeof(fakeChars[0]))
+
+// Latency of each step by default, in microseconds
+static const uint32_t default_latency[FAKE_BT_NUM_STEPS] = {
+    [FAKE_BT_PRIVACY]      = 2000,
+    [FAKE_BT_SCAN_PARAMS]  = 1000,
+    [FAKE_BT_SCAN_START]   = 1000,
+    [FAKE_BT_ADV]          = 50000,
+    [FAKE_BT_SCAN_STOP]    = 1000,
+    [FAKE_BT_CONNECT]      = 30000,
+    [FAKE_BT_CONN_TIMEOUT] = 30000000,
+    [FAKE_BT_AUTH]         = 150000,
+    [FAKE_BT_ENCRYPT]      = 20000,
+    [FAKE_BT_MTU]          = 15000,
+    [FAKE_BT_SEARCH]       = 60000,
+    [FAKE_BT_REG_NOTIFY]   = 500,
+    [FAKE_BT_WRITE_DESCR]  = 15000,
+    [FAKE_BT_CONN_PARAMS]  = 45000,
+};
+
+// Name of the events logged, indexed by event
+static const char *const gap_names[] = {
+    [ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT]    = "SCAN_PARAM_SET_COMPLETE",
+    [ESP_GAP_BLE_SCAN_RESULT_EVT]                = "SCAN_RESULT",
+    [ESP_GAP_BLE_SCAN_START_COMPLETE_EVT]        = "SCAN_START_COMPLETE",
+    [ESP_GAP_BLE_AUTH_CMPL_EVT]                  = "AUTH_CMPL",
+    [ESP_GAP_BLE_SEC_REQ_EVT]                    = "SEC_REQ",
+    [ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT]         = "SCAN_STOP_COMPLETE",
+    [ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT]         = "UPDATE_CONN_PARAMS",
+    [ESP_GAP_BLE_SET_LOCAL_PRIVACY_COMPLETE_EVT] = "SET_LOCAL_PRIVACY_COMPLETE",
+    [ESP_GAP_BLE_UPDATE_WHITELIST_COMPLETE_EVT]  = "UPDATE_WHITELIST_COMPLETE",
+};
+static const char *const gattc_names[] = {
+    [ESP_GATTC_REG_EVT]            = "REG",
+    [ESP_GATTC_OPEN_EVT]           = "OPEN",
+    [ESP_GATTC_CLOSE_EVT]          = "CLOSE",
+    [ESP_GATTC_SEARCH_CMPL_EVT]    = "SEARCH_CMPL",
+    [ESP_GATTC_SEARCH_RES_EVT]     = "SEARCH_RES",
+    [ESP_GATTC_WRITE_DESCR_EVT]    = "WRITE_DESCR",
+    [ESP_GATTC_SRVC_CHG_EVT]       = "SRVC_CHG",
+    [ESP_GATTC_CFG_MTU_EVT]        = "CFG_MTU",
+    [ESP_GATTC_REG_FOR_NOTIFY_EVT] = "REG_FOR_NOTIFY",
+    [ESP_GATTC_CONNECT_EVT]        = "CONNECT",
+    [ESP_GATTC_DISCONNECT_EVT]     = "DISCONNECT",
+};
+
+/**
+ * @brief An esp_timer, running on the simulated clock.
+*/
+struct esp_timer {
+    esp_timer_cb_t callback;    // Called when the timer expires.
+    const char *name;           // Name, for the log.
+    void *arg;                  // Argument of the callback.
+    uint64_t period_us;         // Period, 0 for a one shot timer.
+    bool active;                // The timer is started.
+    uint32_t gen;               // Times started or stopped, so an expiry
+                                // scheduled before a stop is dropped.
+};
+
+/**
+ * @brief An NVS entry, kept in memory.
+*/
+typedef struct FakeNvsEntry {
+    bool used;                              // The entry holds a value.
+    uint8_t ns;                             // Index of its namespace.
+    char key[16];                           // Key, at most 15 characters.
+    uint8_t value[FAKE_BT_NVS_VALUE_LEN];   // Value.
+    size_t len;                             // Length of the value.
+} FakeNvsEntry_t;
+
+/**
+ * @brief The state of the simulated stack and peer.
+*/
+static struct {
+    int64_t now_us;                         // The simulated clock.
+    FakeBtEvt_t queue[FAKE_BT_QUEUE_LEN];   // Pending events by time.
+    size_t pending;                         // Events in queue.
+    uint32_t latency[FAKE_BT_NUM_STEPS];    // Latency of each step.
+    uint8_t status[FAKE_BT_NUM_STEPS];      // Status of each step.
+    esp_gap_ble_cb_t gap_cb;                // Registered GAP callback.
+    esp_gattc_cb_t gattc_cb;                // Registered GATT client callback.
+    FILE *log;                              // Stream events are logged to.
+
+    // Scanning
+    bool scanning;      // A scan is running.
+    uint32_t scan_gen;  // Scans started or stopped.
+    bool active;        // Scans ask for scan responses.
+    bool wl_only;       // Scans only report devices in the whitelist.
+    bool dup_filter;    // Scans report each device once.
+    uint64_t reported;  // Devices reported by the scan, by bit, when
+                        // filtering duplicates.
+    esp_bd_addr_t whitelist[FAKE_BT_WHITELIST_LEN];
+    size_t wl_len;      // Addresses in the whitelist.
+
+    // Other devices advertising nearby
+    uint32_t crowd;     // Number of devices.
+
+    // The peer
+    char name[30];          // Advertised name.
+    esp_bd_addr_t bda;      // Address.
+    uint16_t interval;      // Connection interval, in units of 1.25 ms.
+    uint16_t min_interval;  // Shortest interval accepted in an update.
+    uint16_t slave_latency; // Connection events the peer may skip.
+    bool adv_enabled;       // Advertises while not connected.
+    bool connecting;        // A connection is being opened.
+    uint32_t open_gen;      // Connections ever opened.
+    bool link_pending;      // The link of the connection being opened is
+                            // scheduled to come up.
+    bool connected;         // The link is up.
+    uint32_t link_gen;      // Links ever opened.
+    bool encrypted;         // Pairing completed on this link.
+    bool bonded;            // Pairing completed once, later links are only
+                            // encrypted.
+    bool subscribed;        // The client configuration enables notifying.
+    bool secure_ccc;        // The client configuration can only be written
+                            // on an encrypted link.
+    bool quiet;             // Scripted to send no reports.
+    bool resting;           // The pad rests, repeating the last report.
+    uint32_t stream_gen;    // Report streams ever started.
+    uint32_t seed;          // Seed of the report generator.
+    RepGen_t gen;           // The report generator.
+
+    // Recorded connection attempts
+    FakeBtConn_t conns[FAKE_BT_MAX_CONNS];
+    size_t num_conns;
+
+    // Timers
+    struct esp_timer timers[FAKE_BT_MAX_TIMERS];
+    size_t num_timers;
+
+    // NVS
+    char nvs_ns[FAKE_BT_NVS_NAMESPACES][16];    // Namespaces ever opened for
+                                                // writing, "" if unused.
+    FakeNvsEntry_t nvs[FAKE_BT_NVS_ENTRIES];    // Entries of all namespaces.
+} fakeBt;
+
+/**
+ * @brief Schedule an event after a latency.
+ * 
+ * @param delay_us Time from now to deliver the event.
+ * @param kind What the event is.
+ * @param event The GAP or GATT client event, or scripted action.
+ * @param gen Generation the event belongs to, 0 for none.
+ * @return The scheduled event to fill the parameters of, or NULL if the queue
+ *         is full.
+*/
+static FakeBtEvt_t *schedule(int64_t delay_us, FakeBtEvtKind_t kind, int event,
+                             uint32_t gen) {
+    if (fakeBt.pending == FAKE_BT_QUEUE_LEN) {
+        fprintf(stderr, "fake_bt: event queue full, event dropped\n");
+        return NULL;
+    }
+    int64_t at = fakeBt.now_us + delay_us;
+    // Insert after every event due no later, so equal times keep their order
+    size_t pos = fakeBt.pending;
+    while (pos > 0 && fakeBt.queue[pos - 1].at_us > at) {
+        pos--;
+    }
+    memmove(&fakeBt.queue[pos + 1], &fakeBt.queue[pos],
+            (fakeBt.pending - pos) * sizeof(FakeBtEvt_t));
+    fakeBt.pending++;
+    FakeBtEvt_t *evt = &fakeBt.queue[pos];
+    memset(evt, 0, sizeof(*evt));
+    evt->at_us = at;
+    evt->kind = kind;
+    evt->event = event;
+    evt->gen = gen;
+    return evt;
+}
+
+/**
+ * @brief Schedule a GAP event answering a step.
+ * 
+ * @param step The step answered, giving the latency.
+ * @param event The GAP event.
+ * @return The event to fill the parameters of, or NULL.
+*/
+static esp_ble_gap_cb_param_t *schedule_gap(FakeBtStep_t step, int event) {
+    FakeBtEvt_t *evt = schedule(fakeBt.latency[step], EVT_GAP, event, 0);
+    return evt ? &evt->param.gap : NULL;
+}
+
+/**
+ * @brief Schedule a GATT client event of the current link answering a step.
+ * 
+ * @param step The step answered, giving the latency.
+ * @param event The GATT client event.
+ * @return The event to fill the parameters of, or NULL.
+*/
+static esp_ble_gattc_cb_param_t *schedule_gattc(FakeBtStep_t step, int event) {
+    FakeBtEvt_t *evt = schedule(fakeBt.latency[step], EVT_GATTC, event,
+                                fakeBt.link_gen);
+    return evt ? &evt->param.gattc : NULL;
+}
+
+/**
+ * @brief Get the connection attempt in progress.
+ * 
+ * @return The attempt, or NULL if none was recorded.
+*/
+static FakeBtConn_t *cur_conn(void) {
+    if (fakeBt.num_conns == 0 || fakeBt.num_conns > FAKE_BT_MAX_CONNS) {
+        return NULL;
+    }
+    return &fakeBt.conns[fakeBt.num_conns - 1];
+}
+
+/**
+ * @brief Record a milestone of the attempt in progress, if not yet reached.
+ * 
+ * @param field The milestone of the attempt, NULL if none was recorded.
+*/
+static void mark(int64_t* field) {
+    if (field != NULL && *field < 0) {
+        *field = fakeBt.now_us;
+    }
+}
+#define MARK(name) mark(cur_conn() ? &cur_conn()->name : NULL)
+
+/**
+ * @brief Log a delivered event.
+ * 
+ * @param kind "GAP" or "GATTC".
+ * @param name The name of the event, NULL if unnamed.
+ * @param event The event number.
+*/
+static void log_event(const char* kind, const char* name, int event) {
+    if (fakeBt.log == NULL) {
+        return;
+    }
+    if (name != NULL) {
+        fprintf(fakeBt.log, "%10.3f ms  %s %s\n", fakeBt.now_us / 1000.0, kind,
+                name);
+    } else {
+        fprintf(fakeBt.log, "%10.3f ms  %s %d\n", fakeBt.now_us / 1000.0, kind,
+                event);
+    }
+}
+
+/**
+ * @brief Deliver a GAP event to the registered callback.
+ * 
+ * @param event The event.
+ * @param param Its parameters.
+*/
+static void deliver_gap(int event, esp_ble_gap_cb_param_t* param) {
+    if (event != ESP_GAP_BLE_SCAN_RESULT_EVT) {
+        log_event("GAP", (size_t) event < sizeof(gap_names) /
+                         sizeof(gap_names[0]) ? gap_names[event] : NULL, event);
+    }
+    if (fakeBt.gap_cb != NULL) {
+        fakeBt.gap_cb(event, param);
+    }
+}
+
+/**
+ * @brief Deliver a GATT client event to the registered callback.
+ * 
+ * @param event The event.
+ * @param param Its parameters.
+*/
+static void deliver_gattc(int event, esp_ble_gattc_cb_param_t* param) {
+    if (event != ESP_GATTC_NOTIFY_EVT) {
+        log_event("GATTC", (size_t) event < sizeof(gattc_names) /
+                           sizeof(gattc_names[0]) ? gattc_names[event] : NULL,
+                  event);
+    }
+    if (fakeBt.gattc_cb != NULL) {
+        fakeBt.gattc_cb(event, FAKE_BT_GATTC_IF, param);
+    }
+}
+
+/**
+ * @brief Start the peer's report stream if it may send reports, from the next
+ *        connection event.
+*/
+static void start_reports(void) {
+    if (!fakeBt.connected || !fakeBt.encrypted || !fakeBt.subscribed ||
+        fakeBt.quiet) {
+        return;
+    }
+    // A new generation drops any stream already running
+    fakeBt.stream_gen++;
+    schedule((int64_t) fakeBt.interval * 1250, EVT_REPORT, 0,
+             fakeBt.stream_gen);
+}
+
+/**
+ * @brief Stop the peer's report stream.
+*/
+static void stop_reports(void) {
+    fakeBt.stream_gen++;
+}
+
+/**
+ * @brief Change the parameters of the link. The report generator keeps its
+ *        time in step with the new interval.
+ * 
+ * @param interval The connection interval, in units of 1.25 ms.
+ * @param latency The slave latency, in connection events.
+*/
+static void set_conn_params(uint16_t interval, uint16_t latency) {
+    fakeBt.interval = interval;
+    fakeBt.slave_latency = latency;
+    fakeBt.gen.cfg.interval_us = (uint32_t) interval * 1250;
+}
+
+/**
+ * @brief Drop the link to the peer and tell the client.
+ * 
+ * @param reason The reason of the disconnection.
+*/
+static void drop_link(uint32_t reason) {
+    fakeBt.connected = false;
+    fakeBt.encrypted = false;
+    fakeBt.subscribed = false;
+    fakeBt.link_gen++;
+    stop_reports();
+    MARK(disconnect_us);
+    esp_ble_gattc_cb_param_t param;
+    memset(&param, 0, sizeof(param));
+    param.disconnect.reason = reason;
+    memcpy(param.disconnect.remote_bda, fakeBt.bda, sizeof(esp_bd_addr_t));
+    deliver_gattc(ESP_GATTC_DISCONNECT_EVT, &param);
+    memset(&param, 0, sizeof(param));
+    param.close.status = ESP_GATT_OK;
+    param.close.reason = reason;
+    memcpy(param.close.remote_bda, fakeBt.bda, sizeof(esp_bd_addr_t));
+    deliver_gattc(ESP_GATTC_CLOSE_EVT, &param);
+}
+
+/**
+ * @brief Fail the connection being opened and tell the client.
+ * 
+ * @param status The status of the open event.
+*/
+static void fail_open(uint8_t status) {
+    fakeBt.connecting = false;
+    fakeBt.link_pending = false;
+    MARK(disconnect_us);
+    esp_ble_gattc_cb_param_t param;
+    memset(&param, 0, sizeof(param));
+    param.open.status = status;
+    memcpy(param.open.remote_bda, fakeBt.bda, sizeof(esp_bd_addr_t));
+    deliver_gattc(ESP_GATTC_OPEN_EVT, &param);
+}
+
+/**
+ * @brief Schedule the link of the connection being opened to come up, if the
+ *        peer is advertising to accept it.
+*/
+static void schedule_link(void) {
+    if (!fakeBt.connecting || fakeBt.link_pending || fakeBt.connected) {
+        return;
+    }
+    // A connection scripted to fail fails whether the peer advertises or not
+    if (!fakeBt.adv_enabled && fakeBt.status[FAKE_BT_CONNECT] == ESP_GATT_OK) {
+        return;
+    }
+    if (schedule(fakeBt.latency[FAKE_BT_CONNECT], EVT_LINK, 0,
+                 fakeBt.open_gen) != NULL) {
+        fakeBt.link_pending = true;
+    }
+}
+
+/**
+ * @brief Get the address of an advertising device.
+ * 
+ * @param device 0 for the peer, or the number of another device from 1.
+ * @param bda Set to the address.
+*/
+static void device_addr(uint32_t device, esp_bd_addr_t bda) {
+    static const esp_bd_addr_t crowd_bda = {0x02, 0x11, 0x22, 0x33, 0x44, 0};
+    memcpy(bda, device == 0 ? fakeBt.bda : crowd_bda, sizeof(esp_bd_addr_t));
+    if (device != 0) {
+        bda[5] = device;
+    }
+}
+
+/**
+ * @brief Check whether the whitelist holds an address.
+ * 
+ * @param bda The address.
+ * @return The index of the address, or -1 if it is not in the whitelist.
+*/
+static int find_wl(const esp_bd_addr_t bda) {
+    for (size_t i = 0; i < fakeBt.wl_len; i++) {
+        if (memcmp(fakeBt.whitelist[i], bda, sizeof(esp_bd_addr_t)) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Fill a scan result with a device's advertisement, and its scan
+ *        response if the scan is active.
+ * 
+ * @param rst The scan result.
+ * @param device 0 for the peer, or the number of another device from 1.
+*/
+static void fill_adv(struct ble_scan_result_evt_param* rst, uint32_t device) {
+    rst->search_evt = ESP_GAP_SEARCH_INQ_RES_EVT;
+    device_addr(device, rst->bda);
+    rst->ble_addr_type = device == 0 ? BLE_ADDR_TYPE_PUBLIC
+                                     : BLE_ADDR_TYPE_RANDOM;
+    rst->rssi = device == 0 ? -50 : -70;
+    uint8_t *adv = rst->ble_adv;
+    size_t len = 0;
+    // Advertising data: flags and appearance
+    adv[len++] = 2;
+    adv[len++] = ESP_BLE_AD_TYPE_FLAG;
+    adv[len++] = 0x06;
+    uint16_t appearance = device == 0 ? FAKE_BT_APPEARANCE :
+                          device % 4 == 0 ? FAKE_BT_CROWD_APPEARANCE : 0;
+    if (appearance != 0) {
+        adv[len++] = 3;
+        adv[len++] = ESP_BLE_AD_TYPE_APPEARANCE;
+        adv[len++] = appearance & 0xFF;
+        adv[len++] = appearance >> 8;
+    }
+    rst->adv_data_len = len;
+    rst->scan_rsp_len = 0;
+    if (!fakeBt.active) {
+        return;
+    }
+    // Scan response: the complete name
+    char name[sizeof(fakeBt.name)];
+    if (device == 0) {
+        strcpy(name, fakeBt.name);
+    } else {
+        snprintf(name, sizeof(name), "Device-%02u", (unsigned) device);
+    }
+    size_t name_len = strlen(name);
+    adv[len++] = name_len + 1;
+    adv[len++] = ESP_BLE_AD_TYPE_NAME_CMPL;
+    memcpy(adv + len, name, name_len);
+    len += name_len;
+    rst->scan_rsp_len = len - rst->adv_data_len;
+}
+
+/**
+ * @brief Deliver a scripted event.
+ * 
+ * @param action The event.
+ * @param arg Its argument.
+*/
+static void run_action(FakeBtAction_t action, uint32_t arg) {
+    switch (action) {
+        case FAKE_BT_DISCONNECT:
+            if (fakeBt.connected) {
+                drop_link(arg);
+            }
+            break;
+        case FAKE_BT_SRVC_CHG: {
+            if (!fakeBt.connected) {
+                break;
+            }
+            fakeBt.subscribed = false;
+            stop_reports();
+            esp_ble_gattc_cb_param_t param;
+            memset(&param, 0, sizeof(param));
+            memcpy(param.srvc_chg.remote_bda, fakeBt.bda,
+                   sizeof(esp_bd_addr_t));
+            deliver_gattc(ESP_GATTC_SRVC_CHG_EVT, &param);
+            break;
+        }
+        case FAKE_BT_CONN_UPDATE: {
+            set_conn_params(arg, 0);
+            if (!fakeBt.connected) {
+                break;
+            }
+            esp_ble_gap_cb_param_t param;
+            memset(&param, 0, sizeof(param));
+            param.update_conn_params.status = ESP_BT_STATUS_SUCCESS;
+            memcpy(param.update_conn_params.bda, fakeBt.bda,
+                   sizeof(esp_bd_addr_t));
+            param.update_conn_params.min_int = arg;
+            param.update_conn_params.max_int = arg;
+            param.update_conn_params.conn_int = arg;
+            param.update_conn_params.timeout = 400;
+            deliver_gap(ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT, &param);
+            break;
+        }
+        case FAKE_BT_ADV_ON:
+            fakeBt.adv_enabled = true;
+            // A connection waiting for the peer is accepted
+            schedule_link();
+            break;
+        case FAKE_BT_ADV_OFF:
+            fakeBt.adv_enabled = false;
+            break;
+        case FAKE_BT_QUIET:
+            fakeBt.quiet = true;
+            stop_reports();
+            break;
+        case FAKE_BT_RESUME:
+            fakeBt.quiet = false;
+            start_reports();
+            break;
+        case FAKE_BT_REST:
+            fakeBt.resting = true;
+            break;
+        case FAKE_BT_PLAY:
+            // The moved pad is reported at the next connection event
+            fakeBt.resting = false;
+            start_reports();
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Apply a descriptor write at the peer, before its event is delivered.
+ *        A write without response is reported as sent even when the peer
+ *        refuses it.
+ * 
+ * @param evt The write event, with arg holding the value written.
+*/
+static void deliver_write(FakeBtEvt_t* evt) {
+    esp_gatt_status_t *status = &evt->param.gattc.write.status;
+    if (*status == ESP_GATT_OK &&
+        evt->param.gattc.write.handle == FAKE_BT_CCC_HANDLE &&
+        fakeBt.secure_ccc && !fakeBt.encrypted) {
+        *status = ESP_GATT_INSUF_ENCRYPTION;
+    }
+    if (*status == ESP_GATT_OK &&
+        evt->param.gattc.write.handle == FAKE_BT_CCC_HANDLE) {
+        fakeBt.subscribed = evt->arg & 0x1;
+        if (fakeBt.subscribed) {
+            MARK(subscribe_us);
+            start_reports();
+        } else {
+            stop_reports();
+        }
+    }
+    if (evt->no_rsp) {
+        *status = ESP_GATT_OK;
+    }
+}
+
+/**
+ * @brief Deliver a pending event.
+ * 
+ * @param evt The event, already taken from the queue.
+*/
+static void deliver(FakeBtEvt_t* evt) {
+    switch (evt->kind) {
+        case EVT_GAP:
+            // Answers on a link that has since dropped are never delivered
+            if (evt->gen != 0 && evt->gen != fakeBt.link_gen) {
+                break;
+            }
+            if (evt->event == ESP_GAP_BLE_AUTH_CMPL_EVT &&
+                evt->param.gap.ble_security.auth_cmpl.success) {
+                fakeBt.encrypted = true;
+                fakeBt.bonded = true;
+                MARK(auth_us);
+                start_reports();
+            } else if (evt->event == ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT &&
+                       evt->param.gap.update_conn_params.status ==
+                       ESP_BT_STATUS_SUCCESS) {
+                set_conn_params(evt->param.gap.update_conn_params.conn_int,
+                                evt->param.gap.update_conn_params.latency);
+            }
+            deliver_gap(evt->event, &evt->param.gap);
+            break;
+
+        case EVT_GATTC:
+            // Answers on a link that has since dropped are never delivered
+            if (evt->gen != 0 && evt->gen != fakeBt.link_gen) {
+                break;
+            }
+            if (evt->event == ESP_GATTC_SEARCH_CMPL_EVT &&
+                evt->param.gattc.search_cmpl.status == ESP_GATT_OK) {
+                MARK(discover_us);
+            } else if (evt->event == ESP_GATTC_WRITE_DESCR_EVT) {
+                deliver_write(evt);
+            }
+            deliver_gattc(evt->event, &evt->param.gattc);
+            break;
+
+        case EVT_ACTION:
+            run_action(evt->event, evt->arg);
+            break;
+
+        case EVT_LINK: {
+            if (!fakeBt.connecting || evt->gen != fakeBt.open_gen) {
+                break;
+            }
+            fakeBt.link_pending = false;
+            if (fakeBt.status[FAKE_BT_CONNECT] != ESP_GATT_OK) {
+                fail_open(fakeBt.status[FAKE_BT_CONNECT]);
+                break;
+            }
+            if (!fakeBt.adv_enabled || fakeBt.connected) {
+                // The peer stopped advertising, wait for it to come back
+                break;
+            }
+            fakeBt.connecting = false;
+            esp_ble_gattc_cb_param_t param;
+            memset(&param, 0, sizeof(param));
+            fakeBt.connected = true;
+            fakeBt.link_gen++;
+            fakeBt.slave_latency = 0;
+            MARK(connect_us);
+            // Every connection replays the same reports
+            RepGenCfg_t cfg;
+            rep_gen_default_cfg(&cfg, fakeBt.seed);
+            cfg.interval_us = (uint32_t) fakeBt.interval * 1250;
+            rep_gen_init(&fakeBt.gen, &cfg);
+            param.connect.conn_id = 0;
+            memcpy(param.connect.remote_bda, fakeBt.bda,
+                   sizeof(esp_bd_addr_t));
+            param.connect.conn_params.interval = fakeBt.interval;
+            param.connect.conn_params.timeout = 400;
+            param.connect.ble_addr_type = BLE_ADDR_TYPE_PUBLIC;
+            deliver_gattc(ESP_GATTC_CONNECT_EVT, &param);
+            memset(&param, 0, sizeof(param));
+            param.open.status = ESP_GATT_OK;
+            param.open.conn_id = 0;
+            memcpy(param.open.remote_bda, fakeBt.bda, sizeof(esp_bd_addr_t));
+            param.open.mtu = FAKE_BT_MTU_SIZE;
+            deliver_gattc(ESP_GATTC_OPEN_EVT, &param);
+            // The controller asks for pairing as soon as it is connected
+            if (fakeBt.connected) {
+                esp_ble_gap_cb_param_t sec;
+                memset(&sec, 0, sizeof(sec));
+                memcpy(sec.ble_security.ble_req.bd_addr, fakeBt.bda,
+                       sizeof(esp_bd_addr_t));
+                deliver_gap(ESP_GAP_BLE_SEC_REQ_EVT, &sec);
+            }
+            break;
+        }
+
+        case EVT_OPEN_END:
+            // The stack gives up on a connection the peer never accepted
+            if (fakeBt.connecting && evt->gen == fakeBt.open_gen) {
+                fail_open(ESP_GATT_ERROR);
+            }
+            break;
+
+        case EVT_ADV: {
+            // Advertisements are seen until the scan that expects them ends
+            if (!fakeBt.scanning || evt->gen != fakeBt.scan_gen) {
+                break;
+            }
+            FakeBtEvt_t *next = schedule(fakeBt.latency[FAKE_BT_ADV], EVT_ADV,
+                                         0, fakeBt.scan_gen);
+            if (next != NULL) {
+                next->arg = evt->arg;
+            }
+            if (evt->arg == 0 && (!fakeBt.adv_enabled || fakeBt.connected ||
+                                  fakeBt.connecting)) {
+                break;
+            }
+            // The controller drops devices outside the whitelist, and devices
+            // already reported when filtering duplicates
+            esp_bd_addr_t bda;
+            device_addr(evt->arg, bda);
+            uint64_t bit = (uint64_t) 1 << evt->arg;
+            if ((fakeBt.wl_only && find_wl(bda) < 0) ||
+                (fakeBt.dup_filter && (fakeBt.reported & bit))) {
+                break;
+            }
+            fakeBt.reported |= bit;
+            esp_ble_gap_cb_param_t param;
+            memset(&param, 0, sizeof(param));
+            fill_adv(&param.scan_rst, evt->arg);
+            deliver_gap(ESP_GAP_BLE_SCAN_RESULT_EVT, &param);
+            break;
+        }
+
+        case EVT_SCAN_END: {
+            if (!fakeBt.scanning || evt->gen != fakeBt.scan_gen) {
+                break;
+            }
+            fakeBt.scanning = false;
+            fakeBt.scan_gen++;
+            esp_ble_gap_cb_param_t param;
+            memset(&param, 0, sizeof(param));
+            param.scan_rst.search_evt = ESP_GAP_SEARCH_INQ_CMPL_EVT;
+            log_event("GAP", "SCAN_RESULT (complete)", 0);
+            deliver_gap(ESP_GAP_BLE_SCAN_RESULT_EVT, &param);
+            break;
+        }
+
+        case EVT_REPORT: {
+            if (evt->gen != fakeBt.stream_gen || !fakeBt.connected) {
+                break;
+            }
+            // At rest there is nothing new to send, so the peer skips the
+            // connection events the slave latency allows and repeats its last
+            // report at the next one it attends
+            uint32_t events = fakeBt.resting ? fakeBt.slave_latency + 1 : 1;
+            schedule((int64_t) fakeBt.interval * 1250 * events, EVT_REPORT, 0,
+                     fakeBt.stream_gen);
+            StadiaRep_t rep;
+            if (fakeBt.resting) {
+                rep = fakeBt.gen.rep;
+            } else {
+                rep_gen_next(&fakeBt.gen, &rep);
+            }
+            uint8_t value[STADIA_REP_LEN];
+            rep_gen_raw(&rep, value);
+            MARK(first_report_us);
+            if (cur_conn() != NULL) {
+                cur_conn()->reports++;
+            }
+            esp_ble_gattc_cb_param_t param;
+            memset(&param, 0, sizeof(param));
+            param.notify.conn_id = 0;
+            memcpy(param.notify.remote_bda, fakeBt.bda,
+                   sizeof(esp_bd_addr_t));
+            param.notify.handle = FAKE_BT_RPT_HANDLE;
+            param.notify.value_len = sizeof(value);
+            param.notify.value = value;
+            param.notify.is_notify = true;
+            deliver_gattc(ESP_GATTC_NOTIFY_EVT, &param);
+            break;
+        }
+
+        case EVT_TIMER: {
+            struct esp_timer *timer = &fakeBt.timers[evt->arg];
+            if (!timer->active || evt->gen != timer->gen) {
+                break;
+            }
+            if (timer->period_us > 0) {
+                FakeBtEvt_t *next = schedule(timer->period_us, EVT_TIMER, 0,
+                                             timer->gen);
+                if (next != NULL) {
+                    next->arg = evt->arg;
+                }
+            } else {
+                timer->active = false;
+            }
+            log_event("TIMER", timer->name, 0);
+            timer->callback(timer->arg);
+            break;
+        }
+    }
+}
+
+void fake_bt_reset(void) {
+    FILE *log = fakeBt.log;
+    memset(&fakeBt, 0, sizeof(fakeBt));
+    fakeBt.log = log;
+    memcpy(fakeBt.latency, default_latency, sizeof(default_latency));
+    strncpy(fakeBt.name, remote_device_name, sizeof(fakeBt.name) - 1);
+    static const esp_bd_addr_t bda = {0xE4, 0x5F, 0x01, 0x2C, 0x85, 0x5F};
+    memcpy(fakeBt.bda, bda, sizeof(esp_bd_addr_t));
+    fakeBt.interval = 6;
+    fakeBt.min_interval = 6;
+    fakeBt.adv_enabled = true;
+    fakeBt.seed = 1;
+    fakeBt.link_gen = 1;
+    fakeBt.scan_gen = 1;
+    fakeBt.stream_gen = 1;
+}
+
+void fake_bt_set_latency(FakeBtStep_t step, uint32_t us) {
+    fakeBt.latency[step] = us;
+}
+
+void fake_bt_set_status(FakeBtStep_t step, uint8_t status) {
+    fakeBt.status[step] = status;
+}
+
+void fake_bt_set_name(const char* name) {
+    memset(fakeBt.name, 0, sizeof(fakeBt.name));
+    strncpy(fakeBt.name, name, sizeof(fakeBt.name) - 1);
+}
+
+void fake_bt_set_interval(uint16_t interval) {
+    fakeBt.interval = interval;
+}
+
+void fake_bt_set_min_interval(uint16_t interval) {
+    fakeBt.min_interval = interval;
+}
+
+void fake_bt_set_seed(uint32_t seed) {
+    fakeBt.seed = seed;
+}
+
+void fake_bt_set_bonded(bool bonded) {
+    fakeBt.bonded = bonded;
+}
+
+void fake_bt_set_secure_ccc(bool secure) {
+    fakeBt.secure_ccc = secure;
+}
+
+void fake_bt_set_crowd(uint32_t devices) {
+    fakeBt.crowd = devices < FAKE_BT_MAX_CROWD ? devices : FAKE_BT_MAX_CROWD;
+}
+
+bool fake_bt_at(int64_t at_us, FakeBtAction_t action, uint32_t arg) {
+    FakeBtEvt_t *evt = schedule(at_us - fakeBt.now_us, EVT_ACTION, action, 0);
+    if (evt == NULL) {
+        return false;
+    }
+    evt->arg = arg;
+    return true;
+}
+
+bool fake_bt_step(int64_t until_us) {
+    if (fakeBt.pending == 0 || fakeBt.queue[0].at_us > until_us) {
+        if (until_us > fakeBt.now_us) {
+            fakeBt.now_us = until_us;
+        }
+        return false;
+    }
+    FakeBtEvt_t evt = fakeBt.queue[0];
+    fakeBt.pending--;
+    memmove(&fakeBt.queue[0], &fakeBt.queue[1],
+            fakeBt.pending * sizeof(FakeBtEvt_t));
+    if (evt.at_us > fakeBt.now_us) {
+        fakeBt.now_us = evt.at_us;
+    }
+    deliver(&evt);
+    return true;
+}
+
+int64_t fake_bt_now(void) {
+    return fakeBt.now_us;
+}
+
+const FakeBtConn_t *fake_bt_conns(size_t* count) {
+    *count = fakeBt.num_conns < FAKE_BT_MAX_CONNS ? fakeBt.num_conns
+                                                  : FAKE_BT_MAX_CONNS;
+    return fakeBt.conns;
+}
+
+void fake_bt_log(FILE* out) {
+    fakeBt.log = out;
+}
+
+/**
+ * Timers, on the simulated clock
+*/
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args,
+                           esp_timer_handle_t* out_handle) {
+    if (create_args == NULL || create_args->callback == NULL ||
+        out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (fakeBt.num_timers == FAKE_BT_MAX_TIMERS) {
+        return ESP_ERR_NO_MEM;
+    }
+    struct esp_timer *timer = &fakeBt.timers[fakeBt.num_timers++];
+    memset(timer, 0, sizeof(*timer));
+    timer->callback = create_args->callback;
+    timer->arg = create_args->arg;
+    timer->name = create_args->name;
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+/**
+ * @brief Start a timer.
+ * 
+ * @param timer The timer.
+ * @param timeout_us Time to the first expiry.
+ * @param period_us Period, 0 for a one shot timer.
+ * @return ESP_OK, or an error as esp_timer would return.
+*/
+static esp_err_t start_timer(esp_timer_handle_t timer, uint64_t timeout_us,
+                             uint64_t period_us) {
+    if (timer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->gen++;
+    FakeBtEvt_t *evt = schedule(timeout_us, EVT_TIMER, 0, timer->gen);
+    if (evt == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    evt->arg = timer - fakeBt.timers;
+    timer->period_us = period_us;
+    timer->active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return start_timer(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+    return start_timer(timer, period, period);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (timer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = false;
+    timer->gen++;
+    return ESP_OK;
+}
+
+/**
+ * NVS, in memory
+*/
+
+esp_err_t nvs_open(const char* namespace_name, nvs_open_mode_t open_mode,
+                   nvs_handle_t* out_handle) {
+    if (namespace_name == NULL || strlen(namespace_name) > 15) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t free_ns = FAKE_BT_NVS_NAMESPACES;
+    for (size_t i = 0; i < FAKE_BT_NVS_NAMESPACES; i++) {
+        if (strcmp(fakeBt.nvs_ns[i], namespace_name) == 0) {
+            *out_handle = (i + 1) |
+                          (open_mode == NVS_READWRITE ? FAKE_BT_NVS_WRITE : 0);
+            return ESP_OK;
+        }
+        if (fakeBt.nvs_ns[i][0] == '\0' && free_ns == FAKE_BT_NVS_NAMESPACES) {
+            free_ns = i;
+        }
+    }
+    // A namespace is only created by opening it for writing
+    if (open_mode != NVS_READWRITE) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (free_ns == FAKE_BT_NVS_NAMESPACES) {
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    strcpy(fakeBt.nvs_ns[free_ns], namespace_name);
+    *out_handle = (free_ns + 1) | FAKE_BT_NVS_WRITE;
+    return ESP_OK;
+}
+
+/**
+ * @brief Find an NVS entry.
+ * 
+ * @param handle The handle of its namespace.
+ * @param key The key.
+ * @return The entry, or NULL if there is none.
+*/
+static FakeNvsEntry_t *find_nvs(nvs_handle_t handle, const char* key) {
+    uint8_t ns = (handle & ~FAKE_BT_NVS_WRITE) - 1;
+    for (size_t i = 0; i < FAKE_BT_NVS_ENTRIES; i++) {
+        if (fakeBt.nvs[i].used && fakeBt.nvs[i].ns == ns &&
+            strcmp(fakeBt.nvs[i].key, key) == 0) {
+            return &fakeBt.nvs[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Check an NVS handle.
+ * 
+ * @param handle The handle.
+ * @return true if it was returned by nvs_open.
+*/
+static bool valid_nvs(nvs_handle_t handle) {
+    uint32_t ns = handle & ~FAKE_BT_NVS_WRITE;
+    return ns >= 1 && ns <= FAKE_BT_NVS_NAMESPACES;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value,
+                       size_t* length) {
+    if (!valid_nvs(handle)) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    FakeNvsEntry_t *entry = find_nvs(handle, key);
+    if (entry == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    // Without a buffer only the length is read, as on the device
+    if (out_value == NULL) {
+        *length = entry->len;
+        return ESP_OK;
+    }
+    if (*length < entry->len) {
+        *length = entry->len;
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out_value, entry->value, entry->len);
+    *length = entry->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value,
+                       size_t length) {
+    if (!valid_nvs(handle)) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (!(handle & FAKE_BT_NVS_WRITE)) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    if (key == NULL || strlen(key) > 15 || length > FAKE_BT_NVS_VALUE_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    FakeNvsEntry_t *entry = find_nvs(handle, key);
+    for (size_t i = 0; entry == NULL && i < FAKE_BT_NVS_ENTRIES; i++) {
+        if (!fakeBt.nvs[i].used) {
+            entry = &fakeBt.nvs[i];
+            entry->used = true;
+            entry->ns = (handle & ~FAKE_BT_NVS_WRITE) - 1;
+            strcpy(entry->key, key);
+        }
+    }
+    if (entry == NULL) {
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    memcpy(entry->value, value, length);
+    entry->len = length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    if (!valid_nvs(handle)) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (!(handle & FAKE_BT_NVS_WRITE)) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    FakeNvsEntry_t *entry = find_nvs(handle, key);
+    if (entry == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    entry->used = false;
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    return valid_nvs(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+void nvs_close(nvs_handle_t handle) {
+}
+
+/**
+ * Controller and stack setup, which cannot fail on the host
+*/
+
+esp_err_t nvs_flash_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    return ESP_OK;
+}
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode) {
+    return ESP_OK;
+}
+
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t* cfg) {
+    return ESP_OK;
+}
+
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode) {
+    return ESP_OK;
+}
+
+esp_err_t esp_bluedroid_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t esp_bluedroid_enable(void) {
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatt_set_local_mtu(uint16_t mtu) {
+    return ESP_OK;
+}
+
+/**
+ * GAP API
+*/
+
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback) {
+    fakeBt.gap_cb = callback;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_config_local_privacy(bool privacy_enable) {
+    esp_ble_gap_cb_param_t *param =
+        schedule_gap(FAKE_BT_PRIVACY, ESP_GAP_BLE_SET_LOCAL_PRIVACY_COMPLETE_EVT);
+    if (param == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    param->local_privacy_cmpl.status = fakeBt.status[FAKE_BT_PRIVACY];
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_set_scan_params(esp_ble_scan_params_t *scan_params) {
+    esp_ble_gap_cb_param_t *param =
+        schedule_gap(FAKE_BT_SCAN_PARAMS,
+                     ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT);
+    if (param == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    param->scan_param_cmpl.status = fakeBt.status[FAKE_BT_SCAN_PARAMS];
+    if (fakeBt.status[FAKE_BT_SCAN_PARAMS] == ESP_BT_STATUS_SUCCESS) {
+        fakeBt.active = scan_params->scan_type == BLE_SCAN_TYPE_ACTIVE;
+        fakeBt.wl_only = scan_params->scan_filter_policy ==
+                             BLE_SCAN_FILTER_ALLOW_ONLY_WLST ||
+                         scan_params->scan_filter_policy ==
+                             BLE_SCAN_FILTER_ALLOW_WLIST_RPA_DIR;
+        fakeBt.dup_filter = scan_params->scan_duplicate ==
+                            BLE_SCAN_DUPLICATE_ENABLE;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_start_scanning(uint32_t duration) {
+    esp_ble_gap_cb_param_t *param =
+        schedule_gap(FAKE_BT_SCAN_START, ESP_GAP_BLE_SCAN_START_COMPLETE_EVT);
+    if (param == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    param->scan_start_cmpl.status = fakeBt.status[FAKE_BT_SCAN_START];
+    if (fakeBt.status[FAKE_BT_SCAN_START] != ESP_BT_STATUS_SUCCESS) {
+        return ESP_OK;
+    }
+    fakeBt.scanning = true;
+    fakeBt.scan_gen++;
+    fakeBt.reported = 0;
+    // The other devices advertise at the same interval, spread over it
+    for (uint32_t device = 0; device <= fakeBt.crowd; device++) {
+        int64_t phase = (int64_t) fakeBt.latency[FAKE_BT_ADV] *
+                        (device == 0 ? fakeBt.crowd + 1 : device) /
+                        (fakeBt.crowd + 1);
+        FakeBtEvt_t *evt = schedule(fakeBt.latency[FAKE_BT_SCAN_START] + phase,
+                                    EVT_ADV, 0, fakeBt.scan_gen);
+        if (evt != NULL) {
+            evt->arg = device;
+        }
+    }
+    if (duration > 0) {
+        schedule((int64_t) duration * 1000000, EVT_SCAN_END, 0,
+                 fakeBt.scan_gen);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_stop_scanning(void) {
+    fakeBt.scanning = false;
+    fakeBt.scan_gen++;
+    esp_ble_gap_cb_param_t *param =
+        schedule_gap(FAKE_BT_SCAN_STOP, ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT);
+    if (param == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    param->scan_stop_cmpl.status = fakeBt.status[FAKE_BT_SCAN_STOP];
+    return ESP_OK;
+}
+
+/**
+ * @brief Answer a change of the whitelist.
+ * 
+ * @param op The change.
+ * @param status Its status.
+ * @return ESP_OK, or ESP_ERR_NO_MEM if the event queue is full.
+*/
+static esp_err_t whitelist_cmpl(esp_ble_wl_operation_t op,
+                                esp_bt_status_t status) {
+    esp_ble_gap_cb_param_t *param =
+        schedule_gap(FAKE_BT_SCAN_PARAMS,
+                     ESP_GAP_BLE_UPDATE_WHITELIST_COMPLETE_EVT);
+    if (param == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    param->update_whitelist_cmpl.status = status;
+    param->update_whitelist_cmpl.wl_operation = op;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_update_whitelist(bool add_remove, esp_bd_addr_t remote_bda,
+                                       esp_ble_wl_addr_type_t wl_addr_type) {
+    int idx = find_wl(remote_bda);
+    if (add_remove) {
+        // Adding an address already in the whitelist succeeds
+        if (idx < 0 && fakeBt.wl_len == FAKE_BT_WHITELIST_LEN) {
+            return whitelist_cmpl(ESP_BLE_WHITELIST_ADD, ESP_BT_STATUS_NOMEM);
+        }
+        if (idx < 0) {
+            memcpy(fakeBt.whitelist[fakeBt.wl_len++], remote_bda,
+                   sizeof(esp_bd_addr_t));
+        }
+        return whitelist_cmpl(ESP_BLE_WHITELIST_ADD, ESP_BT_STATUS_SUCCESS);
+    }
+    if (idx >= 0) {
+        fakeBt.wl_len--;
+        memmove(fakeBt.whitelist[idx], fakeBt.whitelist[idx + 1],
+                (fakeBt.wl_len - idx) * sizeof(esp_bd_addr_t));
+    }
+    return whitelist_cmpl(ESP_BLE_WHITELIST_REMOVE, ESP_BT_STATUS_SUCCESS);
+}
+
+esp_err_t esp_ble_gap_clear_whitelist(void) {
+    fakeBt.wl_len = 0;
+    return whitelist_cmpl(ESP_BLE_WHITELIST_CLEAR, ESP_BT_STATUS_SUCCESS);
+}
+
+esp_err_t esp_ble_gap_update_conn_params(
+                                    esp_ble_conn_update_params_t *params) {
+    if (!fakeBt.connected || params->min_int > params->max_int) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // The update belongs to the link, and is dropped with it
+    FakeBtEvt_t *evt = schedule(fakeBt.latency[FAKE_BT_CONN_PARAMS], EVT_GAP,
+                                ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT,
+                                fakeBt.link_gen);
+    if (evt == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    struct ble_update_conn_params_evt_param *update =
+        &evt->param.gap.update_conn_params;
+    update->status = fakeBt.status[FAKE_BT_CONN_PARAMS];
+    if (update->status == ESP_BT_STATUS_SUCCESS &&
+        params->max_int < fakeBt.min_interval) {
+        update->status = ESP_BT_STATUS_UNACCEPT_CONN_INTERVAL;
+    }
+    memcpy(update->bda, params->bda, sizeof(esp_bd_addr_t));
+    update->min_int = params->min_int;
+    update->max_int = params->max_int;
+    update->timeout = params->timeout;
+    if (update->status == ESP_BT_STATUS_SUCCESS) {
+        // The shortest interval in the range the peer accepts
+        update->conn_int = params->min_int > fakeBt.min_interval ?
+                           params->min_int : fakeBt.min_interval;
+        update->latency = params->latency;
+    } else {
+        update->conn_int = fakeBt.interval;
+        update->latency = fakeBt.slave_latency;
+    }
+    return ESP_OK;
+}
+
+int esp_ble_get_bond_device_num(void) {
+    return fakeBt.bonded ? 1 : 0;
+}
+
+esp_err_t esp_ble_get_bond_device_list(int *dev_num,
+                                       esp_ble_bond_dev_t *dev_list) {
+    if (dev_num == NULL || dev_list == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (*dev_num > esp_ble_get_bond_device_num()) {
+        *dev_num = esp_ble_get_bond_device_num();
+    }
+    if (*dev_num > 0) {
+        memset(&dev_list[0], 0, sizeof(dev_list[0]));
+        memcpy(dev_list[0].bd_addr, fakeBt.bda, sizeof(esp_bd_addr_t));
+        dev_list[0].bond_key.key_mask = ESP_BLE_ENC_KEY_MASK |
+                                        ESP_BLE_ID_KEY_MASK;
+        dev_list[0].bond_key.pid_key.addr_type = BLE_ADDR_TYPE_PUBLIC;
+        memcpy(dev_list[0].bond_key.pid_key.static_addr, fakeBt.bda,
+               sizeof(esp_bd_addr_t));
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_set_security_param(esp_ble_sm_param_t param_type,
+                                         void *value, uint8_t len) {
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_security_rsp(esp_bd_addr_t bd_addr, bool accept) {
+    if (!fakeBt.connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Pairing, or only encryption once bonded, completes or fails on this link
+    // after the latency
+    FakeBtStep_t step = fakeBt.bonded ? FAKE_BT_ENCRYPT : FAKE_BT_AUTH;
+    FakeBtEvt_t *evt = schedule(fakeBt.latency[step], EVT_GAP,
+                                ESP_GAP_BLE_AUTH_CMPL_EVT, fakeBt.link_gen);
+    if (evt == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_ble_auth_cmpl_t *cmpl = &evt->param.gap.ble_security.auth_cmpl;
+    memcpy(cmpl->bd_addr, fakeBt.bda, sizeof(esp_bd_addr_t));
+    cmpl->success = accept && fakeBt.status[step] == 0;
+    cmpl->fail_reason = accept ? fakeBt.status[step] : 0x08;
+    cmpl->addr_type = BLE_ADDR_TYPE_PUBLIC;
+    cmpl->auth_mode = ESP_LE_AUTH_REQ_SC_BOND;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_passkey_reply(esp_bd_addr_t bd_addr, bool accept,
+                                uint32_t passkey) {
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_confirm_reply(esp_bd_addr_t bd_addr, bool accept) {
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_oob_req_reply(esp_bd_addr_t bd_addr, uint8_t *TK,
+                                uint8_t len) {
+    return ESP_OK;
+}
+
+uint8_t *esp_ble_resolve_adv_data(uint8_t *adv_data, uint8_t type,
+                                  uint8_t *length) {
+    size_t pos = 0;
+    size_t end = ESP_BLE_ADV_DATA_LEN_MAX + ESP_BLE_SCAN_RSP_DATA_LEN_MAX;
+    *length = 0;
+    while (adv_data != NULL && pos < end && adv_data[pos] != 0 &&
+           pos + 1 + adv_data[pos] <= end) {
+        uint8_t len = adv_data[pos];
+        if (adv_data[pos + 1] == type) {
+            *length = len - 1;
+            return &adv_data[pos + 2];
+        }
+        pos += 1 + len;
+    }
+    return NULL;
+}
+
+/**
+ * GATT client API
+*/
+
+esp_err_t esp_ble_gattc_register_callback(esp_gattc_cb_t callback) {
+    fakeBt.gattc_cb = callback;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gattc_app_register(uint16_t app_id) {
+    FakeBtEvt_t *evt = schedule(0, EVT_GATTC, ESP_GATTC_REG_EVT, 0);
+    if (evt == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    evt->param.gattc.reg.status = ESP_GATT_OK;
+    evt->param.gattc.reg.app_id = app_id;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gattc_open(esp_gatt_if_t gattc_if, esp_bd_addr_t remote_bda,
+                             esp_ble_addr_type_t remote_addr_type,
+                             bool is_direct) {
+    if (fakeBt.connecting) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (fakeBt.num_conns < FAKE_BT_MAX_CONNS) {
+        FakeBtConn_t *conn = &fakeBt.conns[fakeBt.num_conns];
+        memset(conn, 0xFF, sizeof(*conn));
+        conn->reports = 0;
+    }
+    fakeBt.num_conns++;
+    MARK(open_us);
+    fakeBt.connecting = true;
+    fakeBt.link_pending = false;
+    fakeBt.open_gen++;
+    // A direct connection waits for the peer to advertise, until it times out
+    if (schedule(fakeBt.latency[FAKE_BT_CONN_TIMEOUT], EVT_OPEN_END, 0,
+                 fakeBt.open_gen) == NULL) {
+        fakeBt.connecting = false;
+        return ESP_ERR_NO_MEM;
+    }
+    schedule_link();
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gattc_close(esp_gatt_if_t gattc_if, uint16_t conn_id) {
+    if (!fakeBt.connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    FakeBtEvt_t *evt = schedule(0, EVT_ACTION, FAKE_BT_DISCONNECT, 0);
+    if (evt == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    evt->arg = ESP_GATT_CONN_TERMINATE_LOCAL_HOST;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gattc_send_mtu_req(esp_gatt_if_t gattc_if,
+                                     uint16_t conn_id) {
+    if (!fakeBt.connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_ble_gattc_cb_param_t *param = schedule_gattc(FAKE_BT_MTU,
+                                                     ESP_GATTC_CFG_MTU_EVT);
+    if (param == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    param->cfg_mtu.status = fakeBt.status[FAKE_BT_MTU];
+    param->cfg_mtu.conn_id = conn_id;
+    param->cfg_mtu.mtu = FAKE_BT_MTU_SIZE;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gattc_search_service(esp_gatt_if_t gattc_if,
+                                       uint16_t conn_id,
+                                       esp_bt_uuid_t *filter_uuid) {
+    if (!fakeBt.connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint8_t status = fakeBt.status[FAKE_BT_SEARCH];
+    bool match = filter_uuid == NULL ||
+                 (filter_uuid->len == ESP_UUID_LEN_16 &&
+                  filter_uuid->uuid.uuid16 == 0x1812);
+    if (status == ESP_GATT_OK && match) {
+        esp_ble_gattc_cb_param_t *param =
+            schedule_gattc(FAKE_BT_SEARCH, ESP_GATTC_SEARCH_RES_EVT);
+        if (param == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        param->search_res.conn_id = conn_id;
+        param->search_res.start_handle = FAKE_BT_SRVC_START;
+        param->search_res.end_handle = FAKE_BT_SRVC_END;
+        param->search_res.srvc_id.uuid.len = ESP_UUID_LEN_16;
+        param->search_res.srvc_id.uuid.uuid.uuid16 = 0x1812;
+        param->search_res.is_primary = true;
+    }
+    esp_ble_gattc_cb_param_t *param =
+        schedule_gattc(FAKE_BT_SEARCH, ESP_GATTC_SEARCH_CMPL_EVT);
+    if (param == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    param->search_cmpl.status = status;
+    param->search_cmpl.conn_id = conn_id;
+    param->search_cmpl.searched_service_source =
+        ESP_GATT_SERVICE_FROM_REMOTE_DEVICE;
+    return ESP_OK;
+}
+
+/**
+ * @brief Find a characteristic of the peer by its value handle.
+ * 
+ * @param handle The value handle.
+ * @return The characteristic, or NULL if there is none.
+*/
+static const FakeBtChar_t *find_char(uint16_t handle) {
+    for (size_t i = 0; i < FAKE_BT_NUM_CHARS; i++) {
+        if (fakeChars[i].handle == handle) {
+            return &fakeChars[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Count the descriptors of a characteristic.
+ * 
+ * @param chr The characteristic.
+ * @return The number of descriptors.
+*/
+static uint16_t count_descrs(const FakeBtChar_t* chr) {
+    uint16_t count = 0;
+    while (count < 2 && chr->descr_uuids[count] != 0) {
+        count++;
+    }
+    return count;
+}
+
+esp_gatt_status_t esp_ble_gattc_get_attr_count(esp_gatt_if_t gattc_if,
+                                               uint16_t conn_id,
+                                               esp_gatt_db_attr_type_t type,
+                                               uint16_t start_handle,
+                                               uint16_t end_handle,
+                                               uint16_t char_handle,
+                                               uint16_t *count) {
+    *count = 0;
+    if (!fakeBt.connected) {
+        return ESP_GATT_INVALID_HANDLE;
+    }
+    if (type == ESP_GATT_DB_CHARACTERISTIC) {
+        for (size_t i = 0; i < FAKE_BT_NUM_CHARS; i++) {
+            if (fakeChars[i].handle >= start_handle &&
+                fakeChars[i].handle <= end_handle) {
+                (*count)++;
+            }
+        }
+        return ESP_GATT_OK;
+    }
+    if (type == ESP_GATT_DB_DESCRIPTOR) {
+        const FakeBtChar_t *chr = find_char(char_handle);
+        if (chr == NULL) {
+            return ESP_GATT_INVALID_HANDLE;
+        }
+        *count = count_descrs(chr);
+        return ESP_GATT_OK;
+    }
+    return ESP_GATT_NOT_FOUND;
+}
+
+esp_gatt_status_t esp_ble_gattc_get_all_char(esp_gatt_if_t gattc_if,
+                                             uint16_t conn_id,
+                                             uint16_t start_handle,
+                                             uint16_t end_handle,
+                                             esp_gattc_char_elem_t *result,
+                                             uint16_t *count, uint16_t offset) {
+    if (!fakeBt.connected) {
+        *count = 0;
+        return ESP_GATT_INVALID_HANDLE;
+    }
+    uint16_t found = 0;
+    uint16_t skipped = 0;
+    for (size_t i = 0; i < FAKE_BT_NUM_CHARS && found < *count; i++) {
+        if (fakeChars[i].handle < start_handle ||
+            fakeChars[i].handle > end_handle) {
+            continue;
+        }
+        if (skipped++ < offset) {
+            continue;
+        }
+        result[found].char_handle = fakeChars[i].handle;
+        result[found].properties = fakeChars[i].prop;
+        result[found].uuid.len = ESP_UUID_LEN_16;
+        result[found].uuid.uuid.uuid16 = fakeChars[i].uuid;
+        found++;
+    }
+    *count = found;
+    return found > 0 ? ESP_GATT_OK : ESP_GATT_NOT_FOUND;
+}
+
+esp_gatt_status_t esp_ble_gattc_get_all_descr(esp_gatt_if_t gattc_if,
+                                              uint16_t conn_id,
+                                              uint16_t char_handle,
+                                              esp_gattc_descr_elem_t *result,
+                                              uint16_t *count,
+                                              uint16_t offset) {
+    const FakeBtChar_t *chr = find_char(char_handle);
+    if (!fakeBt.connected || chr == NULL) {
+        *count = 0;
+        return ESP_GATT_INVALID_HANDLE;
+    }
+    uint16_t total = count_descrs(chr);
+    uint16_t found = 0;
+    for (uint16_t i = offset; i < total && found < *count; i++) {
+        // Descriptors follow the value handle
+        result[found].handle = char_handle + 1 + i;
+        result[found].uuid.len = ESP_UUID_LEN_16;
+        result[found].uuid.uuid.uuid16 = chr->descr_uuids[i];
+        found++;
+    }
+    *count = found;
+    return found > 0 ? ESP_GATT_OK : ESP_GATT_NOT_FOUND;
+}
+
+esp_err_t esp_ble_gattc_register_for_notify(esp_gatt_if_t gattc_if,
+                                            esp_bd_addr_t server_bda,
+                                            uint16_t handle) {
+    esp_ble_gattc_cb_param_t *param =
+        schedule_gattc(FAKE_BT_REG_NOTIFY, ESP_GATTC_REG_FOR_NOTIFY_EVT);
+    if (param == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    param->reg_for_notify.status = fakeBt.status[FAKE_BT_REG_NOTIFY];
+    param->reg_for_notify.handle = handle;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gattc_write_char_descr(esp_gatt_if_t gattc_if,
+                                         uint16_t conn_id, uint16_t handle,
+                                         uint16_t value_len, uint8_t *value,
+                                         esp_gatt_write_type_t write_type,
+                                         esp_gatt_auth_req_t auth_req) {
+    if (!fakeBt.connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    FakeBtEvt_t *evt = schedule(fakeBt.latency[FAKE_BT_WRITE_DESCR], EVT_GATTC,
+                                ESP_GATTC_WRITE_DESCR_EVT, fakeBt.link_gen);
+    if (evt == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    evt->arg = value_len > 0 ? value[0] : 0;
+    evt->no_rsp = write_type == ESP_GATT_WRITE_TYPE_NO_RSP;
+    evt->param.gattc.write.status = fakeBt.status[FAKE_BT_WRITE_DESCR];
+    evt->param.gattc.write.conn_id = conn_id;
+    evt->param.gattc.write.handle = handle;
+    return ESP_OK;
+}
@@ -0,0 +1,237 @@
+/**
+ * @file    fake_bt.h
+ * @brief   A scriptable stand-in for the Bluedroid stack and a Stadia
+ *          controller, so the firmware's BLE code runs on the host.
+ * 
+ * main/ble builds against the stand-in headers in this directory. Its calls
+ * into the GAP and GATT client APIs are answered by the same events the real
+ * stack sends, delivered to the registered esp_gap_cb and esp_gattc_cb after a
+ * configurable latency per step, on a simulated clock. The peer is a single
+ * controller that advertises its name, accepts one connection, asks for
+ * pairing, serves a HID service with one notifying report characteristic, and
+ * once its client configuration is written and the link is encrypted, sends a
+ * report from the report generator every connection interval.
+ * 
+ * Other devices can advertise alongside the peer, each once per advertising
+ * interval, with names that never match and a keyboard appearance for every
+ * fourth one. Scans honour the scan type, the duplicate filter and the
+ * whitelist.
+ * 
+ * A connection opened while the peer is not advertising waits for it to
+ * advertise again, until the connection times out. Once paired, the peer is
+ * bonded and later links are encrypted without pairing again. The stack's
+ * esp_timer one shot and periodic timers run on the same simulated clock.
+ * 
+ * The client may ask for new connection parameters. The peer accepts any
+ * interval down to its shortest, and rejects updates whose intervals are all
+ * shorter. While the pad rests, the peer repeats its last report and uses the
+ * slave latency to skip connection events, as a HID device with nothing new
+ * to send does.
+ * 
+ * Events can also be scheduled by a script: the peer disconnecting, changing
+ * its services, updating the connection interval, stopping or resuming its
+ * advertising, going quiet, and its pad resting or moving again. Any step can
+ * be made to fail with a status. Writes without response are reported as
+ * sent whatever their status, as the peer never answers them, and only take
+ * effect if they would have succeeded.
+ * 
+ * The milestones of every connection attempt are recorded against the
+ * simulated clock, from which the time to first report and the time to
+ * reconnect follow. Nothing runs in real time, so every run of a script is
+ * identical.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef FAKE_BT_H
+#define FAKE_BT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Connection attempts recorded, later attempts are not
+#define FAKE_BT_MAX_CONNS 64
+
+// Other devices that can advertise nearby
+#define FAKE_BT_MAX_CROWD 48
+
+/**
+ * @brief The steps of the stack and peer with a configurable latency.
+*/
+typedef enum FakeBtStep {
+    FAKE_BT_PRIVACY,      // Setting local privacy
+    FAKE_BT_SCAN_PARAMS,  // Setting the scan parameters
+    FAKE_BT_SCAN_START,   // Starting a scan
+    FAKE_BT_ADV,          // Between two advertisements of the peer
+    FAKE_BT_SCAN_STOP,    // Stopping a scan
+    FAKE_BT_CONNECT,      // Opening a connection to the peer
+    FAKE_BT_CONN_TIMEOUT, // Giving up on a connection the peer never accepts
+    FAKE_BT_AUTH,         // Pairing, from the security response to encryption
+    FAKE_BT_ENCRYPT,      // Encrypting a link with a bonded peer
+    FAKE_BT_MTU,          // The MTU exchange
+    FAKE_BT_SEARCH,       // Service discovery
+    FAKE_BT_REG_NOTIFY,   // Registering for notifications
+    FAKE_BT_WRITE_DESCR,  // Writing a descriptor
+    FAKE_BT_CONN_PARAMS,  // Updating the connection parameters
+    FAKE_BT_NUM_STEPS
+} FakeBtStep_t;
+
+/**
+ * @brief Scripted events of the peer.
+*/
+typedef enum FakeBtAction {
+    FAKE_BT_DISCONNECT,  // Drop the connection, the argument is the reason
+    FAKE_BT_SRVC_CHG,    // Indicate a service change, which clears the
+                         // client configuration as the Stadia controller does
+    FAKE_BT_CONN_UPDATE, // Change the connection interval to the argument, in
+                         // units of 1.25 ms
+    FAKE_BT_ADV_ON,      // Advertise while not connected, the default
+    FAKE_BT_ADV_OFF,     // Stop advertising
+    FAKE_BT_QUIET,       // Stop sending reports while staying connected
+    FAKE_BT_RESUME,      // Send reports again after FAKE_BT_QUIET
+    FAKE_BT_REST,        // Leave the pad at rest, repeating the last report
+    FAKE_BT_PLAY,        // Move the pad again after FAKE_BT_REST
+    FAKE_BT_NUM_ACTIONS
+} FakeBtAction_t;
+
+/**
+ * @brief The milestones of one connection attempt, in microseconds of the
+ *        simulated clock, or -1 if not reached.
+*/
+typedef struct FakeBtConn {
+    int64_t open_us;         // esp_ble_gattc_open called.
+    int64_t connect_us;      // Link established.
+    int64_t auth_us;         // Pairing completed.
+    int64_t discover_us;     // First service discovery completed.
+    int64_t subscribe_us;    // Notifications first enabled.
+    int64_t first_report_us; // First report notified.
+    int64_t disconnect_us;   // Link lost, or the attempt failed.
+    uint32_t reports;        // Reports notified.
+} FakeBtConn_t;
+
+/**
+ * @brief Reset the stack and the peer to their defaults, with nothing
+ *        scheduled and the clock at 0.
+ * 
+ * Every latency defaults to a typical value for the step, no step fails, the
+ * peer is named remote_device_name, asks for a 7.5 ms interval and accepts
+ * updates down to 7.5 ms.
+*/
+void fake_bt_reset(void);
+
+/**
+ * @brief Set the latency of a step.
+ * 
+ * @param step The step.
+ * @param us The latency in microseconds.
+*/
+void fake_bt_set_latency(FakeBtStep_t step, uint32_t us);
+
+/**
+ * @brief Make a step fail.
+ * 
+ * @param step The step.
+ * @param status The status of the event answering the step, 0 to succeed.
+*/
+void fake_bt_set_status(FakeBtStep_t step, uint8_t status);
+
+/**
+ * @brief Set the advertised name of the peer.
+ * 
+ * @param name The name, at most 29 characters.
+*/
+void fake_bt_set_name(const char* name);
+
+/**
+ * @brief Set the connection interval the peer connects with.
+ * 
+ * @param interval The interval in units of 1.25 ms.
+*/
+void fake_bt_set_interval(uint16_t interval);
+
+/**
+ * @brief Set the shortest connection interval the peer accepts in an update.
+ * 
+ * @param interval The interval in units of 1.25 ms.
+*/
+void fake_bt_set_min_interval(uint16_t interval);
+
+/**
+ * @brief Set the seed of the peer's report generator.
+ * 
+ * @param seed The seed, see rep_gen.h.
+*/
+void fake_bt_set_seed(uint32_t seed);
+
+/**
+ * @brief Start with the peer bonded, as after a restart, so it is in the bond
+ *        list and its links are only encrypted.
+ * 
+ * @param bonded Whether the peer is bonded.
+*/
+void fake_bt_set_bonded(bool bonded);
+
+/**
+ * @brief Make the peer refuse writes of its client configuration until the
+ *        link is encrypted, answering them with ESP_GATT_INSUF_ENCRYPTION.
+ * 
+ * @param secure Whether the client configuration needs encryption.
+*/
+void fake_bt_set_secure_ccc(bool secure);
+
+/**
+ * @brief Set the number of other devices advertising nearby.
+ * 
+ * @param devices The number of devices, at most FAKE_BT_MAX_CROWD.
+*/
+void fake_bt_set_crowd(uint32_t devices);
+
+/**
+ * @brief Schedule a scripted event.
+ * 
+ * @param at_us The time of the event on the simulated clock.
+ * @param action The event.
+ * @param arg The argument of the event, if it takes one.
+ * @return false if too many events are pending.
+*/
+bool fake_bt_at(int64_t at_us, FakeBtAction_t action, uint32_t arg);
+
+/**
+ * @brief Deliver the next event due no later than a time.
+ * 
+ * The clock moves to the event's time. Events scheduled from the callbacks
+ * are delivered by later calls.
+ * 
+ * @param until_us The latest time to deliver an event at.
+ * @return true if an event was delivered, false if none was due, in which
+ *         case the clock moves to until_us.
+*/
+bool fake_bt_step(int64_t until_us);
+
+/**
+ * @brief Read the simulated clock. Can be given to set_rep_clock.
+ * 
+ * @return The time in microseconds.
+*/
+int64_t fake_bt_now(void);
+
+/**
+ * @brief Get the recorded connection attempts.
+ * 
+ * @param count Set to the number of attempts.
+ * @return The attempts in the order they were made.
+*/
+const FakeBtConn_t *fake_bt_conns(size_t* count);
+
+/**
+ * @brief Log every delivered event, except notifications.
+ * 
+ * @param out The stream to log to, NULL to stop logging.
+*/
+void fake_bt_log(FILE* out);
+
+#endif /* #ifndef FAKE_BT_H */
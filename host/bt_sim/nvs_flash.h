@@ -0,0 +1,19 @@
+/**
+ * @file    nvs_flash.h
+ * @brief   Host stand-in for the NVS flash initialization API. There is no
+ *          flash to set up, so both calls succeed.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef FAKE_NVS_FLASH_H
+#define FAKE_NVS_FLASH_H
+
+#include "nvs.h"
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+
+#endif /* #ifndef FAKE_NVS_FLASH_H */
@@ -0,0 +1,138 @@
+/**
+ * @file    stadia_decoder.c
+ * @brief   Host side decoder for the StadiaCon binary output protocol.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "stadia_decoder.h"
+
+#include <string.h>
+
+void stadia_decoder_init(StadiaDecoder_t *dec) {
+    memset(dec, 0, sizeof(*dec));
+    // A released controller: no D-pad direction and sticks centered
+    dec->state.value[CON_DPD][0] = 8;
+    dec->state.value[CON_LJS][0] = 0x80;
+    dec->state.value[CON_LJS][1] = 0x80;
+    dec->state.value[CON_RJS][0] = 0x80;
+    dec->state.value[CON_RJS][1] = 0x80;
+}
+
+bool stadia_decode_frame(StadiaDecoder_t *dec, const uint8_t *raw, size_t len,
+                         StadiaFrame_t *frame) {
+    if (len < 1) {
+        return false;
+    }
+    frame->type = raw[0] & BIN_FRAME_TYPE_MASK;
+    if (raw[0] == BIN_FRAME_TRACE) {
+        // Trace frames hold a raw notification and leave the state alone
+        if (len != 1 + TRACE_REC_LEN + BIN_CRC_LEN ||
+            crc16_ccitt(raw, len - BIN_CRC_LEN) !=
+            (raw[len - 2] | (uint16_t) raw[len - 1] << 8)) {
+            return false;
+        }
+        memset(frame, 0, sizeof(*frame));
+        frame->type = BIN_FRAME_TRACE;
+        trace_get_rec(raw + 1, &frame->trace);
+        frame->state = &dec->state;
+        return true;
+    }
+    frame->has_seq = (raw[0] & BIN_FRAME_SEQ) != 0;
+    frame->has_stamp = (raw[0] & BIN_FRAME_STAMP) != 0;
+    frame->has_latency = (raw[0] & BIN_FRAME_LATENCY) != 0;
+    size_t pos = 1 + (frame->has_seq ? 1 : 0);
+    if (frame->has_stamp || frame->has_latency) {
+        pos += BIN_STAMP_LEN;
+    }
+    if (len < pos + BIN_MASK_LEN + BIN_CRC_LEN) {
+        return false;
+    }
+    frame->seq = frame->has_seq ? raw[1] : 0;
+    frame->stamp_us = 0;
+    if (frame->has_stamp || frame->has_latency) {
+        const uint8_t *stamp = raw + pos - BIN_STAMP_LEN;
+        frame->stamp_us = stamp[0] | (uint32_t) stamp[1] << 8 |
+                          (uint32_t) stamp[2] << 16 | (uint32_t) stamp[3] << 24;
+    }
+    uint16_t crc = raw[len - 2] | (uint16_t) raw[len - 1] << 8;
+    if (crc16_ccitt(raw, len - BIN_CRC_LEN) != crc) {
+        return false;
+    }
+    uint32_t mask = raw[pos] | (uint32_t) raw[pos + 1] << 8 |
+                    (uint32_t) raw[pos + 2] << 16;
+    if (mask >> CON_NUM_CONTROLS) {
+        return false;
+    }
+    pos += BIN_MASK_LEN;
+    // Delta and snapshot frames carry values, command answers only the mask
+    bool values = frame->type == BIN_FRAME_DELTA ||
+                  frame->type == BIN_FRAME_SNAPSHOT;
+    // Check the value bytes line up with the mask before applying any
+    size_t need = 0;
+    for (uint8_t idx = 0; values && idx < CON_NUM_CONTROLS; idx++) {
+        if (mask & ((uint32_t) 1 << idx)) {
+            need += bin_value_len(idx);
+        }
+    }
+    if (pos + need + BIN_CRC_LEN != len) {
+        return false;
+    }
+    for (uint8_t idx = 0; values && idx < CON_NUM_CONTROLS; idx++) {
+        if (mask & ((uint32_t) 1 << idx)) {
+            for (size_t i = 0; i < bin_value_len(idx); i++) {
+                dec->state.value[idx][i] = raw[pos++];
+            }
+        }
+    }
+    // A gap in the sequence means the state missed changes
+    if (frame->has_seq) {
+        if (dec->has_seq && frame->seq != dec->next_seq) {
+            dec->lost += (uint8_t) (frame->seq - dec->next_seq);
+            dec->synced = false;
+        }
+        dec->has_seq = true;
+        dec->next_seq = frame->seq + 1;
+    }
+    if (frame->type == BIN_FRAME_SNAPSHOT) {
+        dec->synced = true;
+    }
+    frame->mask = mask;
+    frame->state = &dec->state;
+    return true;
+}
+
+size_t stadia_decoder_feed(StadiaDecoder_t *dec, const uint8_t *data,
+                           size_t len, stadia_frame_cb_t cb, void *ctx) {
+    size_t frames = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != 0x00) {
+            if (dec->len < sizeof(dec->buf)) {
+                dec->buf[dec->len++] = data[i];
+            } else {
+                dec->overflow = true;
+            }
+            continue;
+        }
+        // End of frame
+        uint8_t raw[BIN_ENCODED_MAX_LEN];
+        size_t raw_len = dec->overflow ? 0
+                         : cobs_decode(dec->buf, dec->len, raw);
+        StadiaFrame_t frame;
+        if (raw_len > 0 && stadia_decode_frame(dec, raw, raw_len, &frame)) {
+            dec->frames++;
+            frames++;
+            if (cb != NULL) {
+                cb(&frame, ctx);
+            }
+        } else if (dec->len > 0 || dec->overflow) {
+            dec->errors++;
+            dec->synced = false;
+        }
+        dec->len = 0;
+        dec->overflow = false;
+    }
+    return frames;
+}
@@ -0,0 +1,126 @@
+/**
+ * @file    stadia_decoder.h
+ * @brief   Host side decoder for the StadiaCon binary output protocol.
+ * 
+ * Feed the bytes read from the serial port to stadia_decoder_feed in chunks of
+ * any size. Every complete, valid frame updates the decoder's copy of the
+ * controller state and is passed to a callback. Frames that fail COBS decoding
+ * or the CRC check are counted and skipped; decoding resumes at the next 0x00
+ * delimiter. The frame layout is described in main/publish/bin_proto.h.
+ * 
+ * The decoder's state is only known to match the controller once a snapshot
+ * frame has been applied, which the synced flag tracks. A dropped frame, or a
+ * gap in the sequence numbers when they are enabled, clears the flag until
+ * the next snapshot, e.g. the next keyframe or the answer to a '?' request.
+ * 
+ * Usable from C and C++.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef STADIA_DECODER_H
+#define STADIA_DECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "bin_proto.h"
+#include "trace_fmt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief The controller state as carried by the binary protocol.
+ * 
+ * Values are raw: value[i][0] is the D-pad direction, the button state (0/1),
+ * the trigger position or the joystick x, and value[i][1] the joystick y.
+*/
+typedef struct StadiaValues {
+    uint8_t value[CON_NUM_CONTROLS][2];
+} StadiaValues_t;
+
+/**
+ * @brief One decoded frame.
+*/
+typedef struct StadiaFrame {
+    uint8_t type;                // The frame type, e.g. BIN_FRAME_DELTA,
+                                 // without the flag bits.
+    bool has_seq;                // The frame carries a sequence number.
+    uint8_t seq;                 // The sequence number if has_seq is set.
+    bool has_stamp;              // The frame carries an arrival time.
+    bool has_latency;            // The frame carries a latency.
+    uint32_t stamp_us;           // The arrival time or latency, if any.
+    uint32_t mask;               // The controls carried in this frame, or
+                                 // the published controls for ACK and NAK.
+    const StadiaValues_t *state; // Full controller state after this frame.
+    TraceRec_t trace;            // The notification of a BIN_FRAME_TRACE
+                                 // frame, which carries no mask or values.
+} StadiaFrame_t;
+
+/**
+ * @brief Called for every valid frame.
+ * 
+ * @param frame The decoded frame. Only valid during the call.
+ * @param ctx The context pointer given to stadia_decoder_feed.
+*/
+typedef void (*stadia_frame_cb_t)(const StadiaFrame_t *frame, void *ctx);
+
+/**
+ * @brief Decoder state. Treat as opaque apart from the counters.
+*/
+typedef struct StadiaDecoder {
+    uint8_t buf[BIN_ENCODED_MAX_LEN]; // Encoded bytes of the current frame.
+    size_t len;                       // The number of bytes in buf.
+    bool overflow;                    // Current frame is too long, skip it.
+    StadiaValues_t state;             // Controller state from all frames.
+    bool synced;                      // state is known to match the device.
+    bool has_seq;                     // A sequence number has been seen.
+    uint8_t next_seq;                 // The sequence number expected next.
+    uint32_t frames;                  // Valid frames decoded.
+    uint32_t errors;                  // Frames dropped as malformed.
+    uint32_t lost;                    // Frames missing from the sequence.
+} StadiaDecoder_t;
+
+/**
+ * @brief Reset a decoder. The state starts as a released controller, but is
+ *        not synced until a snapshot frame is received.
+ * 
+ * @param dec The decoder to reset.
+*/
+void stadia_decoder_init(StadiaDecoder_t *dec);
+
+/**
+ * @brief Decode a chunk of bytes from the output stream.
+ * 
+ * @param dec The decoder.
+ * @param data The bytes read.
+ * @param len The number of bytes in data.
+ * @param cb Called for every valid frame completed by these bytes. May be NULL.
+ * @param ctx Passed to cb.
+ * @return The number of valid frames completed by these bytes.
+*/
+size_t stadia_decoder_feed(StadiaDecoder_t *dec, const uint8_t *data,
+                           size_t len, stadia_frame_cb_t cb, void *ctx);
+
+/**
+ * @brief Decode one complete frame, without its COBS encoding.
+ * 
+ * @param dec The decoder whose state the frame updates.
+ * @param raw The decoded frame bytes, including type and CRC.
+ * @param len The number of bytes in raw.
+ * @param frame Filled in with the frame's contents on success.
+ * @return true if the frame was valid, false otherwise.
+*/
+bool stadia_decode_frame(StadiaDecoder_t *dec, const uint8_t *raw, size_t len,
+                         StadiaFrame_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef STADIA_DECODER_H */
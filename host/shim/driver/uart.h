@@ -0,0 +1,45 @@
+/**
+ * @file    uart.h
+ * @brief   Host shim of the ESP-IDF UART driver.
+ * 
+ * Written bytes go to the sink of host_shim.h and read bytes come from its
+ * simulated input.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef SHIM_UART_H
+#define SHIM_UART_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_err.h"
+
+typedef int uart_port_t;
+
+#define UART_NUM_0 0
+#define UART_NUM_1 1
+
+typedef enum {
+    UART_DATA,
+    UART_BREAK,
+    UART_BUFFER_FULL,
+    UART_FIFO_OVF,
+    UART_FRAME_ERR,
+    UART_PARITY_ERR,
+} uart_event_type_t;
+
+typedef struct {
+    uart_event_type_t type;
+    size_t size;
+    bool timeout_flag;
+} uart_event_t;
+
+int uart_write_bytes(uart_port_t port, const void* src, size_t size);
+int uart_read_bytes(uart_port_t port, void* buf, uint32_t length,
+                    TickType_t ticks);
+esp_err_t uart_flush_input(uart_port_t port);
+
+#endif /* #ifndef SHIM_UART_H */
@@ -0,0 +1,51 @@
+/**
+ * @file    esp_log.h
+ * @brief   Host shim of the ESP-IDF logging macros, printing to stderr.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef SHIM_ESP_LOG_H
+#define SHIM_ESP_LOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define ESP_LOGE(tag, fmt, ...) \
+    fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) \
+    fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) \
+    fprintf(stderr, "I %s: " fmt "\n", tag, ##__VA_ARGS__)
+
+/**
+ * @brief Log a buffer as hex bytes.
+ * 
+ * @param tag The log tag.
+ * @param buf The bytes.
+ * @param len The number of bytes.
+*/
+static inline void esp_log_buffer_hex(const char* tag, const void* buf,
+                                      uint16_t len) {
+    fprintf(stderr, "I %s: ", tag);
+    for (uint16_t i = 0; i < len; i++) {
+        fprintf(stderr, "%02x ", ((const uint8_t *) buf)[i]);
+    }
+    fputc('\n', stderr);
+}
+
+/**
+ * @brief Log a buffer as characters.
+ * 
+ * @param tag The log tag.
+ * @param buf The characters.
+ * @param len The number of characters.
+*/
+static inline void esp_log_buffer_char(const char* tag, const void* buf,
+                                       uint16_t len) {
+    fprintf(stderr, "I %s: %.*s\n", tag, (int) len, (const char *) buf);
+}
+
+#endif /* #ifndef SHIM_ESP_LOG_H */
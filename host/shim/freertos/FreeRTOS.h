@@ -0,0 +1,49 @@
+/**
+ * @file    FreeRTOS.h
+ * @brief   Host shim of the FreeRTOS base types used by the publish pipeline.
+ * 
+ * Only what main/publish and globalconst.c use is provided, implemented on
+ * pthreads in shim.c. Ticks are milliseconds.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef SHIM_FREERTOS_H
+#define SHIM_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+typedef struct ShimObj *TaskHandle_t;
+typedef struct ShimObj *SemaphoreHandle_t;
+typedef struct ShimObj *QueueHandle_t;
+
+// Critical sections all share one lock on the host
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+
+#define portMAX_DELAY      ((TickType_t) 0xFFFFFFFF)
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)  ((TickType_t) (ms))
+
+void taskENTER_CRITICAL(portMUX_TYPE* mux);
+void taskEXIT_CRITICAL(portMUX_TYPE* mux);
+#define portENTER_CRITICAL taskENTER_CRITICAL
+#define portEXIT_CRITICAL  taskEXIT_CRITICAL
+
+#endif /* #ifndef SHIM_FREERTOS_H */
@@ -0,0 +1,21 @@
+/**
+ * @file    queue.h
+ * @brief   Host shim of the FreeRTOS queue API.
+ * 
+ * The only queue the pipeline reads is the UART event queue, so queues are
+ * backed by the simulated UART input of host_shim.h.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef SHIM_QUEUE_H
+#define SHIM_QUEUE_H
+
+#include "freertos/FreeRTOS.h"
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks);
+BaseType_t xQueueReset(QueueHandle_t queue);
+
+#endif /* #ifndef SHIM_QUEUE_H */
@@ -0,0 +1,36 @@
+/**
+ * @file    task.h
+ * @brief   Host shim of the FreeRTOS task and notification API.
+ * 
+ * Tasks are detached pthreads. Every thread gets a handle on first use, so the
+ * thread driving the pipeline can be notified like the publishing task.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef SHIM_TASK_H
+#define SHIM_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef enum {
+    eNoAction,
+    eSetBits,
+    eIncrement,
+} eNotifyAction;
+
+typedef void (*TaskFunction_t)(void *);
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+BaseType_t xTaskCreate(TaskFunction_t func, const char* name, uint32_t stack,
+                       void* arg, UBaseType_t prio, TaskHandle_t* handle);
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value,
+                       eNotifyAction action);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit,
+                           uint32_t* value, TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+void vTaskDelay(TickType_t ticks);
+
+#endif /* #ifndef SHIM_TASK_H */
@@ -0,0 +1,83 @@
+/**
+ * @file    host_shim.h
+ * @brief   Access to the simulated UART port of the host shims.
+ * 
+ * The publish pipeline builds on the host against the shim headers in this
+ * directory in place of FreeRTOS and ESP-IDF. Bytes it writes to the UART are
+ * counted and, while capture is enabled, kept in a growing buffer. Bytes given
+ * to host_uart_input are delivered to the UART command task as if they had
+ * been received.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef HOST_SHIM_H
+#define HOST_SHIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @brief Enable or disable keeping the bytes written to the UART. Enabled by
+ *        default. Writes are counted either way.
+ * 
+ * @param enable True to keep written bytes.
+*/
+void host_uart_capture(bool enable);
+
+/**
+ * @brief Get the bytes written to the UART while capture was enabled.
+ * 
+ * @param len Set to the number of bytes.
+ * @return The bytes, valid until the next write or reset.
+*/
+const uint8_t *host_uart_output(size_t* len);
+
+/**
+ * @brief Get the number of bytes written to the UART.
+ * 
+ * @return The bytes written since the last reset.
+*/
+uint64_t host_uart_bytes(void);
+
+/**
+ * @brief Get the number of calls to uart_write_bytes.
+ * 
+ * @return The writes since the last reset.
+*/
+uint64_t host_uart_writes(void);
+
+/**
+ * @brief Get the number of newline characters written to the UART, the lines
+ *        of ASCII output.
+ * 
+ * @return The newlines since the last reset.
+*/
+uint64_t host_uart_lines(void);
+
+/**
+ * @brief Get the number of 0x00 bytes written to the UART, the delimiters
+ *        ending the frames of binary output.
+ * 
+ * @return The delimiters since the last reset.
+*/
+uint64_t host_uart_frames(void);
+
+/**
+ * @brief Clear the captured output and the write counters.
+*/
+void host_uart_reset(void);
+
+/**
+ * @brief Simulate bytes received on the UART port.
+ * 
+ * @param data The bytes received.
+ * @param len The number of bytes. Input beyond the free space of the receive
+ *            buffer is dropped and reported as a UART_BUFFER_FULL event.
+*/
+void host_uart_input(const void* data, size_t len);
+
+#endif /* #ifndef HOST_SHIM_H */
@@ -0,0 +1,17 @@
+/**
+ * @file    ets_sys.h
+ * @brief   Host shim of the ROM console, printing to stdout.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef SHIM_ETS_SYS_H
+#define SHIM_ETS_SYS_H
+
+#include <stdio.h>
+
+#define ets_printf printf
+
+#endif /* #ifndef SHIM_ETS_SYS_H */
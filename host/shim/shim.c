@@ -0,0 +1,418 @@
+/**
+ * @file    shim.c
+ * @brief   pthread implementations of the FreeRTOS and ESP-IDF host shims.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "host_shim.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "driver/uart.h"
+#include "esp_timer.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief The object behind every task and semaphore handle: a count or a set
+ *        of notification bits guarded by a mutex and condition variable.
+*/
+struct ShimObj {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t bits;     // Notification value of a task
+    uint32_t count;    // Pending notifications, or the semaphore count
+    uint32_t max;      // Largest count of a semaphore, 0 for no limit
+};
+
+/**
+ * @brief Allocate and initialize a shim object.
+ * 
+ * @return The object.
+*/
+static struct ShimObj *shim_obj_create(void) {
+    struct ShimObj *obj = calloc(1, sizeof(*obj));
+    if (obj == NULL) {
+        abort();
+    }
+    pthread_mutex_init(&obj->lock, NULL);
+    pthread_cond_init(&obj->cond, NULL);
+    return obj;
+}
+
+/**
+ * @brief Convert a timeout in ticks to an absolute deadline.
+ * 
+ * @param ticks The timeout in milliseconds.
+ * @param ts Set to the deadline on the realtime clock.
+*/
+static void shim_deadline(TickType_t ticks, struct timespec* ts) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += ticks / 1000;
+    ts->tv_nsec += (long) (ticks % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+/**
+ * @brief Wait on an object until its count is non zero or a timeout passes.
+ *        Called with the object's lock held.
+ * 
+ * @param obj The object.
+ * @param ticks The timeout in milliseconds, or portMAX_DELAY.
+ * @return true if the count is non zero.
+*/
+static bool shim_wait(struct ShimObj* obj, TickType_t ticks) {
+    struct timespec ts;
+    shim_deadline(ticks, &ts);
+    while (obj->count == 0) {
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(&obj->cond, &obj->lock);
+        } else if (ticks == 0 ||
+                   pthread_cond_timedwait(&obj->cond, &obj->lock, &ts) != 0) {
+            return obj->count != 0;
+        }
+    }
+    return true;
+}
+
+/**
+ * Tasks
+*/
+
+// Handle of the calling thread, created on first use
+static __thread struct ShimObj *currentTask;
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    if (currentTask == NULL) {
+        currentTask = shim_obj_create();
+    }
+    return currentTask;
+}
+
+/**
+ * @brief The function and argument of a task being started.
+*/
+typedef struct ShimTask {
+    TaskFunction_t func;
+    void *arg;
+    struct ShimObj *handle;
+} ShimTask_t;
+
+/**
+ * @brief Thread entry point running a task.
+ * 
+ * @param arg The ShimTask_t to run, freed here.
+*/
+static void *shim_task_entry(void* arg) {
+    ShimTask_t task = *(ShimTask_t *) arg;
+    free(arg);
+    currentTask = task.handle;
+    task.func(task.arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t func, const char* name, uint32_t stack,
+                       void* arg, UBaseType_t prio, TaskHandle_t* handle) {
+    (void) name;
+    (void) stack;
+    (void) prio;
+    ShimTask_t *task = malloc(sizeof(*task));
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    task->func = func;
+    task->arg = arg;
+    task->handle = shim_obj_create();
+    if (handle != NULL) {
+        *handle = task->handle;
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, shim_task_entry, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+    return pdPASS;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value,
+                       eNotifyAction action) {
+    pthread_mutex_lock(&task->lock);
+    if (action == eSetBits) {
+        task->bits |= value;
+    } else if (action == eIncrement) {
+        task->bits++;
+    }
+    task->count = 1;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit,
+                           uint32_t* value, TickType_t ticks) {
+    struct ShimObj *task = xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&task->lock);
+    if (task->count == 0) {
+        task->bits &= ~clear_on_entry;
+    }
+    bool notified = shim_wait(task, ticks);
+    if (value != NULL) {
+        *value = task->bits;
+    }
+    if (notified) {
+        task->bits &= ~clear_on_exit;
+        task->count = 0;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return notified ? pdTRUE : pdFALSE;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t) (esp_timer_get_time() / 1000);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    struct timespec ts = {ticks / 1000, (long) (ticks % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+// Lock shared by every critical section
+static pthread_mutex_t criticalLock = PTHREAD_MUTEX_INITIALIZER;
+
+void taskENTER_CRITICAL(portMUX_TYPE* mux) {
+    (void) mux;
+    pthread_mutex_lock(&criticalLock);
+}
+
+void taskEXIT_CRITICAL(portMUX_TYPE* mux) {
+    (void) mux;
+    pthread_mutex_unlock(&criticalLock);
+}
+
+/**
+ * Semaphores
+*/
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    struct ShimObj *sem = shim_obj_create();
+    sem->max = 1;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max,
+                                           UBaseType_t initial) {
+    struct ShimObj *sem = shim_obj_create();
+    sem->max = max;
+    sem->count = initial;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    struct ShimObj *sem = xSemaphoreCreateBinary();
+    sem->count = 1;
+    return sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    pthread_mutex_lock(&sem->lock);
+    bool taken = shim_wait(sem, ticks);
+    if (taken) {
+        sem->count--;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return taken ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    pthread_mutex_lock(&sem->lock);
+    if (sem->max == 0 || sem->count < sem->max) {
+        sem->count++;
+    }
+    pthread_cond_signal(&sem->cond);
+    pthread_mutex_unlock(&sem->lock);
+    return pdTRUE;
+}
+
+/**
+ * Timer
+*/
+
+int64_t esp_timer_get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * UART output
+*/
+
+// Bytes written while capture is enabled, and the write counters
+static uint8_t *uartOut = NULL;
+static size_t uartOutLen = 0;
+static size_t uartOutCap = 0;
+static bool uartCapture = true;
+static uint64_t uartBytes = 0;
+static uint64_t uartWrites = 0;
+static uint64_t uartLines = 0;
+static uint64_t uartFrames = 0;
+static pthread_mutex_t uartOutLock = PTHREAD_MUTEX_INITIALIZER;
+
+int uart_write_bytes(uart_port_t port, const void* src, size_t size) {
+    (void) port;
+    pthread_mutex_lock(&uartOutLock);
+    uartBytes += size;
+    uartWrites++;
+    for (size_t i = 0; i < size; i++) {
+        uint8_t byte = ((const uint8_t *) src)[i];
+        uartLines += byte == '\n';
+        uartFrames += byte == 0x00;
+    }
+    if (uartCapture) {
+        if (uartOutLen + size > uartOutCap) {
+            size_t cap = uartOutCap ? uartOutCap : 4096;
+            while (cap < uartOutLen + size) {
+                cap *= 2;
+            }
+            uint8_t *out = realloc(uartOut, cap);
+            if (out == NULL) {
+                abort();
+            }
+            uartOut = out;
+            uartOutCap = cap;
+        }
+        memcpy(uartOut + uartOutLen, src, size);
+        uartOutLen += size;
+    }
+    pthread_mutex_unlock(&uartOutLock);
+    return (int) size;
+}
+
+void host_uart_capture(bool enable) {
+    pthread_mutex_lock(&uartOutLock);
+    uartCapture = enable;
+    pthread_mutex_unlock(&uartOutLock);
+}
+
+const uint8_t *host_uart_output(size_t* len) {
+    *len = uartOutLen;
+    return uartOut;
+}
+
+uint64_t host_uart_bytes(void) {
+    return uartBytes;
+}
+
+uint64_t host_uart_writes(void) {
+    return uartWrites;
+}
+
+uint64_t host_uart_lines(void) {
+    return uartLines;
+}
+
+uint64_t host_uart_frames(void) {
+    return uartFrames;
+}
+
+void host_uart_reset(void) {
+    pthread_mutex_lock(&uartOutLock);
+    uartOutLen = 0;
+    uartBytes = 0;
+    uartWrites = 0;
+    uartLines = 0;
+    uartFrames = 0;
+    pthread_mutex_unlock(&uartOutLock);
+}
+
+/**
+ * UART input
+*/
+
+// Size of the simulated receive buffer
+#define UART_RX_BUF_LEN 4096
+
+// Received bytes not read yet, and whether input was lost since the last
+// event. The receive buffer doubles as the UART event queue.
+static uint8_t uartIn[UART_RX_BUF_LEN];
+static size_t uartInLen = 0;
+static bool uartInFull = false;
+static pthread_mutex_t uartInLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t uartInCond = PTHREAD_COND_INITIALIZER;
+
+void host_uart_input(const void* data, size_t len) {
+    pthread_mutex_lock(&uartInLock);
+    size_t room = UART_RX_BUF_LEN - uartInLen;
+    if (len > room) {
+        len = room;
+        uartInFull = true;
+    }
+    memcpy(uartIn + uartInLen, data, len);
+    uartInLen += len;
+    pthread_cond_signal(&uartInCond);
+    pthread_mutex_unlock(&uartInLock);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks) {
+    (void) queue;
+    uart_event_t *event = item;
+    struct timespec ts;
+    shim_deadline(ticks, &ts);
+    pthread_mutex_lock(&uartInLock);
+    while (uartInLen == 0 && !uartInFull) {
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(&uartInCond, &uartInLock);
+        } else if (ticks == 0 ||
+                   pthread_cond_timedwait(&uartInCond, &uartInLock, &ts)) {
+            pthread_mutex_unlock(&uartInLock);
+            return pdFALSE;
+        }
+    }
+    memset(event, 0, sizeof(*event));
+    if (uartInFull) {
+        event->type = UART_BUFFER_FULL;
+        uartInFull = false;
+    } else {
+        event->type = UART_DATA;
+        event->size = uartInLen;
+    }
+    pthread_mutex_unlock(&uartInLock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    (void) queue;
+    return pdPASS;
+}
+
+int uart_read_bytes(uart_port_t port, void* buf, uint32_t length,
+                    TickType_t ticks) {
+    (void) port;
+    (void) ticks;
+    pthread_mutex_lock(&uartInLock);
+    size_t len = length < uartInLen ? length : uartInLen;
+    memcpy(buf, uartIn, len);
+    memmove(uartIn, uartIn + len, uartInLen - len);
+    uartInLen -= len;
+    pthread_mutex_unlock(&uartInLock);
+    return (int) len;
+}
+
+esp_err_t uart_flush_input(uart_port_t port) {
+    (void) port;
+    pthread_mutex_lock(&uartInLock);
+    uartInLen = 0;
+    pthread_mutex_unlock(&uartInLock);
+    return 0;
+}
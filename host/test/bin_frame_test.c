@@ -0,0 +1,100 @@
+/**
+ * @file    bin_frame_test.c
+ * @brief   Test of binary frames filling the output frame of a batch.
+ * 
+ * A batch of reports alternating between every button pressed and none is
+ * published in the binary format with sequence numbers and timestamps, so
+ * the encoded frames overflow the output frame part way through the batch.
+ * The UART output is decoded and every report must come back as one delta
+ * frame, in order and with the expected button values.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "con_state.h"
+#include "globalconst.h"
+#include "host_shim.h"
+#include "stadia_decoder.h"
+
+#include <stdio.h>
+
+// Reports in the batch, enough to fill the output frame more than once
+#define TEST_REPS 20
+
+// The controls of the buttons, CON_RSB to CON_LSB
+#define TEST_BUTTON_MASK ((((uint32_t) 1 << CON_LJS) - 1) & ~(uint32_t) 1)
+
+// Frames decoded so far
+static size_t frames = 0;
+
+// Problems found
+static int failures = 0;
+
+/**
+ * @brief Check a decoded frame against the report it was built from.
+ * 
+ * @param frame The decoded frame.
+ * @param ctx Unused.
+*/
+static void check_frame(const StadiaFrame_t *frame, void *ctx) {
+    (void) ctx;
+    size_t i = frames++;
+    if (frame->type != BIN_FRAME_DELTA || !frame->has_seq ||
+        frame->seq != i || !frame->has_stamp ||
+        frame->mask != TEST_BUTTON_MASK) {
+        fprintf(stderr, "frame %zu: type %u, seq %u, mask %06x\n", i,
+                frame->type, frame->seq, (unsigned) frame->mask);
+        failures++;
+        return;
+    }
+    uint8_t pressed = i % 2 == 0;
+    for (int idx = CON_RSB; idx <= CON_LSB; idx++) {
+        if (frame->state->value[idx][0] != pressed) {
+            fprintf(stderr, "frame %zu: control %d is %u\n", i, idx,
+                    frame->state->value[idx][0]);
+            failures++;
+        }
+    }
+}
+
+int main(void) {
+    output_format = OUTPUT_BINARY;
+    output_sequence = true;
+    output_stamp = STAMP_INGRESS;
+    for (int idx = 0; idx < CON_NUM_CONTROLS; idx++) {
+        publish_controls[idx] = true;
+    }
+    static ConState_t state;
+    init_controller(&state);
+    host_uart_reset();
+
+    StadiaRep_t reps[TEST_REPS];
+    for (size_t i = 0; i < TEST_REPS; i++) {
+        reps[i] = state.prev;
+        reps[i].buttons1 = i % 2 == 0 ? 0xFF : 0x00;
+        reps[i].buttons2 = i % 2 == 0 ? 0xFF : 0x00;
+        reps[i].stamp_us = 1000 * (i + 1);
+    }
+    update_controller_batch(&state, reps, TEST_REPS);
+
+    size_t len;
+    const uint8_t *out = host_uart_output(&len);
+    static StadiaDecoder_t dec;
+    stadia_decoder_init(&dec);
+    stadia_decoder_feed(&dec, out, len, check_frame, NULL);
+    if (frames != TEST_REPS || dec.errors != 0 || dec.lost != 0) {
+        fprintf(stderr, "%zu frames, %u errors, %u lost\n", frames,
+                (unsigned) dec.errors, (unsigned) dec.lost);
+        failures++;
+    }
+    if (host_uart_writes() < 2) {
+        fprintf(stderr, "the batch did not fill the output frame\n");
+        failures++;
+    }
+    printf("%s: %zu bytes in %llu writes, %zu frames\n",
+           failures ? "FAIL" : "PASS", len,
+           (unsigned long long) host_uart_writes(), frames);
+    return failures ? 1 : 0;
+}
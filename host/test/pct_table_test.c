@@ -0,0 +1,73 @@
+/**
+ * @file    pct_table_test.c
+ * @brief   Test of the precomputed percentage tables against float formatting.
+ * 
+ * Every entry of sign_pct_str, neg_sign_pct_str and unsign_pct_str must match
+ * what the controller state printed before the tables, the percentage computed
+ * as a float and formatted with snprintf(buf, 6, "%.2f", pct).
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "pct_table.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Problems found
+static int failures = 0;
+
+/**
+ * @brief Signed percentage of a raw stick value, as the state used to compute.
+ * 
+ * @param val The raw value.
+ * @return The percentage, with 128 as 0%.
+*/
+static float sign_pct(uint8_t val) {
+    return (float) ((int) val - 128) / 128.0 * 100.0;
+}
+
+/**
+ * @brief Unsigned percentage of a raw trigger value, as the state used to
+ *        compute.
+ * 
+ * @param val The raw value.
+ * @return The percentage, with 0 as 0%.
+*/
+static float unsign_pct(uint8_t val) {
+    return (float) val / 255.0 * 100.0;
+}
+
+/**
+ * @brief Check one table entry against the float formatting.
+ * 
+ * @param table The name of the table.
+ * @param val The index of the entry.
+ * @param entry The entry.
+ * @param pct The percentage it should hold.
+*/
+static void check_entry(const char* table, int val, const PctStr_t* entry,
+                        float pct) {
+    char want[PCT_STR_MAX_LEN + 1];
+    snprintf(want, sizeof(want), "%.2f", pct);
+    size_t len = strlen(want);
+    if (entry->len != len || memcmp(entry->str, want, len) != 0) {
+        fprintf(stderr, "%s[%d] is \"%.*s\", want \"%s\"\n", table, val,
+                (int) entry->len, entry->str, want);
+        failures++;
+    }
+}
+
+int main(void) {
+    for (int val = 0; val < 256; val++) {
+        check_entry("sign_pct_str", val, &sign_pct_str[val], sign_pct(val));
+        check_entry("neg_sign_pct_str", val, &neg_sign_pct_str[val],
+                    -sign_pct(val));
+        check_entry("unsign_pct_str", val, &unsign_pct_str[val],
+                    unsign_pct(val));
+    }
+    printf("%s: 3 tables of 256 entries\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+/**
+ * @file    trace_capture.c
+ * @brief   Turn the firmware's traced notifications into a trace file.
+ * 
+ * Reads the output stream of the firmware with tracing enabled (TRC;ALS or
+ * TRC;ONL, see uart_cmd.h), from a serial port, a saved capture or stdin, and
+ * writes every traced notification to a trace file (see trace_fmt.h). All
+ * other output in the stream is skipped.
+ * 
+ * Usage: trace_capture [-f asc|bin] [input] output.trc
+ *   -f  The output format of the stream, default asc.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "stadia_decoder.h"
+#include "trace_fmt.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @brief The trace file being written and the number of records in it.
+*/
+typedef struct Capture {
+    FILE *out;
+    unsigned long records;
+    bool failed;
+} Capture_t;
+
+/**
+ * @brief Append a record to the trace file.
+ * 
+ * @param cap The capture.
+ * @param rec The record.
+*/
+static void write_rec(Capture_t* cap, const TraceRec_t* rec) {
+    uint8_t buf[TRACE_REC_LEN];
+    trace_put_rec(rec, buf);
+    if (fwrite(buf, 1, sizeof(buf), cap->out) != sizeof(buf)) {
+        cap->failed = true;
+    }
+    cap->records++;
+}
+
+/**
+ * @brief Decoder callback keeping the trace frames.
+ * 
+ * @param frame The decoded frame.
+ * @param ctx The Capture_t.
+*/
+static void on_frame(const StadiaFrame_t* frame, void* ctx) {
+    if (frame->type == BIN_FRAME_TRACE) {
+        write_rec(ctx, &frame->trace);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    bool binary = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:")) != -1) {
+        if (opt == 'f' && strcmp(optarg, "asc") == 0) {
+            binary = false;
+        } else if (opt == 'f' && strcmp(optarg, "bin") == 0) {
+            binary = true;
+        } else {
+            optind = argc;
+            break;
+        }
+    }
+    int args = argc - optind;
+    if (args < 1 || args > 2) {
+        fprintf(stderr, "usage: %s [-f asc|bin] [input] output.trc\n",
+                argv[0]);
+        return 1;
+    }
+    FILE *in = stdin;
+    if (args == 2 && (in = fopen(argv[optind], "rb")) == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+    Capture_t cap = {0};
+    const char *out_path = argv[argc - 1];
+    if ((cap.out = fopen(out_path, "wb")) == NULL) {
+        perror(out_path);
+        return 1;
+    }
+    uint8_t header[TRACE_HEADER_LEN];
+    fwrite(header, 1, trace_put_header(header), cap.out);
+
+    if (binary) {
+        static StadiaDecoder_t dec;
+        stadia_decoder_init(&dec);
+        uint8_t buf[4096];
+        size_t got;
+        while ((got = fread(buf, 1, sizeof(buf), in)) > 0) {
+            stadia_decoder_feed(&dec, buf, got, on_frame, &cap);
+        }
+    } else {
+        char line[256];
+        TraceRec_t rec;
+        while (fgets(line, sizeof(line), in) != NULL) {
+            if (trace_rec_of_str(line, &rec)) {
+                write_rec(&cap, &rec);
+            }
+        }
+    }
+
+    if (fclose(cap.out) != 0 || cap.failed) {
+        fprintf(stderr, "could not write %s\n", out_path);
+        return 1;
+    }
+    fprintf(stderr, "%lu records\n", cap.records);
+    return 0;
+}
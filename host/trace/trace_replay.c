@@ -0,0 +1,249 @@
+/**
+ * @file    trace_replay.c
+ * @brief   Replay a trace file through the publish pipeline.
+ * 
+ * The trace (see trace_fmt.h) is mapped into memory and every notification is
+ * passed through the firmware's own code: load_stadia_rep, ingest_stadia_rep,
+ * a batch dequeue and update_controller_batch, with publish_held_controls run
+ * whenever a rate limited control falls due. The pipeline clock follows the
+ * recorded arrival times, so deadzones, rate limits and timestamps behave as
+ * they did in the recorded session, and two builds given the same trace can be
+ * compared byte for byte. The snapshot and keyframe timers are not replayed.
+ * 
+ * Usage: trace_replay [-p] [-f asc|bin] [-c] [-u] [-o file] trace.trc
+ *   -p  Replay at the recorded pace instead of as fast as possible.
+ *   -f  Output format, default asc.
+ *   -c  Enable conflation in the report queue.
+ *   -u  Unfiltered: zero the deadzone and change threshold of every control,
+ *       so every change of a raw value is published as before they existed.
+ *   -o  Write the output bytes to a file.
+ * 
+ * Besides the replay rate, the lines of ASCII output (or frames of binary
+ * output) are printed with their rate over the recorded time, the load the
+ * session put on the UART, so runs with and without -u show what the
+ * deadzones and thresholds save.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "rep_queue.h"
+#include "con_state.h"
+#include "trace_fmt.h"
+#include "globalconst.h"
+#include "host_shim.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Reports dequeued at once, as in main.c
+#define REPLAY_BATCH_LEN 16
+
+// The global report queue, defined by main.c in the firmware
+RepQueue_t *repQueue;
+
+// Time of the pipeline clock, the recorded arrival times extended to 64 bits
+static int64_t replayNow = 0;
+
+/**
+ * @brief The clock of the pipeline, following the trace.
+ * 
+ * @return The time in microseconds.
+*/
+static int64_t replay_clock(void) {
+    return replayNow;
+}
+
+/**
+ * @brief Read the monotonic clock.
+ * 
+ * @return The time in microseconds.
+*/
+static int64_t wall_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Move every pending report through the controller state.
+ * 
+ * @param state The controller state.
+*/
+static void drain(ConState_t* state) {
+    StadiaRep_t batch[REPLAY_BATCH_LEN];
+    size_t count;
+    while ((count = dequeue_stadia_rep_batch(repQueue, batch,
+                                             REPLAY_BATCH_LEN)) > 0) {
+        update_controller_batch(state, batch, count);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    bool paced = false;
+    bool conflate = false;
+    bool unfiltered = false;
+    const char *out_path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "pf:cuo:")) != -1) {
+        switch (opt) {
+            case 'p':
+                paced = true;
+                break;
+            case 'f':
+                if (strcmp(optarg, "asc") == 0) {
+                    output_format = OUTPUT_ASCII;
+                } else if (strcmp(optarg, "bin") == 0) {
+                    output_format = OUTPUT_BINARY;
+                } else {
+                    fprintf(stderr, "unknown format %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'c':
+                conflate = true;
+                break;
+            case 'u':
+                unfiltered = true;
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+    if (argc - optind != 1) {
+        fprintf(stderr, "usage: %s [-p] [-f asc|bin] [-c] [-u] [-o file] "
+                "trace.trc\n", argv[0]);
+        return 1;
+    }
+
+    // Map the whole trace, records are read straight from the mapping
+    const char *path = argv[optind];
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        return 1;
+    }
+    size_t size = st.st_size;
+    const uint8_t *trace = size ? mmap(NULL, size, PROT_READ, MAP_PRIVATE,
+                                       fd, 0) : NULL;
+    if (size > 0 && trace == MAP_FAILED) {
+        perror(path);
+        return 1;
+    }
+    if (!trace_check_header(trace, size)) {
+        fprintf(stderr, "%s is not a version %d trace\n", path,
+                TRACE_VERSION);
+        return 1;
+    }
+    size_t records = (size - TRACE_HEADER_LEN) / TRACE_REC_LEN;
+#ifdef MADV_SEQUENTIAL
+    madvise((void *) trace, size, MADV_SEQUENTIAL);
+#endif
+
+    if (unfiltered) {
+        memset(control_deadzone, 0, sizeof(control_deadzone));
+        memset(control_min_delta, 0, sizeof(control_min_delta));
+    }
+    set_rep_clock(replay_clock);
+    repQueue = create_stadia_rep_queue(xTaskGetCurrentTaskHandle(),
+                                       REP_QUEUE_LEN, REP_QUEUE_DROP_NEWEST, 0);
+    if (repQueue == NULL) {
+        fprintf(stderr, "invalid report queue configuration\n");
+        return 1;
+    }
+    set_rep_queue_conflation(repQueue, conflate);
+    static ConState_t state;
+    init_controller(&state);
+    host_uart_capture(out_path != NULL);
+    host_uart_reset();
+
+    unsigned long rejected = 0;
+    uint32_t last_stamp = 0;
+    int64_t first = 0;
+    int64_t held_due = -1;
+    int64_t start = wall_us();
+    for (size_t i = 0; i < records; i++) {
+        TraceRec_t rec;
+        trace_get_rec(trace + TRACE_HEADER_LEN + i * TRACE_REC_LEN, &rec);
+        int64_t now = i == 0 ? rec.stamp_us
+                             : replayNow + (uint32_t) (rec.stamp_us -
+                                                       last_stamp);
+        last_stamp = rec.stamp_us;
+        if (i == 0) {
+            first = now;
+        }
+        // Held controls fall due before this notification arrives
+        while (held_due >= 0 && held_due <= now) {
+            replayNow = held_due;
+            int64_t wait = publish_held_controls(&state);
+            held_due = wait < 0 ? -1 : replayNow + wait;
+        }
+        replayNow = now;
+        if (paced) {
+            int64_t ahead = (now - first) - (wall_us() - start);
+            if (ahead > 0) {
+                usleep(ahead);
+            }
+        }
+        // load_stadia_rep rejects any length but a full report before
+        // reading the payload, so malformed notifications replay safely
+        StadiaRep_t rep;
+        rep.stamp_us = rec.stamp_us;
+        if (load_stadia_rep(&rep, rec.payload, rec.len)) {
+            ingest_stadia_rep(repQueue, &rep);
+        } else {
+            rejected++;
+        }
+        drain(&state);
+        int64_t wait = publish_held_controls(&state);
+        held_due = wait < 0 ? -1 : replayNow + wait;
+    }
+    // Let the last held controls fall due
+    while (held_due >= 0) {
+        replayNow = held_due;
+        int64_t wait = publish_held_controls(&state);
+        held_due = wait < 0 ? -1 : replayNow + wait;
+    }
+    double elapsed = (wall_us() - start) / 1e6;
+
+    uint64_t bytes = host_uart_bytes();
+    uint64_t writes = host_uart_writes();
+    bool binary = output_format == OUTPUT_BINARY;
+    uint64_t lines = binary ? host_uart_frames() : host_uart_lines();
+    double recorded = (replayNow - first) / 1e6;
+    fprintf(stderr, "records      %zu\n", records);
+    fprintf(stderr, "rejected     %lu\n", rejected);
+    fprintf(stderr, "recorded s   %.3f\n", recorded);
+    fprintf(stderr, "seconds      %.3f\n", elapsed);
+    fprintf(stderr, "records/s    %.0f\n", records / elapsed);
+    fprintf(stderr, "bytes        %llu\n", (unsigned long long) bytes);
+    fprintf(stderr, "uart writes  %llu\n", (unsigned long long) writes);
+    fprintf(stderr, "%s       %llu\n", binary ? "frames" : "lines ",
+            (unsigned long long) lines);
+    fprintf(stderr, "%s     %.1f\n", binary ? "frames/s" : "lines/s ",
+            recorded > 0 ? lines / recorded : 0.0);
+
+    if (out_path != NULL) {
+        size_t len;
+        const uint8_t *out = host_uart_output(&len);
+        FILE *file = fopen(out_path, "wb");
+        if (file == NULL || fwrite(out, 1, len, file) != len) {
+            fprintf(stderr, "could not write %s\n", out_path);
+            return 1;
+        }
+        fclose(file);
+    }
+    return 0;
+}
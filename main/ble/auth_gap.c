@@ -11,24 +11,16 @@
 #include "auth_gap.h"
 #include "globalconst.h"
 #include "gattc.h"
+#include "rate_mon.h"
+#include "reconnect.h"
+#include "discover.h"
+#include "conn_setup.h"
+#include "conn_params.h"
 
 // Variable shared between the GAP profile and GATTC profile indicating 
 // whether GAP has successfully found the device to connect to
 bool connect = false;
 
-/**
- * @brief The scanning parameters for the ESP32C6 to discover generic HID
- *        devices and initiate authentication.
-*/
-esp_ble_scan_params_t ble_scan_params = {
-    .scan_type              = BLE_SCAN_TYPE_ACTIVE,
-    .own_addr_type          = BLE_ADDR_TYPE_RPA_PUBLIC,
-    .scan_filter_policy     = BLE_SCAN_FILTER_ALLOW_ALL,
-    .scan_interval          = 0x50,
-    .scan_window            = 0x30,
-    .scan_duplicate         = BLE_SCAN_DUPLICATE_DISABLE
-};
-
 void esp_auth_init(void) {
     // set the security iocap & auth_req & key size & init key response key
     // parameters to the stack
@@ -121,10 +113,6 @@ char *esp_auth_req_to_str(esp_ble_auth_req_t auth_req) {
 }
 
 void esp_gap_cb(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
-    
-    // Discovered device name string and size
-    uint8_t *adv_name = NULL;
-    uint8_t adv_name_len = 0;
 
     // Dispatch based on event type
     switch (event) {
@@ -139,18 +127,30 @@ void esp_gap_cb(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
                 break;
             }
             // Privacy mode set successfully, prepare for scanning by setting 
-            // scan parameters
-            esp_err_t scan_ret = esp_ble_gap_set_scan_params(&ble_scan_params);
-            if (scan_ret){
-                ESP_LOGE(GATTC_TAG, "set scan params error, error code = %x",
-                         scan_ret);
+            // the whitelist and scan parameters
+            discover_configure();
+            break;
+
+        // Report a failure to change the whitelist
+        case ESP_GAP_BLE_UPDATE_WHITELIST_COMPLETE_EVT:
+            if (param->update_whitelist_cmpl.status != ESP_BT_STATUS_SUCCESS) {
+                ESP_LOGE(GATTC_TAG, "update whitelist failed, error status = %x",
+                         param->update_whitelist_cmpl.status);
             }
             break;
 
-        // Verify that the scan parameters were set successfully
+        // Verify that the scan parameters were set successfully, and scan
+        // unless they were changed while connected
         case ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT: {
+            if (param->scan_param_cmpl.status != ESP_BT_STATUS_SUCCESS) {
+                ESP_LOGE(GATTC_TAG, "set scan params failed, error status = %x",
+                         param->scan_param_cmpl.status);
+                break;
+            }
             uint32_t duration = 30; // Seconds
-            esp_ble_gap_start_scanning(duration);
+            if (!connect) {
+                esp_ble_gap_start_scanning(duration);
+            }
             break;
         }
 
@@ -165,6 +165,7 @@ void esp_gap_cb(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
             if (GATTC_DEBUG) {
                 ESP_LOGI(GATTC_TAG, "Scan start success");
             }
+            discover_on_scan_start();
             break;
 
         // Response to a request for a passkey to pair with a device. Stadia
@@ -274,6 +275,15 @@ void esp_gap_cb(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
                                                 auth_cmpl.auth_mode));
                 }
             }
+            // Once bonded, the controller is reconnected to by its address
+            // and later scans only look for bonded devices
+            if (param->ble_security.auth_cmpl.success) {
+                conn_setup_on_encrypted();
+                reconnect_set_peer(bd_addr,
+                                   param->ble_security.auth_cmpl.addr_type);
+                discover_add_bonded(bd_addr,
+                                    param->ble_security.auth_cmpl.addr_type);
+            }
             break;
         }
 
@@ -290,42 +300,32 @@ void esp_gap_cb(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
                             scan_result->scan_rst.adv_data_len,
                             scan_result->scan_rst.scan_rsp_len);
                     }
-                    adv_name = esp_ble_resolve_adv_data(scan_result->
-                                                        scan_rst.ble_adv,
-                                                        ESP_BLE_AD_TYPE_NAME_CMPL,
-                                                        &adv_name_len);
-                    if (GATTC_DEBUG) {
-                        ESP_LOGI(GATTC_TAG, "Searched Device Name Len %d",
-                                adv_name_len);
-                        esp_log_buffer_char(GATTC_TAG, adv_name, adv_name_len);
-                        ESP_LOGI(GATTC_TAG, "\n");
-                    }
-                    if (adv_name != NULL) {
-                        if (strlen(remote_device_name) == adv_name_len &&
-                            strncmp((char *)adv_name, remote_device_name, 
-                            adv_name_len) == 0) {
+                    if (discover_match(&scan_result->scan_rst)) {
+                        if (GATTC_DEBUG) {
+                            ESP_LOGI(GATTC_TAG, "searched device found\n");
+                        }
+                        if (connect == false) {
+                            connect = true;
                             if (GATTC_DEBUG) {
-                                ESP_LOGI(GATTC_TAG, "searched device %s\n",
-                                    remote_device_name);
-                            }
-                            if (connect == false) {
-                                connect = true;
-                                if (GATTC_DEBUG) {
-                                    ESP_LOGI(GATTC_TAG,
-                                        "connect to the remote device.");
-                                }
-                                esp_ble_gap_stop_scanning();
-                                esp_ble_gattc_open(gl_profile_tab[PROFILE_A_APP_ID].
-                                                gattc_if,
-                                                scan_result->scan_rst.bda,
-                                                scan_result->
-                                                scan_rst.ble_addr_type,
-                                                true);
+                                ESP_LOGI(GATTC_TAG,
+                                    "connect to the remote device.");
                             }
+                            esp_ble_gap_stop_scanning();
+                            esp_ble_gattc_open(gl_profile_tab[PROFILE_A_APP_ID].
+                                            gattc_if,
+                                            scan_result->scan_rst.bda,
+                                            scan_result->
+                                            scan_rst.ble_addr_type,
+                                            true);
                         }
                     }
                     break;
+                // The scan ran out, scan again until connected. A whitelisted
+                // scan is opened to every device first.
                 case ESP_GAP_SEARCH_INQ_CMPL_EVT:
+                    if (!discover_on_scan_done()) {
+                        reconnect_on_scan_done();
+                    }
                     break;
                 default:
                     break;
@@ -345,6 +345,27 @@ void esp_gap_cb(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
             }
             break;
 
+        // The connection parameters changed, or an update asked for was
+        // refused. Gaps between reports are measured in connection intervals,
+        // which are in units of 1.25 ms, and the controller may skip as many
+        // of them as the slave latency allows.
+        case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
+            conn_params_on_update(param->update_conn_params.status,
+                                  param->update_conn_params.conn_int,
+                                  param->update_conn_params.latency,
+                                  param->update_conn_params.timeout);
+            if (param->update_conn_params.status != ESP_BT_STATUS_SUCCESS) {
+                break;
+            }
+            if (GATTC_DEBUG) {
+                ESP_LOGI(GATTC_TAG, "Connection interval %d, latency %d",
+                         param->update_conn_params.conn_int,
+                         param->update_conn_params.latency);
+            }
+            rate_mon_set_interval(param->update_conn_params.conn_int * 1250 *
+                                  (param->update_conn_params.latency + 1));
+            break;
+
         default:
             break;
     }
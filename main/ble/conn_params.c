@@ -0,0 +1,334 @@
+/**
+ * @file    conn_params.c
+ * @brief   Implementation of the connection parameter manager
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "ble/conn_params.h"
+#include "globalconst.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <string.h>
+
+// Names of the kinds of parameters, indexed by ConnParamsMode_t
+static const char *const mode_names[CONN_PARAMS_NUM_MODES] = {
+    "controller's", "fast", "idle",
+};
+
+/**
+ * @brief The state of the connection parameter manager.
+*/
+static struct {
+    bool connected;             // A link is up.
+    esp_bd_addr_t bda;          // Address of the controller.
+    ConnParamsMode_t want;      // Parameters wanted for the input seen.
+    bool pending;               // An update asked for is in flight.
+    ConnParamsMode_t asked;     // Parameters of the update in flight.
+    uint16_t fast_interval;     // Next fast interval to ask for.
+    bool fast_refused;          // No fast interval was accepted.
+    bool idle_refused;          // The idle parameters were refused.
+    bool has_ref;               // Whether ref is set.
+    StadiaRep_t ref;            // Report input is measured against.
+    uint32_t input_us;          // Arrival time of the last input.
+    bool has_last;              // Whether last_us is set.
+    uint32_t last_us;           // Arrival time of the last report.
+    uint64_t total_us[CONN_PARAMS_NUM_MODES];   // Time between reports under
+                                                // each kind of parameters.
+    bool timer_armed;           // The idle timer is running.
+    esp_timer_handle_t timer;   // The idle timer.
+    ConnParamsStats_t stats;    // The statistics.
+} params;
+
+// Guards params against the idle timer, which runs in the esp_timer task
+// while the callbacks run in the Bluetooth task. Updates are asked for once
+// it is released, as that calls into the stack.
+static portMUX_TYPE params_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Check whether a stick or trigger moved.
+ * 
+ * @param ref The position input is measured against.
+ * @param val The position in the report.
+ * @return true if it moved by more than CONN_PARAMS_AXIS_DELTA.
+*/
+static bool axis_moved(uint8_t ref, uint8_t val) {
+    return (ref > val ? ref - val : val - ref) > CONN_PARAMS_AXIS_DELTA;
+}
+
+/**
+ * @brief Check whether a report holds input.
+ * 
+ * @param ref The report input is measured against.
+ * @param rep The report.
+ * @return true if any button changed or any stick or trigger moved.
+*/
+static bool is_input(const StadiaRep_t* ref, const StadiaRep_t* rep) {
+    return rep->dpad != ref->dpad || rep->buttons1 != ref->buttons1 ||
+           rep->buttons2 != ref->buttons2 || rep->volume != ref->volume ||
+           axis_moved(ref->stickX, rep->stickX) ||
+           axis_moved(ref->stickY, rep->stickY) ||
+           axis_moved(ref->stickZ, rep->stickZ) ||
+           axis_moved(ref->stickRz, rep->stickRz) ||
+           axis_moved(ref->brake, rep->brake) ||
+           axis_moved(ref->throttle, rep->throttle);
+}
+
+/**
+ * @brief Prepare to ask for the parameters wanted, unless they are in effect,
+ *        an update is already in flight or the controller refused them.
+ *        Called with params_lock held; the update is marked in flight until
+ *        request says otherwise.
+ * 
+ * @param update Filled in with the update to ask for.
+ * @return true if the update should be asked for with request.
+*/
+static bool prepare(esp_ble_conn_update_params_t* update) {
+    ConnParamsMode_t want = params.want;
+    if (!CONN_PARAMS_ENABLED || !params.connected || params.pending ||
+        want == params.stats.mode || want == CONN_PARAMS_PEER ||
+        (want == CONN_PARAMS_FAST && params.fast_refused) ||
+        (want == CONN_PARAMS_IDLE && params.idle_refused)) {
+        return false;
+    }
+    // The controller may already be using them
+    ConnParamsStats_t *stats = &params.stats;
+    if (want == CONN_PARAMS_FAST && stats->latency == 0 &&
+        stats->interval <= params.fast_interval) {
+        stats->mode = CONN_PARAMS_FAST;
+        stats->fast_interval = stats->interval;
+        return false;
+    }
+    if (want == CONN_PARAMS_IDLE &&
+        stats->interval == CONN_PARAMS_IDLE_INTERVAL &&
+        stats->latency == CONN_PARAMS_IDLE_LATENCY) {
+        stats->mode = CONN_PARAMS_IDLE;
+        return false;
+    }
+    memset(update, 0, sizeof(*update));
+    memcpy(update->bda, params.bda, sizeof(esp_bd_addr_t));
+    if (want == CONN_PARAMS_FAST) {
+        update->min_int = params.fast_interval;
+        update->latency = 0;
+    } else {
+        update->min_int = CONN_PARAMS_IDLE_INTERVAL;
+        update->latency = CONN_PARAMS_IDLE_LATENCY;
+    }
+    update->max_int = update->min_int;
+    update->timeout = CONN_PARAMS_TIMEOUT;
+    params.pending = true;
+    params.asked = want;
+    return true;
+}
+
+/**
+ * @brief Ask for an update prepared with prepare.
+ * 
+ * @param ask The result of prepare, nothing is asked for if false.
+ * @param update The update.
+*/
+static void request(bool ask, esp_ble_conn_update_params_t* update) {
+    if (!ask) {
+        return;
+    }
+    esp_err_t ret = esp_ble_gap_update_conn_params(update);
+    taskENTER_CRITICAL(&params_lock);
+    if (ret) {
+        params.pending = false;
+    } else {
+        params.stats.requests++;
+    }
+    taskEXIT_CRITICAL(&params_lock);
+    if (ret) {
+        ESP_LOGE(GATTC_TAG, "update conn params error, error code = %x", ret);
+    }
+}
+
+/**
+ * @brief Start the idle timer if it is not running.
+ * 
+ * @param timeout_us Time until it fires.
+*/
+static void arm_idle(uint32_t timeout_us) {
+    taskENTER_CRITICAL(&params_lock);
+    bool start = params.timer != NULL && !params.timer_armed;
+    if (start) {
+        params.timer_armed = true;
+    }
+    taskEXIT_CRITICAL(&params_lock);
+    if (start && esp_timer_start_once(params.timer, timeout_us) != ESP_OK) {
+        taskENTER_CRITICAL(&params_lock);
+        params.timer_armed = false;
+        taskEXIT_CRITICAL(&params_lock);
+    }
+}
+
+/**
+ * @brief Idle timer callback, relaxing the parameters once there was no input
+ *        for CONN_PARAMS_IDLE_MS.
+ * 
+ * @param arg Unused.
+*/
+static void idle_timer_cb(void* arg) {
+    esp_ble_conn_update_params_t update;
+    bool ask = false;
+    uint32_t rearm_us = 0;
+    taskENTER_CRITICAL(&params_lock);
+    params.timer_armed = false;
+    if (params.connected && params.want != CONN_PARAMS_IDLE) {
+        // The timer is not restarted on every input, only checked when it
+        // fires
+        uint32_t idle_us = (uint32_t) rep_clock_us() - params.input_us;
+        if (idle_us < CONN_PARAMS_IDLE_MS * 1000) {
+            rearm_us = CONN_PARAMS_IDLE_MS * 1000 - idle_us;
+        } else {
+            params.want = CONN_PARAMS_IDLE;
+            params.stats.relaxed++;
+            ask = prepare(&update);
+        }
+    }
+    taskEXIT_CRITICAL(&params_lock);
+    if (rearm_us != 0) {
+        arm_idle(rearm_us);
+    }
+    request(ask, &update);
+}
+
+void conn_params_init(void) {
+    const esp_timer_create_args_t timer_args = {
+        .callback = idle_timer_cb,
+        .name = "conn_params",
+    };
+    if (esp_timer_create(&timer_args, &params.timer)) {
+        // Without the timer, the link is never relaxed when idle
+        ESP_LOGE(GATTC_TAG, "conn params timer create failed");
+        params.timer = NULL;
+    }
+}
+
+void conn_params_on_connect(const esp_bd_addr_t bda,
+                            const esp_gatt_conn_params_t* conn) {
+    taskENTER_CRITICAL(&params_lock);
+    params.connected = true;
+    memcpy(params.bda, bda, sizeof(esp_bd_addr_t));
+    params.want = CONN_PARAMS_PEER;
+    params.pending = false;
+    params.fast_interval = CONN_PARAMS_FAST_INTERVAL;
+    params.fast_refused = false;
+    params.idle_refused = false;
+    params.has_ref = false;
+    params.has_last = false;
+    params.stats.mode = CONN_PARAMS_PEER;
+    params.stats.interval = conn->interval;
+    params.stats.latency = conn->latency;
+    params.stats.timeout = conn->timeout;
+    taskEXIT_CRITICAL(&params_lock);
+}
+
+void conn_params_on_report(const StadiaRep_t* rep) {
+    esp_ble_conn_update_params_t update;
+    bool ask = false;
+    taskENTER_CRITICAL(&params_lock);
+    if (!params.connected) {
+        taskEXIT_CRITICAL(&params_lock);
+        return;
+    }
+    // Cadence of the reports under the parameters in effect
+    ConnParamsStats_t *stats = &params.stats;
+    if (params.has_last) {
+        params.total_us[stats->mode] += rep->stamp_us - params.last_us;
+        stats->reports[stats->mode]++;
+        stats->period_us[stats->mode] = params.total_us[stats->mode] /
+                                        stats->reports[stats->mode];
+    }
+    params.last_us = rep->stamp_us;
+    params.has_last = true;
+
+    bool input = !params.has_ref || is_input(&params.ref, rep);
+    if (input) {
+        params.ref = *rep;
+        params.has_ref = true;
+        params.input_us = rep->stamp_us;
+        if (params.want != CONN_PARAMS_FAST) {
+            if (params.want == CONN_PARAMS_IDLE) {
+                stats->tightened++;
+            }
+            params.want = CONN_PARAMS_FAST;
+            ask = prepare(&update);
+        }
+    }
+    taskEXIT_CRITICAL(&params_lock);
+    request(ask, &update);
+    if (input) {
+        arm_idle(CONN_PARAMS_IDLE_MS * 1000);
+    }
+}
+
+void conn_params_on_update(esp_bt_status_t status, uint16_t interval,
+                           uint16_t latency, uint16_t timeout) {
+    esp_ble_conn_update_params_t update;
+    bool ask = false;
+    taskENTER_CRITICAL(&params_lock);
+    bool asked = params.pending;
+    params.pending = false;
+    ConnParamsMode_t mode = params.asked;
+    if (status != ESP_BT_STATUS_SUCCESS) {
+        if (!asked) {
+            taskEXIT_CRITICAL(&params_lock);
+            return;
+        }
+        params.stats.refused++;
+        if (params.asked == CONN_PARAMS_FAST) {
+            // Try an interval half as long again
+            params.fast_interval += params.fast_interval / 2;
+            params.fast_refused =
+                params.fast_interval >= CONN_PARAMS_IDLE_INTERVAL;
+        } else {
+            params.idle_refused = true;
+        }
+        ask = prepare(&update);
+        taskEXIT_CRITICAL(&params_lock);
+        ESP_LOGI(GATTC_TAG, "%s connection parameters refused, status %d",
+                 mode_names[mode], status);
+        request(ask, &update);
+        return;
+    }
+
+    // Updates the controller makes on its own are kept until the input
+    // changes, rather than asked to be undone
+    ConnParamsStats_t *stats = &params.stats;
+    stats->mode = asked ? params.asked : CONN_PARAMS_PEER;
+    stats->interval = interval;
+    stats->latency = latency;
+    stats->timeout = timeout;
+    if (stats->mode == CONN_PARAMS_FAST) {
+        stats->fast_interval = interval;
+    }
+    mode = stats->mode;
+    if (asked) {
+        // The input may have changed while the update was in flight
+        ask = prepare(&update);
+    }
+    taskEXIT_CRITICAL(&params_lock);
+    ESP_LOGI(GATTC_TAG, "%s connection parameters, interval %u, latency %u",
+             mode_names[mode], interval, latency);
+    request(ask, &update);
+}
+
+void conn_params_on_disconnect(void) {
+    taskENTER_CRITICAL(&params_lock);
+    params.connected = false;
+    params.pending = false;
+    params.timer_armed = false;
+    taskEXIT_CRITICAL(&params_lock);
+    if (params.timer != NULL) {
+        esp_timer_stop(params.timer);
+    }
+}
+
+const ConnParamsStats_t *conn_params_get(void) {
+    return &params.stats;
+}
@@ -0,0 +1,119 @@
+/**
+ * @file    conn_params.h
+ * @brief   Manages the connection parameters of the link to the controller,
+ *          trading input latency against radio use.
+ * 
+ * Left alone, the controller keeps whatever connection interval it picked.
+ * Once reports flow and the pad is in use, the manager asks for the shortest
+ * interval the controller accepts, with no slave latency: it starts from
+ * CONN_PARAMS_FAST_INTERVAL and, each time the controller refuses, asks again
+ * for an interval half as long again, until one is accepted or the idle
+ * interval is reached.
+ * 
+ * Input is any change of the buttons, the D-pad or the volume, or a stick or
+ * trigger moving by more than CONN_PARAMS_AXIS_DELTA counts, so the flicker
+ * of a resting pad is not input. After CONN_PARAMS_IDLE_MS without input the
+ * link relaxes to CONN_PARAMS_IDLE_INTERVAL with a slave latency of
+ * CONN_PARAMS_IDLE_LATENCY events, and the first input afterwards tightens it
+ * again. An update the controller makes on its own is recorded and kept until
+ * the pad next goes idle or becomes active.
+ * 
+ * The parameters in effect, the shortest interval accepted, and the number of
+ * reports and mean time between them under each kind of parameters are kept
+ * in the statistics.
+ * 
+ * The manager is driven from the GAP and GATT client callbacks, which run in
+ * the Bluetooth task, and from its idle timer, which runs in the esp_timer
+ * task. Its state is only changed under a lock, and updates are asked for
+ * once the lock is released.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef CONN_PARAMS_H
+#define CONN_PARAMS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_gap_ble_api.h"
+#include "esp_gatt_defs.h"
+#include "publish/rep_queue.h"
+
+/**
+ * @brief The kinds of connection parameters.
+*/
+typedef enum ConnParamsMode {
+    CONN_PARAMS_PEER,   // Picked by the controller
+    CONN_PARAMS_FAST,   // The shortest interval accepted, while in use
+    CONN_PARAMS_IDLE,   // The idle interval and slave latency
+    CONN_PARAMS_NUM_MODES
+} ConnParamsMode_t;
+
+/**
+ * @brief The connection parameter statistics.
+*/
+typedef struct ConnParamsStats {
+    ConnParamsMode_t mode;  // Kind of parameters in effect.
+    uint16_t interval;      // Interval in effect, in units of 1.25 ms.
+    uint16_t latency;       // Slave latency in effect, in connection events.
+    uint16_t timeout;       // Supervision timeout in effect, in units of
+                            // 10 ms.
+    uint16_t fast_interval; // Shortest interval accepted, 0 until one is.
+    uint32_t requests;      // Updates asked for.
+    uint32_t refused;       // Updates the controller refused.
+    uint32_t relaxed;       // Switches to the idle parameters.
+    uint32_t tightened;     // Switches back on input.
+    uint32_t reports[CONN_PARAMS_NUM_MODES];    // Reports received under
+                                                // each kind of parameters.
+    uint32_t period_us[CONN_PARAMS_NUM_MODES];  // Mean time between them.
+} ConnParamsStats_t;
+
+/**
+ * @brief Create the idle timer. Must be called before the first connection.
+*/
+void conn_params_init(void);
+
+/**
+ * @brief Start managing the parameters of a new link.
+ * 
+ * @param bda The controller's address.
+ * @param conn The parameters the link came up with.
+*/
+void conn_params_on_connect(const esp_bd_addr_t bda,
+                            const esp_gatt_conn_params_t* conn);
+
+/**
+ * @brief Note a report received, tightening the parameters on input and
+ *        counting it towards the cadence of the parameters in effect.
+ * 
+ * @param rep The report, with stamp_us set to its arrival time.
+*/
+void conn_params_on_report(const StadiaRep_t* rep);
+
+/**
+ * @brief Handle a parameter update, asked for or made by the controller.
+ * 
+ * @param status The status of the update.
+ * @param interval The interval in effect, in units of 1.25 ms.
+ * @param latency The slave latency in effect.
+ * @param timeout The supervision timeout in effect, in units of 10 ms.
+*/
+void conn_params_on_update(esp_bt_status_t status, uint16_t interval,
+                           uint16_t latency, uint16_t timeout);
+
+/**
+ * @brief Stop managing the link that dropped.
+*/
+void conn_params_on_disconnect(void);
+
+/**
+ * @brief Get the connection parameter statistics.
+ * 
+ * @return The statistics, updated live.
+*/
+const ConnParamsStats_t *conn_params_get(void);
+
+#endif /* #ifndef CONN_PARAMS_H */
@@ -0,0 +1,572 @@
+/**
+ * @file    conn_setup.c
+ * @brief   Implementation of the connection setup state machine
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "ble/conn_setup.h"
+#include "ble/gattc.h"
+#include "ble/handle_cache.h"
+#include "publish/rep_queue.h"
+#include "globalconst.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Placeholder for an empty char handle when searching all chars in service
+#define INVALID_HANDLE 0
+
+// Filters discovered services by the HID service UUID
+static esp_bt_uuid_t remote_filter_service_uuid = {
+    .len = ESP_UUID_LEN_16,
+    .uuid = {.uuid16 = HID_SERVICE_UUID,},
+};
+
+/**
+ * @brief The state of the connection setup.
+*/
+static struct {
+    ConnSetupPhase_t phase;     // The current phase.
+    esp_gatt_if_t gattc_if;     // Interface of the connection.
+    bool get_service;           // The search found the HID service.
+    HandleCache_t handles;      // Handles of the report, from the cache or
+                                // found by the search.
+    bool from_cache;            // The handles in use were loaded from the
+                                // cache.
+    uint32_t tries;             // Retries of the current step.
+    bool reported;              // A report arrived on this connection.
+    bool encrypted;             // The link is encrypted.
+    bool await_encrypt;         // The client configuration is written again
+                                // once the link is encrypted.
+    uint32_t open_us;           // Time the connection opened.
+    uint32_t phase_us;          // Time the current phase was entered.
+    uint32_t phase_ms[SETUP_NUM_PHASES];    // Time spent in each phase on
+                                            // this connection.
+    bool timing;                // A step is waiting for its answer.
+    uint32_t deadline_us;       // When that step times out.
+    esp_timer_handle_t timer;   // The step timeout timer.
+    ConnSetupStats_t stats;     // The statistics.
+} setup;
+
+// Guards setup against the timeout timer, which runs in the esp_timer task
+// while the callbacks run in the Bluetooth task. Steps are decided with it
+// held and run once it is released, as they call into the stack.
+static portMUX_TYPE setup_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief The steps that talk to the stack, run by run_step.
+*/
+typedef enum SetupStep {
+    STEP_NONE,          // Nothing to do
+    STEP_SEARCH,        // Search for the HID service
+    STEP_RESEARCH,      // Drop the stale cached handles, then search
+    STEP_SUBSCRIBE,     // Enable notifications on the report
+    STEP_WAIT,          // Time the wait for the first report
+    STEP_CLOSE          // Give up and close the connection
+} SetupStep_t;
+
+/**
+ * @brief Move to a phase, adding the time spent in the one left. Called with
+ *        setup_lock held.
+ * 
+ * @param phase The phase.
+ * @param now_us The time, from rep_clock_us.
+*/
+static void enter(ConnSetupPhase_t phase, uint32_t now_us) {
+    setup.phase_ms[setup.phase] += (now_us - setup.phase_us) / 1000;
+    if (phase != setup.phase) {
+        setup.tries = 0;
+    }
+    setup.phase = phase;
+    setup.phase_us = now_us;
+    setup.timing = false;
+}
+
+/**
+ * @brief Begin a step of the current phase, starting its timeout. Called
+ *        with setup_lock held.
+ * 
+ * @param step The step.
+ * @return The step, for run_step.
+*/
+static SetupStep_t begin(SetupStep_t step) {
+    if (step != STEP_SUBSCRIBE) {
+        setup.get_service = false;
+    }
+    setup.timing = true;
+    setup.deadline_us = (uint32_t) rep_clock_us() +
+                        CONN_SETUP_TIMEOUT_MS * 1000;
+    return step;
+}
+
+/**
+ * @brief Drop the handles of the connected controller. Called with
+ *        setup_lock held, the cache itself is cleared by STEP_RESEARCH.
+*/
+static void drop_handles(void) {
+    setup.from_cache = false;
+    memset(&setup.handles, 0, sizeof(setup.handles));
+}
+
+/**
+ * @brief Retry the step in progress after it failed or timed out, search
+ *        again if it used cached handles, or close the connection once the
+ *        retries run out. With cached handles, no first report in time is a
+ *        failure too. Called with setup_lock held.
+ * 
+ * @return The step to run.
+*/
+static SetupStep_t step_failed(void) {
+    uint32_t now_us = (uint32_t) rep_clock_us();
+    if ((setup.phase == SETUP_SUBSCRIBE ||
+         setup.phase == SETUP_WAIT_REPORT) && setup.from_cache) {
+        // The cached handles may be stale, find them again
+        drop_handles();
+        enter(SETUP_SEARCH, now_us);
+        return begin(STEP_RESEARCH);
+    }
+    if (setup.tries++ >= CONN_SETUP_RETRIES) {
+        setup.stats.failures++;
+        enter(SETUP_IDLE, now_us);
+        return STEP_CLOSE;
+    }
+    setup.stats.retries++;
+    return begin(setup.phase == SETUP_SEARCH ? STEP_SEARCH : STEP_SUBSCRIBE);
+}
+
+/**
+ * @brief Start the timeout of the step in progress.
+*/
+static void arm_timeout(void) {
+    if (setup.timer == NULL) {
+        return;
+    }
+    esp_timer_stop(setup.timer);
+    esp_timer_start_once(setup.timer, (uint64_t) CONN_SETUP_TIMEOUT_MS * 1000);
+}
+
+/**
+ * @brief Search for the HID service.
+ * 
+ * @return true if the search was started.
+*/
+static bool start_search(void) {
+    arm_timeout();
+    esp_err_t ret = esp_ble_gattc_search_service(setup.gattc_if,
+                                       gl_profile_tab[PROFILE_A_APP_ID].conn_id,
+                                       &remote_filter_service_uuid);
+    if (ret) {
+        ESP_LOGE(GATTC_TAG, "search service error, error code = %x", ret);
+    }
+    return ret == ESP_OK;
+}
+
+/**
+ * @brief Register for notifications of the report and write its client
+ *        configuration, without waiting for the registration, which does not
+ *        go over the air. The write asks for a response, so a stale handle
+ *        or a link not yet encrypted is answered with an error rather than
+ *        ignored by the controller.
+ * 
+ * @param handles The handles of the report.
+ * @return true if both were started.
+*/
+static bool subscribe(const HandleCache_t* handles) {
+    uint16_t notify_en = 0x1;
+    arm_timeout();
+    esp_err_t ret = esp_ble_gattc_register_for_notify(setup.gattc_if,
+                                    gl_profile_tab[PROFILE_A_APP_ID].remote_bda,
+                                    handles->notify_char_handle);
+    if (ret == ESP_OK) {
+        ret = esp_ble_gattc_write_char_descr(setup.gattc_if,
+                                       gl_profile_tab[PROFILE_A_APP_ID].conn_id,
+                                       handles->ccc_handle,
+                                       sizeof(notify_en),
+                                       (uint8_t *)&notify_en,
+                                       ESP_GATT_WRITE_TYPE_RSP,
+                                       ESP_GATT_AUTH_REQ_NONE);
+    }
+    if (ret) {
+        ESP_LOGE(GATTC_TAG, "subscribe error, error code = %x", ret);
+    }
+    return ret == ESP_OK;
+}
+
+/**
+ * @brief Run a step, and the retries of any step that fails to start.
+ * 
+ * @param step The step.
+*/
+static void run_step(SetupStep_t step) {
+    while (step != STEP_NONE) {
+        bool started = true;
+        HandleCache_t handles;
+        switch (step) {
+            case STEP_RESEARCH:
+                if (HANDLE_CACHE_ENABLED) {
+                    handle_cache_clear(
+                        gl_profile_tab[PROFILE_A_APP_ID].remote_bda);
+                }
+                // fall through
+            case STEP_SEARCH:
+                started = start_search();
+                break;
+            case STEP_SUBSCRIBE:
+                taskENTER_CRITICAL(&setup_lock);
+                handles = setup.handles;
+                taskEXIT_CRITICAL(&setup_lock);
+                started = subscribe(&handles);
+                break;
+            case STEP_WAIT:
+                arm_timeout();
+                break;
+            case STEP_CLOSE:
+                ESP_LOGE(GATTC_TAG, "connection setup failed, closing");
+                esp_ble_gattc_close(setup.gattc_if,
+                                    gl_profile_tab[PROFILE_A_APP_ID].conn_id);
+                break;
+            case STEP_NONE:
+            default:
+                break;
+        }
+        step = STEP_NONE;
+        if (!started) {
+            taskENTER_CRITICAL(&setup_lock);
+            step = step_failed();
+            taskEXIT_CRITICAL(&setup_lock);
+        }
+    }
+}
+
+/**
+ * @brief Find the report characteristic and its client configuration
+ *        descriptor in the results of the search.
+ * 
+ * @param handles Filled in with the handles found.
+ * @return true if both were found.
+*/
+static bool find_handles(HandleCache_t* handles) {
+    uint16_t conn_id = gl_profile_tab[PROFILE_A_APP_ID].conn_id;
+    uint16_t start = gl_profile_tab[PROFILE_A_APP_ID].service_start_handle;
+    uint16_t end = gl_profile_tab[PROFILE_A_APP_ID].service_end_handle;
+    uint16_t count = 0;
+    esp_gatt_status_t ret_status =
+        esp_ble_gattc_get_attr_count(setup.gattc_if, conn_id,
+                                     ESP_GATT_DB_CHARACTERISTIC, start, end,
+                                     INVALID_HANDLE, &count);
+    if (ret_status != ESP_GATT_OK || count == 0) {
+        ESP_LOGE(GATTC_TAG, "esp_ble_gattc_get_attr_count error, %d",
+                 __LINE__);
+        return false;
+    }
+    esp_gattc_char_elem_t *chars = malloc(sizeof(esp_gattc_char_elem_t) *
+                                          count);
+    if (chars == NULL) {
+        ESP_LOGE(GATTC_TAG, "gattc no mem");
+        return false;
+    }
+    // Find the report characteristic, which must notify
+    uint16_t report = INVALID_HANDLE;
+    ret_status = esp_ble_gattc_get_all_char(setup.gattc_if, conn_id, start,
+                                            end, chars, &count, 0);
+    for (int i = 0; ret_status == ESP_GATT_OK && i < count; i++) {
+        if (chars[i].uuid.len == ESP_UUID_LEN_16 &&
+            chars[i].uuid.uuid.uuid16 == HID_RPT_CHAR_UUID &&
+            (chars[i].properties & ESP_GATT_CHAR_PROP_BIT_NOTIFY)) {
+            report = chars[i].char_handle;
+            break;
+        }
+    }
+    free(chars);
+    if (report == INVALID_HANDLE) {
+        ESP_LOGE(GATTC_TAG, "report characteristic not found");
+        return false;
+    }
+
+    // Find its client characteristic configuration descriptor
+    count = 0;
+    ret_status = esp_ble_gattc_get_attr_count(setup.gattc_if, conn_id,
+                                              ESP_GATT_DB_DESCRIPTOR, start,
+                                              end, report, &count);
+    if (ret_status != ESP_GATT_OK || count == 0) {
+        ESP_LOGE(GATTC_TAG, "esp_ble_gattc_get_attr_count error, %d",
+                 __LINE__);
+        return false;
+    }
+    esp_gattc_descr_elem_t *descrs = malloc(sizeof(esp_gattc_descr_elem_t) *
+                                            count);
+    if (descrs == NULL) {
+        ESP_LOGE(GATTC_TAG, "malloc error, gattc no mem");
+        return false;
+    }
+    uint16_t ccc = INVALID_HANDLE;
+    ret_status = esp_ble_gattc_get_all_descr(setup.gattc_if, conn_id, report,
+                                             descrs, &count, 0);
+    for (int i = 0; ret_status == ESP_GATT_OK && i < count; i++) {
+        if (descrs[i].uuid.len == ESP_UUID_LEN_16 &&
+            descrs[i].uuid.uuid.uuid16 == ESP_GATT_UUID_CHAR_CLIENT_CONFIG) {
+            ccc = descrs[i].handle;
+            break;
+        }
+    }
+    free(descrs);
+    if (ccc == INVALID_HANDLE) {
+        ESP_LOGE(GATTC_TAG, "report client configuration not found");
+        return false;
+    }
+
+    gl_profile_tab[PROFILE_A_APP_ID].notify_char_handle = report;
+    handles->service_start_handle = start;
+    handles->service_end_handle = end;
+    handles->notify_char_handle = report;
+    handles->ccc_handle = ccc;
+    return true;
+}
+
+/**
+ * @brief Timeout timer callback, retrying a step that was not answered.
+ * 
+ * A timeout that fires as the step is answered or replaced, and so is
+ * already past, finds the step no longer timing or its deadline not yet due.
+ * 
+ * @param arg Unused.
+*/
+static void setup_timer_cb(void* arg) {
+    SetupStep_t step = STEP_NONE;
+    taskENTER_CRITICAL(&setup_lock);
+    if (setup.timing &&
+        (int32_t) ((uint32_t) rep_clock_us() - setup.deadline_us) >= 0) {
+        setup.stats.timeouts++;
+        step = step_failed();
+    }
+    taskEXIT_CRITICAL(&setup_lock);
+    run_step(step);
+}
+
+void conn_setup_init(void) {
+    const esp_timer_create_args_t timer_args = {
+        .callback = setup_timer_cb,
+        .name = "conn_setup",
+    };
+    if (esp_timer_create(&timer_args, &setup.timer)) {
+        // Without the timer, steps that are never answered are not retried
+        ESP_LOGE(GATTC_TAG, "connection setup timer create failed");
+        setup.timer = NULL;
+    }
+}
+
+void conn_setup_on_open(esp_gatt_if_t gattc_if) {
+    // With the handles of this controller cached, subscribe right away
+    // rather than searching for them
+    HandleCache_t handles;
+    memset(&handles, 0, sizeof(handles));
+    bool cached = HANDLE_CACHE_ENABLED &&
+                  handle_cache_load(gl_profile_tab[PROFILE_A_APP_ID].
+                                    remote_bda, &handles);
+    if (cached) {
+        gl_profile_tab[PROFILE_A_APP_ID].service_start_handle =
+                                                  handles.service_start_handle;
+        gl_profile_tab[PROFILE_A_APP_ID].service_end_handle =
+                                                    handles.service_end_handle;
+        gl_profile_tab[PROFILE_A_APP_ID].notify_char_handle =
+                                                    handles.notify_char_handle;
+    }
+
+    taskENTER_CRITICAL(&setup_lock);
+    uint32_t now_us = (uint32_t) rep_clock_us();
+    setup.gattc_if = gattc_if;
+    setup.reported = false;
+    setup.encrypted = false;
+    setup.await_encrypt = false;
+    setup.open_us = now_us;
+    memset(setup.phase_ms, 0, sizeof(setup.phase_ms));
+    setup.phase_us = now_us;
+    setup.stats.encrypt_ms = 0;
+    setup.handles = handles;
+    setup.from_cache = cached;
+    enter(cached ? SETUP_SUBSCRIBE : SETUP_SEARCH, now_us);
+    SetupStep_t step = begin(cached ? STEP_SUBSCRIBE : STEP_SEARCH);
+    taskEXIT_CRITICAL(&setup_lock);
+    run_step(step);
+}
+
+void conn_setup_on_service(uint16_t start_handle, uint16_t end_handle) {
+    taskENTER_CRITICAL(&setup_lock);
+    bool searching = setup.phase == SETUP_SEARCH;
+    if (searching) {
+        setup.get_service = true;
+    }
+    taskEXIT_CRITICAL(&setup_lock);
+    if (searching) {
+        gl_profile_tab[PROFILE_A_APP_ID].service_start_handle = start_handle;
+        gl_profile_tab[PROFILE_A_APP_ID].service_end_handle = end_handle;
+    }
+}
+
+void conn_setup_on_search_cmpl(esp_gatt_if_t gattc_if,
+                               esp_gatt_status_t status) {
+    // A search retried after a timeout may complete twice
+    taskENTER_CRITICAL(&setup_lock);
+    bool searching = setup.phase == SETUP_SEARCH;
+    bool found = setup.get_service;
+    taskEXIT_CRITICAL(&setup_lock);
+    if (!searching) {
+        return;
+    }
+    // The results are read from the stack before taking the lock again
+    HandleCache_t handles;
+    memset(&handles, 0, sizeof(handles));
+    bool ok = status == ESP_GATT_OK && found && find_handles(&handles);
+
+    SetupStep_t step = STEP_NONE;
+    taskENTER_CRITICAL(&setup_lock);
+    if (setup.phase == SETUP_SEARCH) {
+        if (ok) {
+            setup.handles = handles;
+            enter(SETUP_SUBSCRIBE, (uint32_t) rep_clock_us());
+            step = begin(STEP_SUBSCRIBE);
+        } else {
+            step = step_failed();
+        }
+    }
+    taskEXIT_CRITICAL(&setup_lock);
+    run_step(step);
+}
+
+void conn_setup_on_registered(esp_gatt_if_t gattc_if,
+                              esp_gatt_status_t status) {
+    // The write of the client configuration is already under way
+    SetupStep_t step = STEP_NONE;
+    taskENTER_CRITICAL(&setup_lock);
+    if (setup.phase == SETUP_SUBSCRIBE && status != ESP_GATT_OK) {
+        step = step_failed();
+    }
+    taskEXIT_CRITICAL(&setup_lock);
+    run_step(step);
+}
+
+void conn_setup_on_write(esp_gatt_if_t gattc_if, esp_gatt_status_t status,
+                         uint16_t handle) {
+    SetupStep_t step = STEP_NONE;
+    bool store = false;
+    HandleCache_t handles;
+    taskENTER_CRITICAL(&setup_lock);
+    if (setup.phase != SETUP_SUBSCRIBE ||
+        handle != setup.handles.ccc_handle) {
+        taskEXIT_CRITICAL(&setup_lock);
+        return;
+    }
+    if ((status == ESP_GATT_INSUF_AUTHENTICATION ||
+         status == ESP_GATT_INSUF_ENCRYPTION) && !setup.encrypted) {
+        // Written before pairing finished, the handles are not at fault
+        setup.await_encrypt = true;
+    } else if (status != ESP_GATT_OK) {
+        step = step_failed();
+    } else {
+        // Handles found by the search are kept for the next connection
+        store = HANDLE_CACHE_ENABLED && !setup.from_cache;
+        handles = setup.handles;
+        // Notifications were enabled again on a connection already streaming
+        enter(setup.reported ? SETUP_STREAMING : SETUP_WAIT_REPORT,
+              (uint32_t) rep_clock_us());
+        // Cached handles the controller took but does not notify on are
+        // stale, so the first report is timed once the link is encrypted
+        if (setup.phase == SETUP_WAIT_REPORT && setup.from_cache &&
+            setup.encrypted) {
+            step = begin(STEP_WAIT);
+        }
+    }
+    taskEXIT_CRITICAL(&setup_lock);
+    if (store) {
+        handle_cache_store(gl_profile_tab[PROFILE_A_APP_ID].remote_bda,
+                           &handles);
+    }
+    run_step(step);
+}
+
+void conn_setup_on_encrypted(void) {
+    SetupStep_t step = STEP_NONE;
+    taskENTER_CRITICAL(&setup_lock);
+    if (setup.phase == SETUP_IDLE || setup.encrypted) {
+        taskEXIT_CRITICAL(&setup_lock);
+        return;
+    }
+    setup.encrypted = true;
+    setup.stats.encrypt_ms = ((uint32_t) rep_clock_us() - setup.open_us) /
+                             1000;
+    if (setup.phase == SETUP_SUBSCRIBE && setup.await_encrypt) {
+        setup.await_encrypt = false;
+        step = begin(STEP_SUBSCRIBE);
+    } else if (setup.phase == SETUP_WAIT_REPORT && setup.from_cache) {
+        step = begin(STEP_WAIT);
+    }
+    taskEXIT_CRITICAL(&setup_lock);
+    run_step(step);
+}
+
+void conn_setup_on_report(uint32_t stamp_us) {
+    taskENTER_CRITICAL(&setup_lock);
+    if (setup.phase == SETUP_IDLE || setup.reported) {
+        taskEXIT_CRITICAL(&setup_lock);
+        return;
+    }
+    // A report can overtake the answer to the write enabling it
+    setup.reported = true;
+    enter(SETUP_STREAMING, stamp_us);
+    ConnSetupStats_t *stats = &setup.stats;
+    uint32_t ms = (stamp_us - setup.open_us) / 1000;
+    stats->setups++;
+    stats->connect_ms = ms;
+    if (ms > stats->max_connect_ms) {
+        stats->max_connect_ms = ms;
+    }
+    memcpy(stats->phase_ms, setup.phase_ms, sizeof(stats->phase_ms));
+    stats->cached = setup.from_cache;
+    if (stats->boot_ms == 0) {
+        stats->boot_ms = stamp_us / 1000;
+    }
+    ConnSetupStats_t logged = *stats;
+    taskEXIT_CRITICAL(&setup_lock);
+    ESP_LOGI(GATTC_TAG, "first report %lu ms after opening (search %lu, "
+             "subscribe %lu, wait %lu), %lu ms after boot", (unsigned long) ms,
+             (unsigned long) logged.phase_ms[SETUP_SEARCH],
+             (unsigned long) logged.phase_ms[SETUP_SUBSCRIBE],
+             (unsigned long) logged.phase_ms[SETUP_WAIT_REPORT],
+             (unsigned long) logged.boot_ms);
+}
+
+void conn_setup_on_service_change(esp_gatt_if_t gattc_if) {
+    SetupStep_t step = STEP_NONE;
+    taskENTER_CRITICAL(&setup_lock);
+    if (setup.phase != SETUP_IDLE) {
+        // The cached handles may have moved, search all of the services again
+        drop_handles();
+        enter(SETUP_SEARCH, (uint32_t) rep_clock_us());
+        step = begin(STEP_RESEARCH);
+    }
+    taskEXIT_CRITICAL(&setup_lock);
+    run_step(step);
+}
+
+void conn_setup_on_disconnect(void) {
+    taskENTER_CRITICAL(&setup_lock);
+    enter(SETUP_IDLE, (uint32_t) rep_clock_us());
+    setup.from_cache = false;
+    taskEXIT_CRITICAL(&setup_lock);
+    if (setup.timer != NULL) {
+        esp_timer_stop(setup.timer);
+    }
+}
+
+ConnSetupPhase_t conn_setup_phase(void) {
+    return setup.phase;
+}
+
+const ConnSetupStats_t *conn_setup_get(void) {
+    return &setup.stats;
+}
@@ -0,0 +1,175 @@
+/**
+ * @file    conn_setup.h
+ * @brief   State machine setting up a connection to the controller, from the
+ *          open connection to the first report.
+ * 
+ * The local MTU is the BLE 4.0 default of 23 bytes the Stadia controller
+ * uses, so no MTU exchange is made: it could only agree on 23 bytes again.
+ * The setup goes through these phases, each timed:
+ * 
+ *  - SETUP_SEARCH: the HID service is searched for, as soon as the connection
+ *    opens. Skipped when the report's handles are in the handle cache.
+ *  - SETUP_SUBSCRIBE: the report characteristic and its client configuration
+ *    descriptor are looked up in the results of the search, then registering
+ *    for notifications, which is local to the stack, and writing the client
+ *    configuration are issued together. The write waits for the controller's
+ *    response, and if the controller refuses it until the link is encrypted,
+ *    it is made again once it is.
+ *  - SETUP_WAIT_REPORT: notifications are enabled, waiting for the first
+ *    report, which also needs the link to be encrypted. Pairing runs alongside
+ *    the search and subscription.
+ *  - SETUP_STREAMING: reports are flowing.
+ * 
+ * A search or subscription that fails or is not answered within
+ * CONN_SETUP_TIMEOUT_MS is retried up to CONN_SETUP_RETRIES times. Cached
+ * handles that fail, or after which no report arrives within
+ * CONN_SETUP_TIMEOUT_MS of the link being encrypted, fall back to a full
+ * search. When the retries run out the
+ * connection is closed, so the reconnect manager opens a fresh one. A service
+ * change drops the cached handles and searches again.
+ * 
+ * The times from boot and from the opening of the connection to the first
+ * report, and the time spent in each phase, are logged and kept in the setup
+ * statistics.
+ * 
+ * The state machine is driven from the GATT client and GAP callbacks, which
+ * run in the Bluetooth task, and from its timeout timer, which runs in the
+ * esp_timer task. Both update the state in a critical section and call into
+ * the stack once they leave it.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef CONN_SETUP_H
+#define CONN_SETUP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_gattc_api.h"
+
+/**
+ * @brief The phases of the connection setup.
+*/
+typedef enum ConnSetupPhase {
+    SETUP_IDLE,         // Not connected
+    SETUP_SEARCH,       // Searching for the HID service
+    SETUP_SUBSCRIBE,    // Enabling notifications on the report
+    SETUP_WAIT_REPORT,  // Waiting for the first report
+    SETUP_STREAMING,    // Reports are flowing
+    SETUP_NUM_PHASES
+} ConnSetupPhase_t;
+
+/**
+ * @brief The connection setup statistics.
+*/
+typedef struct ConnSetupStats {
+    uint32_t setups;            // Connections that received a report.
+    uint32_t boot_ms;           // Time from boot to the first report ever.
+    uint32_t connect_ms;        // Time from the connection opening to the
+                                // first report, last setup.
+    uint32_t max_connect_ms;    // Longest time to the first report.
+    uint32_t encrypt_ms;        // Time from the connection opening to
+                                // encryption, last setup.
+    uint32_t phase_ms[SETUP_NUM_PHASES];    // Time spent in each phase, last
+                                            // setup.
+    bool cached;                // The last setup used cached handles.
+    uint32_t retries;           // Searches and subscriptions retried.
+    uint32_t timeouts;          // Searches and subscriptions not answered in
+                                // time.
+    uint32_t failures;          // Connections closed after the retries ran
+                                // out.
+} ConnSetupStats_t;
+
+/**
+ * @brief Create the timeout timer. Must be called before the first
+ *        connection.
+*/
+void conn_setup_init(void);
+
+/**
+ * @brief Start setting up a connection that opened. The connection ID and
+ *        address must be in gl_profile_tab.
+ * 
+ * @param gattc_if The interface of the connection.
+*/
+void conn_setup_on_open(esp_gatt_if_t gattc_if);
+
+/**
+ * @brief Note the HID service found by the search.
+ * 
+ * @param start_handle The first handle of the service.
+ * @param end_handle The last handle of the service.
+*/
+void conn_setup_on_service(uint16_t start_handle, uint16_t end_handle);
+
+/**
+ * @brief Handle the end of a service search.
+ * 
+ * @param gattc_if The interface of the connection.
+ * @param status The status of the search.
+*/
+void conn_setup_on_search_cmpl(esp_gatt_if_t gattc_if,
+                               esp_gatt_status_t status);
+
+/**
+ * @brief Handle the outcome of registering for notifications.
+ * 
+ * @param gattc_if The interface of the connection.
+ * @param status The status of the registration.
+*/
+void conn_setup_on_registered(esp_gatt_if_t gattc_if,
+                              esp_gatt_status_t status);
+
+/**
+ * @brief Handle the outcome of writing a descriptor.
+ * 
+ * @param gattc_if The interface of the connection.
+ * @param status The status of the write.
+ * @param handle The descriptor written.
+*/
+void conn_setup_on_write(esp_gatt_if_t gattc_if, esp_gatt_status_t status,
+                         uint16_t handle);
+
+/**
+ * @brief Note that the link was encrypted.
+*/
+void conn_setup_on_encrypted(void);
+
+/**
+ * @brief Note a report received, ending the setup with the first one.
+ * 
+ * @param stamp_us The arrival time of the report, from rep_clock_us.
+*/
+void conn_setup_on_report(uint32_t stamp_us);
+
+/**
+ * @brief Set up notifications again after the controller changed its
+ *        services.
+ * 
+ * @param gattc_if The interface of the connection.
+*/
+void conn_setup_on_service_change(esp_gatt_if_t gattc_if);
+
+/**
+ * @brief Stop setting up the connection that dropped.
+*/
+void conn_setup_on_disconnect(void);
+
+/**
+ * @brief Get the current phase of the setup.
+ * 
+ * @return The phase.
+*/
+ConnSetupPhase_t conn_setup_phase(void);
+
+/**
+ * @brief Get the connection setup statistics.
+ * 
+ * @return The statistics, updated live.
+*/
+const ConnSetupStats_t *conn_setup_get(void);
+
+#endif /* #ifndef CONN_SETUP_H */
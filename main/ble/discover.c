@@ -0,0 +1,210 @@
+/**
+ * @file    discover.c
+ * @brief   Implementation of the discovery of the controller
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "ble/discover.h"
+#include "ble/reconnect.h"
+#include "publish/rep_queue.h"
+#include "globalconst.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief The scanning parameters. Duplicates are always filtered, the filter
+ *        policy and scan type follow the whitelist.
+*/
+static esp_ble_scan_params_t ble_scan_params = {
+    .scan_type              = BLE_SCAN_TYPE_ACTIVE,
+    .own_addr_type          = BLE_ADDR_TYPE_RPA_PUBLIC,
+    .scan_filter_policy     = BLE_SCAN_FILTER_ALLOW_ALL,
+    .scan_interval          = 0x50,
+    .scan_window            = 0x30,
+    .scan_duplicate         = BLE_SCAN_DUPLICATE_ENABLE
+};
+
+/**
+ * @brief The state of discovery.
+*/
+static struct {
+    bool looking;           // Scanning and the controller is not found yet.
+    bool whitelisted;       // Scans only report bonded devices.
+    uint32_t start_us;      // Time scanning started.
+    uint32_t results;       // Scan results handled since then.
+    DiscoverStats_t stats;  // The statistics.
+} disc;
+
+/**
+ * @brief Set the scan parameters for whitelisted or open scans.
+ * 
+ * @param whitelisted Only report devices in the whitelist.
+*/
+static void set_params(bool whitelisted) {
+    // Bonded devices are connected to by address, no scan response is needed
+    ble_scan_params.scan_type = whitelisted ? BLE_SCAN_TYPE_PASSIVE
+                                            : BLE_SCAN_TYPE_ACTIVE;
+    ble_scan_params.scan_filter_policy = whitelisted ?
+                                         BLE_SCAN_FILTER_ALLOW_ONLY_WLST :
+                                         BLE_SCAN_FILTER_ALLOW_ALL;
+    disc.whitelisted = whitelisted;
+    esp_err_t ret = esp_ble_gap_set_scan_params(&ble_scan_params);
+    if (ret) {
+        ESP_LOGE(GATTC_TAG, "set scan params error, error code = %x", ret);
+    }
+}
+
+/**
+ * @brief Get the whitelist address type of a bonded device.
+ * 
+ * @param addr_type The type of its address.
+ * @return The whitelist address type.
+*/
+static esp_ble_wl_addr_type_t wl_addr_type(esp_ble_addr_type_t addr_type) {
+    return addr_type == BLE_ADDR_TYPE_RANDOM ? BLE_WL_ADDR_TYPE_RANDOM
+                                             : BLE_WL_ADDR_TYPE_PUBLIC;
+}
+
+void discover_configure(void) {
+    // The bond list is read even without the whitelist, as it gives the
+    // reconnect manager the controller to connect to directly after a restart
+    int count = esp_ble_get_bond_device_num();
+    if (count > DISCOVER_MAX_BONDS) {
+        count = DISCOVER_MAX_BONDS;
+    }
+    esp_ble_bond_dev_t *bonds = NULL;
+    if (count > 0) {
+        bonds = malloc(sizeof(esp_ble_bond_dev_t) * count);
+        if (bonds == NULL ||
+            esp_ble_get_bond_device_list(&count, bonds) != ESP_OK) {
+            ESP_LOGE(GATTC_TAG, "bond list unavailable, scanning for all");
+            count = 0;
+        }
+    }
+    if (count > 0) {
+        // Only the controller is ever bonded, the first of several is tried
+        reconnect_seed_peer(bonds[0].bd_addr,
+                            bonds[0].bond_key.pid_key.addr_type);
+    }
+    if (!DISCOVER_WHITELIST) {
+        count = 0;
+    }
+    esp_ble_gap_clear_whitelist();
+    for (int i = 0; i < count; i++) {
+        esp_ble_gap_update_whitelist(true, bonds[i].bd_addr,
+                            wl_addr_type(bonds[i].bond_key.pid_key.addr_type));
+    }
+    free(bonds);
+    set_params(count > 0);
+}
+
+void discover_add_bonded(const esp_bd_addr_t bda,
+                         esp_ble_addr_type_t addr_type) {
+    if (!DISCOVER_WHITELIST) {
+        return;
+    }
+    esp_bd_addr_t addr;
+    memcpy(addr, bda, sizeof(esp_bd_addr_t));
+    esp_err_t ret = esp_ble_gap_update_whitelist(true, addr,
+                                                 wl_addr_type(addr_type));
+    if (ret) {
+        ESP_LOGE(GATTC_TAG, "whitelist add error, error code = %x", ret);
+        return;
+    }
+    if (!disc.whitelisted) {
+        set_params(true);
+    }
+}
+
+void discover_on_scan_start(void) {
+    // Restarted scans keep measuring from the first one
+    if (!disc.looking) {
+        disc.looking = true;
+        disc.start_us = (uint32_t) rep_clock_us();
+        disc.results = 0;
+    }
+}
+
+/**
+ * @brief Find the advertised appearance in a scan result.
+ * 
+ * @param rst The scan result.
+ * @return The appearance, or 0 if none was advertised.
+*/
+static uint16_t adv_appearance(struct ble_scan_result_evt_param* rst) {
+    uint8_t len = 0;
+    uint8_t *data = esp_ble_resolve_adv_data(rst->ble_adv,
+                                             ESP_BLE_AD_TYPE_APPEARANCE, &len);
+    return data != NULL && len == 2 ? data[0] | (data[1] << 8) : 0;
+}
+
+/**
+ * @brief Check whether the advertised name starts with DISCOVER_NAME_PREFIX.
+ * 
+ * @param rst The scan result.
+ * @return true if it does.
+*/
+static bool name_matches(struct ble_scan_result_evt_param* rst) {
+    size_t prefix_len = strlen(DISCOVER_NAME_PREFIX);
+    uint8_t len = 0;
+    uint8_t *name = esp_ble_resolve_adv_data(rst->ble_adv,
+                                             ESP_BLE_AD_TYPE_NAME_CMPL, &len);
+    if (name == NULL) {
+        name = esp_ble_resolve_adv_data(rst->ble_adv,
+                                        ESP_BLE_AD_TYPE_NAME_SHORT, &len);
+    }
+    if (GATTC_DEBUG && name != NULL) {
+        ESP_LOGI(GATTC_TAG, "Searched Device Name Len %d", len);
+        esp_log_buffer_char(GATTC_TAG, name, len);
+    }
+    return name != NULL && len >= prefix_len &&
+           memcmp(name, DISCOVER_NAME_PREFIX, prefix_len) == 0;
+}
+
+bool discover_match(struct ble_scan_result_evt_param* rst) {
+    disc.results++;
+    disc.stats.results++;
+    bool match;
+    if (disc.whitelisted) {
+        // The controller only reports bonded devices
+        match = true;
+    } else {
+        uint16_t appearance = DISCOVER_MATCH_APPEARANCE ? adv_appearance(rst)
+                                                        : 0;
+        match = appearance == DISCOVER_APPEARANCE_GAMEPAD ||
+                appearance == DISCOVER_APPEARANCE_JOYSTICK ||
+                name_matches(rst);
+    }
+    if (!match || !disc.looking) {
+        return match;
+    }
+    disc.looking = false;
+    uint32_t ms = ((uint32_t) rep_clock_us() - disc.start_us) / 1000;
+    disc.stats.discoveries++;
+    disc.stats.last_ms = ms;
+    disc.stats.last_results = disc.results;
+    disc.stats.whitelisted = disc.whitelisted;
+    if (ms > disc.stats.max_ms) {
+        disc.stats.max_ms = ms;
+    }
+    ESP_LOGI(GATTC_TAG, "found the controller after %lu ms, %lu scan results",
+             (unsigned long) ms, (unsigned long) disc.results);
+    return true;
+}
+
+bool discover_on_scan_done(void) {
+    if (!disc.whitelisted) {
+        return false;
+    }
+    // No bonded device came back, let a new controller be paired
+    set_params(false);
+    return true;
+}
+
+const DiscoverStats_t *discover_get(void) {
+    return &disc.stats;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file    discover.h
+ * @brief   Discovery of the controller by scanning.
+ * 
+ * Scans filter duplicate advertisements in the controller, so each nearby
+ * device is reported once per scan rather than on every advertisement. Once a
+ * controller has bonded, its address is put in the controller's whitelist and
+ * scans only report bonded devices, without asking them for a scan response.
+ * A whitelisted scan that runs out without finding one opens the next scans
+ * to every device again, so a new controller can still be paired.
+ * 
+ * Without a bond, a device matches if its advertised name starts with
+ * DISCOVER_NAME_PREFIX or, with DISCOVER_MATCH_APPEARANCE, if it advertises
+ * the gamepad or joystick HID appearance. The appearance is checked first as
+ * it is in the advertisement itself.
+ * 
+ * The time from the start of scanning to finding the controller, and the
+ * number of scan results handled meanwhile, are measured and logged, and kept
+ * in the discovery statistics.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef DISCOVER_H
+#define DISCOVER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_gap_ble_api.h"
+
+// Bonded devices put in the whitelist, others are left out
+#define DISCOVER_MAX_BONDS 8
+
+// HID appearances of a joystick and a gamepad
+#define DISCOVER_APPEARANCE_JOYSTICK 0x03C3
+#define DISCOVER_APPEARANCE_GAMEPAD  0x03C4
+
+/**
+ * @brief The discovery statistics.
+*/
+typedef struct DiscoverStats {
+    uint32_t discoveries;   // Times the controller was found.
+    uint32_t last_ms;       // Time from the start of scanning to finding the
+                            // controller, last discovery.
+    uint32_t max_ms;        // Longest time to find the controller.
+    uint32_t last_results;  // Scan results handled, last discovery.
+    uint32_t results;       // Scan results handled in all.
+    bool whitelisted;       // The last discovery only saw bonded devices.
+} DiscoverStats_t;
+
+/**
+ * @brief Set the scan parameters, putting the bonded devices in the
+ *        whitelist, and hand the first bonded device to the reconnect
+ *        manager. The GAP handler starts scanning once they are set.
+*/
+void discover_configure(void);
+
+/**
+ * @brief Add a newly bonded device to the whitelist, for scans after the
+ *        next disconnection. Must not be called while scanning.
+ * 
+ * @param bda The device's address.
+ * @param addr_type The type of the address.
+*/
+void discover_add_bonded(const esp_bd_addr_t bda,
+                         esp_ble_addr_type_t addr_type);
+
+/**
+ * @brief Note that a scan started, starting the measurement of a discovery.
+*/
+void discover_on_scan_start(void);
+
+/**
+ * @brief Check whether a scan result is the controller to connect to.
+ * 
+ * @param rst The scan result.
+ * @return true if it matches, ending the measurement of the discovery.
+*/
+bool discover_match(struct ble_scan_result_evt_param* rst);
+
+/**
+ * @brief Handle a scan running out without finding the controller.
+ * 
+ * @return true if the scan was whitelisted and the scan parameters are being
+ *         set to report every device, in which case scanning restarts once
+ *         they are set. false if the scan should be restarted as it is.
+*/
+bool discover_on_scan_done(void);
+
+/**
+ * @brief Get the discovery statistics.
+ * 
+ * @return The statistics, updated live.
+*/
+const DiscoverStats_t *discover_get(void);
+
+#endif /* #ifndef DISCOVER_H */
@@ -13,13 +13,16 @@
 */
 
 #include "publish/rep_queue.h"
+#include "publish/lat_hist.h"
+#include "publish/con_state.h"
+#include "ble/rate_mon.h"
+#include "ble/reconnect.h"
+#include "ble/conn_setup.h"
+#include "ble/conn_params.h"
 #include "ble/gattc.h"
 #include "ble/auth_gap.h"
 #include "globalconst.h"
 
-// Placeholder for an empty char handle when searching all chars in service
-#define INVALID_HANDLE   0
-
 extern bool connect;
 
 // Shared with the GAP profile to share bluetooth external device information
@@ -30,22 +33,6 @@ struct gattc_profile_inst gl_profile_tab[PROFILE_NUM] = {
     },
 };
 
-/** 
- * These fields are used to store information about the connected service's 
- * characteristics and descriptors.
-*/
-static esp_gattc_char_elem_t *char_elem_result   = NULL;
-static esp_gattc_descr_elem_t *descr_elem_result = NULL;
-
-// Indicates if the service has been found
-static bool get_service = false;
-
-// Filters discovered services by the HID service UUID
-static esp_bt_uuid_t remote_filter_service_uuid = {
-    .len = ESP_UUID_LEN_16,
-    .uuid = {.uuid16 = HID_SERVICE_UUID,},
-};
-
 /**
  * Callback functions for the GATT client to handle events from the ESP32C6
 */
@@ -85,6 +72,28 @@ void esp_gattc_cb(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if,
     } while (0);
 }
 
+void gattc_handle_notify(const uint8_t* value, uint16_t len) {
+    // The report is copied into the queue by value, so a stack copy is all
+    // that is needed here. It is stamped on arrival, before any queueing.
+    StadiaRep_t rep;
+    rep.stamp_us = (uint32_t) rep_clock_us();
+    if (output_trace != TRACE_OFF) {
+        publish_trace(rep.stamp_us, value, len);
+    }
+    LAT_HIST_START(load_start);
+    bool loaded = load_stadia_rep(&rep, value, len);
+    LAT_HIST_END(LAT_LOAD, load_start);
+    if (loaded) {
+        rate_mon_record(&rep);
+        reconnect_on_report(rep.stamp_us);
+        conn_setup_on_report(rep.stamp_us);
+        conn_params_on_report(&rep);
+        LAT_HIST_START(insert_start);
+        ingest_stadia_rep(repQueue, &rep);
+        LAT_HIST_END(LAT_INSERT, insert_start);
+    }
+}
+
 void gattc_profile_event_handler(esp_gattc_cb_event_t event,
                                  esp_gatt_if_t gattc_if,
                                  esp_ble_gattc_cb_param_t *param) {
@@ -99,13 +108,23 @@ void gattc_profile_event_handler(esp_gattc_cb_event_t event,
             esp_ble_gap_config_local_privacy(true);
             break;
 
+        // Link established. Start monitoring the reports of this connection,
+        // the interval being in units of 1.25 ms, and managing its parameters.
+        case ESP_GATTC_CONNECT_EVT:
+            rate_mon_reset(p_data->connect.conn_params.interval * 1250);
+            conn_params_on_connect(p_data->connect.remote_bda,
+                                   &p_data->connect.conn_params);
+            break;
+
         // Connection opened to an external device. Ensure success.
         case ESP_GATTC_OPEN_EVT:
             if (param->open.status != ESP_GATT_OK){
                 ESP_LOGE(GATTC_TAG, "open failed, error status = %x",
                          p_data->open.status);
+                reconnect_on_open(false);
                 break;
             }
+            reconnect_on_open(true);
             if (GATTC_DEBUG) {
                 ESP_LOGI(GATTC_TAG, "open success");
             }
@@ -120,22 +139,14 @@ void gattc_profile_event_handler(esp_gattc_cb_event_t event,
                                gl_profile_tab[PROFILE_A_APP_ID].remote_bda,
                                sizeof(esp_bd_addr_t));
             }
-            
-            // Start the MTU request. We need to negotiate the MTU rate. For
-            // the Stadia controller, we need to set the MTU to 23 since it uses 
-            // ble 4.0
-            esp_err_t mtu_ret = esp_ble_gattc_send_mtu_req(gattc_if,
-                                                          p_data->open.conn_id);
-            if (mtu_ret){
-                ESP_LOGE(GATTC_TAG, "config MTU error, error code = %x",
-                         mtu_ret);
-            }
-            if (GATTC_DEBUG) {
-                ESP_LOGI(GATTC_TAG, "POST MTU request\n");
-            }
+
+            // Set up notifications on the report. The MTU is not exchanged,
+            // the Stadia controller uses the BLE 4.0 default of 23 which is
+            // also the local MTU.
+            conn_setup_on_open(gattc_if);
             break;
 
-        // MTU request event. Ensure success.
+        // MTU exchanged by the peer. Ensure success.
         case ESP_GATTC_CFG_MTU_EVT:
             if (param->cfg_mtu.status != ESP_GATT_OK){
                 ESP_LOGE(GATTC_TAG,"config mtu failed, error status = %x",
@@ -147,8 +158,6 @@ void gattc_profile_event_handler(esp_gattc_cb_event_t event,
                      param->cfg_mtu.status, param->cfg_mtu.mtu,
                      param->cfg_mtu.conn_id);
             }
-            esp_ble_gattc_search_service(gattc_if, param->cfg_mtu.conn_id,
-                                         &remote_filter_service_uuid);
             break;
         
         // Service search returned result. Store the service information found.
@@ -169,20 +178,19 @@ void gattc_profile_event_handler(esp_gattc_cb_event_t event,
             if (p_data->search_res.srvc_id.uuid.len == ESP_UUID_LEN_16 &&
                 p_data->search_res.srvc_id.uuid.uuid.uuid16 == 
                 HID_SERVICE_UUID) {
-                get_service = true;
-                gl_profile_tab[PROFILE_A_APP_ID].service_start_handle =
-                                                p_data->search_res.start_handle;
-                gl_profile_tab[PROFILE_A_APP_ID].service_end_handle =
-                                                  p_data->search_res.end_handle;
+                conn_setup_on_service(p_data->search_res.start_handle,
+                                      p_data->search_res.end_handle);
             }
             break;
         }
 
-        // Service search is completed. Log the status of the search.
+        // Service search is completed. Log the status of the search and
+        // subscribe to the HID report characteristic.
         case ESP_GATTC_SEARCH_CMPL_EVT:
             if (p_data->search_cmpl.status != ESP_GATT_OK){
                 ESP_LOGE(GATTC_TAG, "search service failed, error status = %x",
                          p_data->search_cmpl.status);
+                conn_setup_on_search_cmpl(gattc_if, p_data->search_cmpl.status);
                 break;
             }
             if(p_data->search_cmpl.searched_service_source ==
@@ -202,165 +210,48 @@ void gattc_profile_event_handler(esp_gattc_cb_event_t event,
                 }
             }
 
-            // If we found the HID service, search for the HID report
-            // characteristic to enable notifications on.
-            if (get_service){
-                uint16_t count  = 0;
-                uint16_t offset = 0;
-                esp_gatt_status_t ret_status =
-                          esp_ble_gattc_get_attr_count(gattc_if,
-                          gl_profile_tab[PROFILE_A_APP_ID].conn_id,
-                          ESP_GATT_DB_CHARACTERISTIC,
-                          gl_profile_tab[PROFILE_A_APP_ID].service_start_handle,
-                          gl_profile_tab[PROFILE_A_APP_ID].service_end_handle,
-                          INVALID_HANDLE, &count);
-                if (ret_status != ESP_GATT_OK){
-                    ESP_LOGE(GATTC_TAG,
-                             "esp_ble_gattc_get_attr_count error, %d",
-                             __LINE__);
-                }
-                if (count > 0){
-                    char_elem_result = (esp_gattc_char_elem_t *)
-                                  malloc(sizeof(esp_gattc_char_elem_t) * count);
-                    if (!char_elem_result){
-                        ESP_LOGE(GATTC_TAG, "gattc no mem");
-                    }else{
-                        // Get all characteristics of the HID service
-                        ret_status = esp_ble_gattc_get_all_char(gattc_if,
-                                       gl_profile_tab[PROFILE_A_APP_ID].conn_id,
-                                       gl_profile_tab[PROFILE_A_APP_ID].
-                                           service_start_handle,
-                                       gl_profile_tab[PROFILE_A_APP_ID].
-                                           service_end_handle,
-                                       char_elem_result, &count, offset);
-                        if (ret_status != ESP_GATT_OK){
-                            ESP_LOGE(GATTC_TAG,
-                                     "esp_ble_gattc_get_all_char error, %d",
-                                     __LINE__);
-                        }
-                        // Find the report characteristic and register for 
-                        // notifications
-                        if (count > 0){
-                            for (int i = 0; i < count; ++i)
-                            {
-                                if (char_elem_result[i].uuid.len ==
-                                    ESP_UUID_LEN_16
-                                    && char_elem_result[i].uuid.uuid.uuid16 ==
-                                    HID_RPT_CHAR_UUID &&
-                                    (char_elem_result[i].properties &
-                                    ESP_GATT_CHAR_PROP_BIT_NOTIFY))
-                                {
-                                    gl_profile_tab[PROFILE_A_APP_ID].notify_char_handle =
-                                    char_elem_result[i].char_handle;
-                                    esp_ble_gattc_register_for_notify(gattc_if,
-                                    gl_profile_tab[PROFILE_A_APP_ID].remote_bda,
-                                               char_elem_result[i].char_handle);
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                    free(char_elem_result);
-                }
-            }
+            conn_setup_on_search_cmpl(gattc_if, p_data->search_cmpl.status);
             break;
 
-        // Register for notifications on the HID report characteristic
-        case ESP_GATTC_REG_FOR_NOTIFY_EVT: {
+        // Registered for notifications on the HID report characteristic. The
+        // write enabling them is already under way.
+        case ESP_GATTC_REG_FOR_NOTIFY_EVT:
             if (p_data->reg_for_notify.status != ESP_GATT_OK){
                 ESP_LOGE(GATTC_TAG, "reg for notify failed, error status = %x",
                          p_data->reg_for_notify.status);
-                break;
             }
-
-                uint16_t count = 0;
-                uint16_t offset = 0;
-                uint16_t notify_en = 0x1;
-                esp_gatt_status_t ret_status = esp_ble_gattc_get_attr_count(
-                          gattc_if, gl_profile_tab[PROFILE_A_APP_ID].conn_id,
-                          ESP_GATT_DB_DESCRIPTOR,
-                          gl_profile_tab[PROFILE_A_APP_ID].service_start_handle,
-                          gl_profile_tab[PROFILE_A_APP_ID].service_end_handle,
-                          p_data->reg_for_notify.handle, &count);
-                if (ret_status != ESP_GATT_OK){
-                    ESP_LOGE(GATTC_TAG,
-                             "esp_ble_gattc_get_attr_count error, %d",
-                             __LINE__);
-                }
-                // Find the client characteristic configuration descriptor
-                // and write to it to enable notifications
-                if (count > 0){
-                    descr_elem_result =
-                                 malloc(sizeof(esp_gattc_descr_elem_t) * count);
-                    if (!descr_elem_result){
-                        ESP_LOGE(GATTC_TAG, "malloc error, gattc no mem");
-                    }else{
-                        ret_status = esp_ble_gattc_get_all_descr(gattc_if,
-                                       gl_profile_tab[PROFILE_A_APP_ID].conn_id,
-                                       p_data->reg_for_notify.handle,
-                                       descr_elem_result, &count, offset);
-                    if (ret_status != ESP_GATT_OK){
-                        ESP_LOGE(GATTC_TAG,
-                                 "esp_ble_gattc_get_all_descr error, %d",
-                                 __LINE__);
-                    }
-
-                        for (int i = 0; i < count; ++i)
-                        {
-                            // Write 0x1 to notify descriptor to enable 
-                            // notifications
-                            if (descr_elem_result[i].uuid.len == ESP_UUID_LEN_16
-                                && descr_elem_result[i].uuid.uuid.uuid16 == 
-                                ESP_GATT_UUID_CHAR_CLIENT_CONFIG)
-                            {
-                                esp_ble_gattc_write_char_descr (gattc_if,
-                                       gl_profile_tab[PROFILE_A_APP_ID].conn_id,
-                                       descr_elem_result[i].handle,
-                                       sizeof(notify_en),
-                                       (uint8_t *)&notify_en,
-                                       ESP_GATT_WRITE_TYPE_NO_RSP,
-                                       ESP_GATT_AUTH_REQ_NONE);
-
-                                break;
-                            }
-                        }
-                    }
-                    free(descr_elem_result);
-                }
-
+            conn_setup_on_registered(gattc_if, p_data->reg_for_notify.status);
             break;
-        }
 
         // Notification received from the HID report characteristic.
-        case ESP_GATTC_NOTIFY_EVT:
+        case ESP_GATTC_NOTIFY_EVT: {
             if (GATTC_DEBUG) {
                 ESP_LOGI(GATTC_TAG, "ESP_GATTC_NOTIFY_EVT, receive notify value:");
                 esp_log_buffer_hex(GATTC_TAG, p_data->notify.value,
                                    p_data->notify.value_len);
             }
-            StadiaRep_t *rep = load_stadia_rep(p_data->notify.value,
-                                               p_data->notify.value_len);
-            if (rep != NULL) {
-                insert_stadia_rep(repQueue, rep);
-            }
+            gattc_handle_notify(p_data->notify.value,
+                                p_data->notify.value_len);
             break;
+        }
         
         // Response to writing to a characteristic descriptor. Ensure success.
         case ESP_GATTC_WRITE_DESCR_EVT:
             if (p_data->write.status != ESP_GATT_OK){
                 ESP_LOGE(GATTC_TAG, "write descr failed, error status = %x",
                          p_data->write.status);
-                break;
-            }
-            if (GATTC_DEBUG) {
+            } else if (GATTC_DEBUG) {
                 ESP_LOGI(GATTC_TAG, "write descr success");
             }
+            conn_setup_on_write(gattc_if, p_data->write.status,
+                                p_data->write.handle);
             break;
 
-        // Service change event. Log the remote device's address. Reload the
-        // services after the change. On Stadia controller, this occurs after
-        // the controller is initially conected and a button is pressed. This
-        // is the time to re-enable notifications.
+        // Service change event. Log the remote device's address. Drop the
+        // cached handles and reload the services after the change. On Stadia
+        // controller, this occurs after the controller is initially conected
+        // and a button is pressed. This is the time to re-enable
+        // notifications.
         case ESP_GATTC_SRVC_CHG_EVT: {
             esp_bd_addr_t bda;
             memcpy(bda, p_data->srvc_chg.remote_bda, sizeof(esp_bd_addr_t));
@@ -368,10 +259,7 @@ void gattc_profile_event_handler(esp_gattc_cb_event_t event,
                 ESP_LOGI(GATTC_TAG, "ESP_GATTC_SRVC_CHG_EVT, bd_addr:");
                 esp_log_buffer_hex(GATTC_TAG, bda, sizeof(esp_bd_addr_t));
             }
-            // Log all of the available services after change
-            esp_ble_gattc_search_service(gattc_if,
-                                         gl_profile_tab[PROFILE_A_APP_ID].conn_id,
-                                         &remote_filter_service_uuid);
+            conn_setup_on_service_change(gattc_if);
             break;
         }
 
@@ -387,12 +275,15 @@ void gattc_profile_event_handler(esp_gattc_cb_event_t event,
             }
             break;
 
-        // Disconnect event. Log the reason for the disconnection.
+        // Disconnect event. Log the reason for the disconnection and start
+        // reconnecting.
         case ESP_GATTC_DISCONNECT_EVT:
             ESP_LOGI(GATTC_TAG, "ESP_GATTC_DISCONNECT_EVT, reason = 0x%x",
                      p_data->disconnect.reason);
             connect = false;
-            get_service = false;
+            conn_setup_on_disconnect();
+            conn_params_on_disconnect();
+            reconnect_on_disconnect();
             break;
         default:
             break;
@@ -79,4 +79,16 @@ void gattc_profile_event_handler(esp_gattc_cb_event_t event,
                                  esp_gatt_if_t gattc_if,
                                  esp_ble_gattc_cb_param_t *param);
 
+/**
+ * @brief Handle a notification from the HID report characteristic.
+ * 
+ * Stamps the report, traces it if enabled, and passes it to the report queue.
+ * Called for every ESP_GATTC_NOTIFY_EVT, and by the report generator when
+ * synthetic reports are injected in place of the controller.
+ * 
+ * @param value The notification bytes.
+ * @param len The length of the notification.
+*/
+void gattc_handle_notify(const uint8_t* value, uint16_t len);
+
 #endif /* #ifndef _GATTC_H_ */
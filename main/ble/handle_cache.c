@@ -0,0 +1,79 @@
+/**
+ * @file    handle_cache.c
+ * @brief   Implementation of the GATT handle cache
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "ble/handle_cache.h"
+#include "globalconst.h"
+#include "nvs.h"
+#include "esp_log.h"
+#include <stdio.h>
+
+// Length of a key, the address in hex and a terminator
+#define HANDLE_CACHE_KEY_LEN 13
+
+/**
+ * @brief Make the NVS key of a controller from its address.
+ * 
+ * @param bda The controller's address.
+ * @param key Set to the key.
+*/
+static void make_key(const esp_bd_addr_t bda, char key[HANDLE_CACHE_KEY_LEN]) {
+    snprintf(key, HANDLE_CACHE_KEY_LEN, "%02x%02x%02x%02x%02x%02x", bda[0],
+             bda[1], bda[2], bda[3], bda[4], bda[5]);
+}
+
+bool handle_cache_load(const esp_bd_addr_t bda, HandleCache_t* handles) {
+    nvs_handle_t nvs;
+    if (nvs_open(HANDLE_CACHE_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        // Nothing was ever stored
+        return false;
+    }
+    char key[HANDLE_CACHE_KEY_LEN];
+    make_key(bda, key);
+    size_t len = sizeof(*handles);
+    esp_err_t ret = nvs_get_blob(nvs, key, handles, &len);
+    nvs_close(nvs);
+    // An entry of another layout, or with handles outside the service, is not
+    // used
+    return ret == ESP_OK && len == sizeof(*handles) &&
+           handles->service_start_handle <= handles->notify_char_handle &&
+           handles->notify_char_handle < handles->ccc_handle &&
+           handles->ccc_handle <= handles->service_end_handle;
+}
+
+void handle_cache_store(const esp_bd_addr_t bda, const HandleCache_t* handles) {
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(HANDLE_CACHE_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret != ESP_OK) {
+        ESP_LOGE(GATTC_TAG, "handle cache open failed, error code = %x", ret);
+        return;
+    }
+    char key[HANDLE_CACHE_KEY_LEN];
+    make_key(bda, key);
+    ret = nvs_set_blob(nvs, key, handles, sizeof(*handles));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(nvs);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(GATTC_TAG, "handle cache store failed, error code = %x", ret);
+    }
+    nvs_close(nvs);
+}
+
+void handle_cache_clear(const esp_bd_addr_t bda) {
+    nvs_handle_t nvs;
+    if (nvs_open(HANDLE_CACHE_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    char key[HANDLE_CACHE_KEY_LEN];
+    make_key(bda, key);
+    if (nvs_erase_key(nvs, key) == ESP_OK) {
+        nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+}
@@ -0,0 +1,63 @@
+/**
+ * @file    handle_cache.h
+ * @brief   Cache in NVS of the GATT handles of the controller's report.
+ * 
+ * Finding the report characteristic takes a service search and the lookups of
+ * the HID service's characteristics and of the report's descriptors on every
+ * connection. Once notifications have been enabled, the handles found are
+ * kept in NVS under the controller's address, and the next connection to the
+ * same controller enables notifications with them straight away, skipping the
+ * search. The GATT client drops the entry and searches again when the
+ * controller indicates a service change or a write with the cached handles
+ * fails.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef HANDLE_CACHE_H
+#define HANDLE_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_gap_ble_api.h"
+
+// NVS namespace the handles are kept in, one entry per controller address
+#define HANDLE_CACHE_NAMESPACE "gatt_handles"
+
+/**
+ * @brief The handles of one controller.
+*/
+typedef struct HandleCache {
+    uint16_t service_start_handle;  // First handle of the HID service.
+    uint16_t service_end_handle;    // Last handle of the HID service.
+    uint16_t notify_char_handle;    // Value handle of the report.
+    uint16_t ccc_handle;            // Client configuration of the report.
+} HandleCache_t;
+
+/**
+ * @brief Load the handles of a controller.
+ * 
+ * @param bda The controller's address.
+ * @param handles Set to the handles if they are cached.
+ * @return true if the handles were cached and are usable.
+*/
+bool handle_cache_load(const esp_bd_addr_t bda, HandleCache_t* handles);
+
+/**
+ * @brief Keep the handles of a controller, replacing any cached before.
+ * 
+ * @param bda The controller's address.
+ * @param handles The handles.
+*/
+void handle_cache_store(const esp_bd_addr_t bda, const HandleCache_t* handles);
+
+/**
+ * @brief Drop the handles of a controller.
+ * 
+ * @param bda The controller's address.
+*/
+void handle_cache_clear(const esp_bd_addr_t bda);
+
+#endif /* #ifndef HANDLE_CACHE_H */
@@ -0,0 +1,147 @@
+/**
+ * @file    rate_mon.c
+ * @brief   Method implementations for the report rate monitor
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "ble/rate_mon.h"
+#include "globalconst.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+// The statistics of the current connection
+static RateMon_t rateMon;
+
+// Guards rateMon, recorded in the Bluetooth task while the UART command task
+// reads and clears it
+static portMUX_TYPE rate_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void rate_mon_reset(uint32_t interval_us) {
+    taskENTER_CRITICAL(&rate_lock);
+    memset(&rateMon, 0, sizeof(rateMon));
+    rateMon.interval_us = interval_us;
+    taskEXIT_CRITICAL(&rate_lock);
+}
+
+void rate_mon_clear(void) {
+    taskENTER_CRITICAL(&rate_lock);
+    uint32_t interval_us = rateMon.interval_us;
+    memset(&rateMon, 0, sizeof(rateMon));
+    rateMon.interval_us = interval_us;
+    taskEXIT_CRITICAL(&rate_lock);
+}
+
+void rate_mon_set_interval(uint32_t interval_us) {
+    taskENTER_CRITICAL(&rate_lock);
+    rateMon.interval_us = interval_us;
+    taskEXIT_CRITICAL(&rate_lock);
+}
+
+/**
+ * @brief Record a report in the statistics. Called with rate_lock held.
+ * 
+ * @param rep The report, with stamp_us set to its arrival time.
+ * @return The time since the last report if it was a gap, 0 otherwise.
+*/
+static uint32_t record(const StadiaRep_t* rep) {
+    RateMon_t *mon = &rateMon;
+    uint32_t now = rep->stamp_us;
+    mon->reports++;
+    if (!mon->has_last) {
+        mon->window_start = now;
+        mon->window_count = 1;
+        mon->last_us = now;
+        mon->last = *rep;
+        mon->has_last = true;
+        return 0;
+    }
+
+    // Count reports per window. A window with no reports reads as 0 Hz.
+    uint32_t elapsed = now - mon->window_start;
+    if (elapsed >= RATE_MON_WINDOW_US) {
+        mon->rate_hz = elapsed < 2 * RATE_MON_WINDOW_US ? mon->window_count : 0;
+        mon->window_start = now;
+        mon->window_count = 0;
+    }
+    mon->window_count++;
+
+    // Running mean and jitter of the time between reports, in 1/16 us so the
+    // 1/16 weight of each new sample keeps its precision
+    uint32_t delta = now - mon->last_us;
+    if (mon->reports == 2) {
+        mon->mean_q4 = delta << 4;
+    } else {
+        int64_t dev = ((int64_t) delta << 4) - mon->mean_q4;
+        if (dev < 0) {
+            dev = -dev;
+        }
+        mon->jitter_q4 += ((uint32_t) dev >> 4) - (mon->jitter_q4 >> 4);
+        mon->mean_q4 += delta - (mon->mean_q4 >> 4);
+    }
+
+    // Gaps are measured against the connection interval once it is known,
+    // and against the mean time between reports until then
+    uint32_t unit = mon->interval_us ? mon->interval_us : mon->mean_q4 >> 4;
+    uint32_t gap_us = 0;
+    if (unit > 0 && delta > RATE_MON_GAP_INTERVALS * unit) {
+        mon->gaps++;
+        gap_us = delta;
+    }
+    if (delta > mon->max_gap_us) {
+        mon->max_gap_us = delta;
+    }
+
+    if (memcmp(&mon->last, rep, STADIA_REP_LEN) == 0) {
+        mon->duplicates++;
+    }
+    mon->last_us = now;
+    mon->last = *rep;
+    return gap_us;
+}
+
+void rate_mon_record(const StadiaRep_t* rep) {
+    taskENTER_CRITICAL(&rate_lock);
+    uint32_t gap_us = record(rep);
+    taskEXIT_CRITICAL(&rate_lock);
+    if (GATTC_DEBUG && gap_us != 0) {
+        ESP_LOGW(GATTC_TAG, "No report for %" PRIu32 " us", gap_us);
+    }
+}
+
+const RateMon_t *rate_mon_get(void) {
+    return &rateMon;
+}
+
+size_t str_of_rate_mon(char* buf, size_t len) {
+    // Formatted from a copy, so a report recorded meanwhile is not half in it
+    taskENTER_CRITICAL(&rate_lock);
+    RateMon_t copy = rateMon;
+    taskEXIT_CRITICAL(&rate_lock);
+    const RateMon_t *mon = &copy;
+    // The window only completes when a report arrives, so a silent link is
+    // detected from the time since the last report
+    uint32_t rate_hz = mon->rate_hz;
+    if (!mon->has_last ||
+        (uint32_t) rep_clock_us() - mon->window_start >= 2 * RATE_MON_WINDOW_US) {
+        rate_hz = 0;
+    }
+    int n = snprintf(buf, len, "RAT;%lu;%lu;%lu;%lu;%lu;%lu;%lu;%lu\n",
+                     (unsigned long) rate_hz,
+                     (unsigned long) (mon->mean_q4 >> 4),
+                     (unsigned long) (mon->jitter_q4 >> 4),
+                     (unsigned long) mon->reports,
+                     (unsigned long) mon->duplicates,
+                     (unsigned long) mon->gaps,
+                     (unsigned long) mon->max_gap_us,
+                     (unsigned long) mon->interval_us);
+    if (n < 0) {
+        return 0;
+    }
+    return (size_t) n < len ? (size_t) n : len - 1;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file    rate_mon.h
+ * @brief   Monitor of the rate and regularity of the reports the controller
+ *          sends over the current connection.
+ * 
+ * Every notification received is recorded with its arrival time. The monitor
+ * keeps, in constant memory, the number of reports in the last full second,
+ * a running mean of the time between reports and the jitter around it (both
+ * exponentially weighted over about 16 reports, as RTP does in RFC 3550), the
+ * share of reports identical to the one before, and the number of gaps longer
+ * than RATE_MON_GAP_INTERVALS connection intervals.
+ * 
+ * The statistics are recorded from the Bluetooth task and may be read from any
+ * other task. A reader may see a report counted in one field and not yet in
+ * another, which is harmless for monitoring.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef RATE_MON_H
+#define RATE_MON_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "publish/rep_queue.h"
+
+// Length of the window reports per second are counted over
+#define RATE_MON_WINDOW_US 1000000
+
+/**
+ * @brief The statistics of the current connection.
+*/
+typedef struct RateMon {
+    uint32_t interval_us;   // Connection interval, 0 until it is known.
+    uint32_t reports;       // Reports received.
+    uint32_t duplicates;    // Reports identical to the one before.
+    uint32_t gaps;          // Times between reports longer than the limit.
+    uint32_t max_gap_us;    // Longest time between two reports.
+    uint32_t rate_hz;       // Reports in the last full window.
+    uint32_t mean_q4;       // Mean time between reports, in 1/16 us.
+    uint32_t jitter_q4;     // Mean deviation from mean_q4, in 1/16 us.
+    uint32_t window_start;  // Arrival time starting the current window.
+    uint32_t window_count;  // Reports in the current window.
+    uint32_t last_us;       // Arrival time of the last report.
+    StadiaRep_t last;       // The last report, to detect duplicates.
+    bool has_last;          // Whether last_us and last are set.
+} RateMon_t;
+
+/**
+ * @brief Clear the statistics for a new connection.
+ * 
+ * @param interval_us The connection interval in microseconds, or 0 if it is
+ *                    not known yet.
+*/
+void rate_mon_reset(uint32_t interval_us);
+
+/**
+ * @brief Clear the statistics of the current connection, keeping its
+ *        connection interval.
+*/
+void rate_mon_clear(void);
+
+/**
+ * @brief Change the connection interval after a parameter update, keeping the
+ *        statistics.
+ * 
+ * @param interval_us The new connection interval in microseconds.
+*/
+void rate_mon_set_interval(uint32_t interval_us);
+
+/**
+ * @brief Record a report received from the controller.
+ * 
+ * Must be called from a single task, in order of arrival. The statistics may
+ * be summarized and cleared from another task meanwhile.
+ * 
+ * @param rep The report, with stamp_us set to its arrival time.
+*/
+void rate_mon_record(const StadiaRep_t* rep);
+
+/**
+ * @brief Get the statistics of the current connection.
+ * 
+ * @return The statistics, updated live as reports are recorded.
+*/
+const RateMon_t *rate_mon_get(void);
+
+/**
+ * @brief Write a summary of the statistics.
+ * 
+ * The summary is in the format
+ * "RAT;<HZ>;<MEAN>;<JITTER>;<REPORTS>;<DUPLICATES>;<GAPS>;<MAX GAP>;<INTERVAL>\n"
+ * with the times in microseconds. HZ is 0 once no report has arrived for a
+ * full window.
+ * 
+ * @param buf The buffer to write the NUL terminated summary into.
+ * @param len The size of buf.
+ * @return The length of the summary, not counting the NUL.
+*/
+size_t str_of_rate_mon(char* buf, size_t len);
+
+#endif /* #ifndef RATE_MON_H */
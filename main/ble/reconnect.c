@@ -0,0 +1,274 @@
+/**
+ * @file    reconnect.c
+ * @brief   Implementation of the reconnect manager
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "ble/reconnect.h"
+#include "ble/auth_gap.h"
+#include "ble/gattc.h"
+#include "publish/rep_queue.h"
+#include "globalconst.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <string.h>
+
+/**
+ * @brief The state of the reconnect manager.
+*/
+static struct {
+    ReconnectState_t state;         // What the manager is doing.
+    bool has_peer;                  // Whether a controller has paired.
+    esp_bd_addr_t bda;              // Address of the paired controller.
+    esp_ble_addr_type_t addr_type;  // Type of the address.
+    uint32_t failures;              // Failed direct connections since the
+                                    // disconnection.
+    bool measuring;                 // Waiting for the first report since the
+                                    // disconnection.
+    uint32_t lost_us;               // Time of the disconnection.
+    uint32_t backoff_ms;            // Backoff before the next attempt.
+    esp_timer_handle_t timer;       // The backoff timer.
+    ReconnectStats_t stats;         // The statistics.
+} recon;
+
+// Guards recon and the direct connections' use of connect against the
+// backoff timer, which runs in the esp_timer task while the callbacks run in
+// the Bluetooth task. The stack and the timer are called once it is released.
+static portMUX_TYPE recon_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief The calls into the stack or the timer a decision leaves to make.
+*/
+typedef enum ReconnectStep {
+    STEP_NONE,      // Nothing
+    STEP_SCAN,      // Start a scan
+    STEP_BACKOFF,   // Start the backoff timer
+    STEP_OPEN,      // Open a direct connection
+} ReconnectStep_t;
+
+/**
+ * @brief Begin a scan for the controller by name. The scan result handler in
+ *        auth_gap.c opens the connection once it is found. Called with
+ *        recon_lock held.
+ * 
+ * @return The step to take.
+*/
+static ReconnectStep_t begin_scan(void) {
+    recon.state = RECONNECT_SCAN;
+    recon.stats.scans++;
+    return STEP_SCAN;
+}
+
+/**
+ * @brief Begin a direct connection to the paired controller. Called with
+ *        recon_lock held.
+ * 
+ * @return The step to take.
+*/
+static ReconnectStep_t begin_direct(void) {
+    recon.state = RECONNECT_DIRECT;
+    recon.stats.attempts++;
+    connect = true;
+    return STEP_OPEN;
+}
+
+/**
+ * @brief Try again after a failed direct connection, or fall back to scanning.
+ *        Called with recon_lock held.
+ * 
+ * @return The step to take.
+*/
+static ReconnectStep_t retry(void) {
+    if (!recon.has_peer || recon.failures >= RECONNECT_DIRECT_TRIES) {
+        return begin_scan();
+    }
+    // Back off exponentially from the second attempt on
+    uint32_t backoff_ms = RECONNECT_BACKOFF_MS;
+    for (uint32_t i = 1; i < recon.failures &&
+         backoff_ms < RECONNECT_BACKOFF_MAX_MS; i++) {
+        backoff_ms *= 2;
+    }
+    if (backoff_ms > RECONNECT_BACKOFF_MAX_MS) {
+        backoff_ms = RECONNECT_BACKOFF_MAX_MS;
+    }
+    recon.state = RECONNECT_BACKOFF;
+    recon.backoff_ms = backoff_ms;
+    if (recon.timer == NULL) {
+        return begin_direct();
+    }
+    return STEP_BACKOFF;
+}
+
+/**
+ * @brief Make the calls a decision left to make, deciding again under the
+ *        lock whenever one fails. Called without recon_lock held.
+ * 
+ * @param step The step to take.
+*/
+static void take_step(ReconnectStep_t step) {
+    while (step != STEP_NONE) {
+        esp_err_t ret;
+        switch (step) {
+            case STEP_SCAN:
+                ret = esp_ble_gap_start_scanning(RECONNECT_SCAN_S);
+                if (ret) {
+                    ESP_LOGE(GATTC_TAG, "reconnect scan error, error code = %x",
+                             ret);
+                }
+                return;
+            case STEP_BACKOFF: {
+                taskENTER_CRITICAL(&recon_lock);
+                uint64_t backoff_us = (uint64_t) recon.backoff_ms * 1000;
+                taskEXIT_CRITICAL(&recon_lock);
+                if (!esp_timer_start_once(recon.timer, backoff_us)) {
+                    return;
+                }
+                // Without the timer, the retry is opened at once
+                taskENTER_CRITICAL(&recon_lock);
+                step = recon.state == RECONNECT_BACKOFF ? begin_direct()
+                                                        : STEP_NONE;
+                taskEXIT_CRITICAL(&recon_lock);
+                break;
+            }
+            case STEP_OPEN: {
+                esp_bd_addr_t bda;
+                taskENTER_CRITICAL(&recon_lock);
+                memcpy(bda, recon.bda, sizeof(esp_bd_addr_t));
+                esp_ble_addr_type_t addr_type = recon.addr_type;
+                taskEXIT_CRITICAL(&recon_lock);
+                esp_gatt_if_t gattc_if =
+                    gl_profile_tab[PROFILE_A_APP_ID].gattc_if;
+                ret = esp_ble_gattc_open(gattc_if, bda, addr_type, true);
+                if (!ret) {
+                    return;
+                }
+                ESP_LOGE(GATTC_TAG, "reconnect open error, error code = %x",
+                         ret);
+                taskENTER_CRITICAL(&recon_lock);
+                connect = false;
+                recon.failures++;
+                step = retry();
+                taskEXIT_CRITICAL(&recon_lock);
+                break;
+            }
+            default:
+                return;
+        }
+    }
+}
+
+/**
+ * @brief Backoff timer callback, opening the next direct connection.
+ * 
+ * @param arg Unused.
+*/
+static void reconnect_timer_cb(void* arg) {
+    ReconnectStep_t step = STEP_NONE;
+    taskENTER_CRITICAL(&recon_lock);
+    if (recon.state == RECONNECT_BACKOFF) {
+        step = begin_direct();
+    }
+    taskEXIT_CRITICAL(&recon_lock);
+    take_step(step);
+}
+
+void reconnect_init(void) {
+    const esp_timer_create_args_t timer_args = {
+        .callback = reconnect_timer_cb,
+        .name = "reconnect",
+    };
+    if (esp_timer_create(&timer_args, &recon.timer)) {
+        // Without the timer, retries are opened without a backoff
+        ESP_LOGE(GATTC_TAG, "reconnect timer create failed");
+        recon.timer = NULL;
+    }
+}
+
+void reconnect_set_peer(const esp_bd_addr_t bda,
+                        esp_ble_addr_type_t addr_type) {
+    taskENTER_CRITICAL(&recon_lock);
+    memcpy(recon.bda, bda, sizeof(esp_bd_addr_t));
+    recon.addr_type = addr_type;
+    recon.has_peer = true;
+    taskEXIT_CRITICAL(&recon_lock);
+}
+
+void reconnect_seed_peer(const esp_bd_addr_t bda,
+                         esp_ble_addr_type_t addr_type) {
+    taskENTER_CRITICAL(&recon_lock);
+    if (!recon.has_peer) {
+        memcpy(recon.bda, bda, sizeof(esp_bd_addr_t));
+        recon.addr_type = addr_type;
+        recon.has_peer = true;
+    }
+    taskEXIT_CRITICAL(&recon_lock);
+}
+
+void reconnect_on_disconnect(void) {
+    taskENTER_CRITICAL(&recon_lock);
+    if (!recon.measuring) {
+        // Measured from the first disconnection until reports flow again
+        recon.lost_us = (uint32_t) rep_clock_us();
+        recon.measuring = true;
+    }
+    recon.failures = 0;
+    ReconnectStep_t step = recon.has_peer ? begin_direct() : begin_scan();
+    taskEXIT_CRITICAL(&recon_lock);
+    take_step(step);
+}
+
+void reconnect_on_open(bool ok) {
+    ReconnectStep_t step = STEP_NONE;
+    taskENTER_CRITICAL(&recon_lock);
+    if (ok) {
+        recon.state = RECONNECT_IDLE;
+        recon.failures = 0;
+    } else {
+        connect = false;
+        if (recon.state == RECONNECT_DIRECT) {
+            recon.failures++;
+            step = retry();
+        } else {
+            // A connection to a controller found by scanning failed
+            step = begin_scan();
+        }
+    }
+    taskEXIT_CRITICAL(&recon_lock);
+    take_step(step);
+}
+
+void reconnect_on_scan_done(void) {
+    ReconnectStep_t step = STEP_NONE;
+    taskENTER_CRITICAL(&recon_lock);
+    if (!connect) {
+        step = begin_scan();
+    }
+    taskEXIT_CRITICAL(&recon_lock);
+    take_step(step);
+}
+
+void reconnect_on_report(uint32_t stamp_us) {
+    taskENTER_CRITICAL(&recon_lock);
+    if (!recon.measuring) {
+        taskEXIT_CRITICAL(&recon_lock);
+        return;
+    }
+    recon.measuring = false;
+    uint32_t ms = (stamp_us - recon.lost_us) / 1000;
+    recon.stats.reconnects++;
+    recon.stats.last_ms = ms;
+    if (ms > recon.stats.max_ms) {
+        recon.stats.max_ms = ms;
+    }
+    taskEXIT_CRITICAL(&recon_lock);
+    ESP_LOGI(GATTC_TAG, "reconnected, first report after %lu ms",
+             (unsigned long) ms);
+}
+
+const ReconnectStats_t *reconnect_get(void) {
+    return &recon.stats;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file    reconnect.h
+ * @brief   Reconnects to the controller after the connection is lost.
+ * 
+ * Once the controller has paired, its address is kept, and after a restart
+ * it is taken from the bond list. When the connection drops, a direct
+ * connection to that address is opened at once, skipping the scan and name
+ * matching. A direct connection stays pending until the controller
+ * advertises again, or until the stack gives up on it. Each failed attempt is
+ * retried after a backoff that starts at RECONNECT_BACKOFF_MS and doubles up
+ * to RECONNECT_BACKOFF_MAX_MS. After RECONNECT_DIRECT_TRIES failed attempts,
+ * or when no controller is bonded, the manager falls back to scanning for the
+ * controller by name. Scans that run out without finding it are restarted for
+ * as long as there is no connection.
+ * 
+ * The time from each disconnection to the first report received afterwards
+ * is measured and logged, and kept in the reconnection statistics.
+ * 
+ * The manager is driven from the GAP and GATT client callbacks, which run in
+ * the Bluetooth task, and from its backoff timer, which runs in the esp_timer
+ * task. Its state is only changed under a lock, and the stack and the timer
+ * are called once the lock is released.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef RECONNECT_H
+#define RECONNECT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_gap_ble_api.h"
+
+/**
+ * @brief What the reconnect manager is doing.
+*/
+typedef enum ReconnectState {
+    RECONNECT_IDLE,     // Connected, or not yet connected for the first time
+    RECONNECT_DIRECT,   // A direct connection to the controller is pending
+    RECONNECT_BACKOFF,  // Waiting before the next direct connection
+    RECONNECT_SCAN,     // Scanning for the controller by name
+} ReconnectState_t;
+
+/**
+ * @brief The reconnection statistics.
+*/
+typedef struct ReconnectStats {
+    uint32_t reconnects;    // Disconnections followed by a report.
+    uint32_t last_ms;       // Time to the first report, last reconnection.
+    uint32_t max_ms;        // Longest time to the first report.
+    uint32_t attempts;      // Direct connections opened.
+    uint32_t scans;         // Scans started to find the controller again.
+} ReconnectStats_t;
+
+/**
+ * @brief Create the backoff timer. Must be called before the first connection.
+*/
+void reconnect_init(void);
+
+/**
+ * @brief Keep the address of the paired controller to reconnect to.
+ * 
+ * @param bda The controller's address.
+ * @param addr_type The type of the address.
+*/
+void reconnect_set_peer(const esp_bd_addr_t bda,
+                        esp_ble_addr_type_t addr_type);
+
+/**
+ * @brief Keep the address of a controller bonded before boot, unless one has
+ *        paired since.
+ * 
+ * @param bda The controller's identity address, from the bond list.
+ * @param addr_type The type of the address.
+*/
+void reconnect_seed_peer(const esp_bd_addr_t bda,
+                         esp_ble_addr_type_t addr_type);
+
+/**
+ * @brief Start reconnecting after the connection dropped.
+*/
+void reconnect_on_disconnect(void);
+
+/**
+ * @brief Handle the outcome of opening a connection, direct or after a scan.
+ * 
+ * @param ok True if the connection opened.
+*/
+void reconnect_on_open(bool ok);
+
+/**
+ * @brief Handle a scan running out, restarting it while not connected.
+*/
+void reconnect_on_scan_done(void);
+
+/**
+ * @brief Note a report received, ending the measurement of a reconnection.
+ * 
+ * @param stamp_us The arrival time of the report, from rep_clock_us.
+*/
+void reconnect_on_report(uint32_t stamp_us);
+
+/**
+ * @brief Get the reconnection statistics.
+ * 
+ * @return The statistics, updated live.
+*/
+const ReconnectStats_t *reconnect_get(void);
+
+#endif /* #ifndef RECONNECT_H */
@@ -15,6 +15,21 @@
 // The UART port to output notifications on
 const uart_port_t uart_num = UART_NUM_0;
 
+// The encoding used for controller output
+OutputFormat_t output_format = OUTPUT_ASCII;
+
+// When controller output is sent
+OutputMode_t output_mode = OUTPUT_PUSH;
+
+// Number every output frame so the reader can detect lost frames
+bool output_sequence = false;
+
+// The timestamp added to each output frame
+OutputStamp_t output_stamp = STAMP_NONE;
+
+// Whether raw notifications are traced to the output
+OutputTrace_t output_trace = TRACE_OFF;
+
 // One entry for each control on the controller indicating whether or not to
 // publish notifications for the control state
 bool publish_controls[20] = {
@@ -39,3 +54,78 @@ bool publish_controls[20] = {
     true,   // LTR
     true    // RTR
 };
+
+// Deadzone of each control in raw counts. Sticks at rest wander by a count or
+// two around center, so a small radial deadzone keeps them quiet.
+uint8_t control_deadzone[20] = {
+    0,      // DPD
+    0,      // RSB
+    0,      // OPT
+    0,      // MEN
+    0,      // STB
+    0,      // RTB
+    0,      // LTB
+    0,      // GAS
+    0,      // CPT
+    0,      // LAB
+    0,      // LBB
+    0,      // LXB
+    0,      // LYB
+    0,      // LBP
+    0,      // RBP
+    0,      // LSB
+    4,      // LJS
+    4,      // RJS
+    2,      // LTR
+    2       // RTR
+};
+
+// Smallest change in raw counts before a new stick or trigger position is
+// published
+uint8_t control_min_delta[20] = {
+    0,      // DPD
+    0,      // RSB
+    0,      // OPT
+    0,      // MEN
+    0,      // STB
+    0,      // RTB
+    0,      // LTB
+    0,      // GAS
+    0,      // CPT
+    0,      // LAB
+    0,      // LBB
+    0,      // LXB
+    0,      // LYB
+    0,      // LBP
+    0,      // RBP
+    0,      // LSB
+    2,      // LJS
+    2,      // RJS
+    1,      // LTR
+    1       // RTR
+};
+
+// Most times per second a stick or trigger is published. 0 publishes every
+// change.
+uint16_t control_max_rate_hz[20] = {
+    0,      // DPD
+    0,      // RSB
+    0,      // OPT
+    0,      // MEN
+    0,      // STB
+    0,      // RTB
+    0,      // LTB
+    0,      // GAS
+    0,      // CPT
+    0,      // LAB
+    0,      // LBB
+    0,      // LXB
+    0,      // LYB
+    0,      // LBP
+    0,      // RBP
+    0,      // LSB
+    0,      // LJS
+    0,      // RJS
+    0,      // LTR
+    0       // RTR
+};
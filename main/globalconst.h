@@ -18,9 +18,75 @@
 // publish notifications for the control state
 extern bool publish_controls[20];
 
+// Deadzone of each control in raw counts, indexed like publish_controls. A
+// stick closer than this to its center reads as centered, a trigger at or
+// below this reads as released. Ignored for buttons and the D-pad.
+extern uint8_t control_deadzone[20];
+
+// Smallest change in raw counts on any axis before a new stick or trigger
+// position is published, indexed like publish_controls. Returning to rest or
+// reaching either end of travel is always published. Ignored for buttons and
+// the D-pad.
+extern uint8_t control_min_delta[20];
+
+// Most times per second a stick or trigger is published, indexed like
+// publish_controls. Changes arriving faster are held, and the latest value is
+// published once the interval has passed. 0 publishes every change. Ignored
+// for buttons and the D-pad, which are always published immediately.
+extern uint16_t control_max_rate_hz[20];
+
 // The UART port to output notifications on
 extern const uart_port_t uart_num;
 
+/**
+ * @brief The encodings available for controller output.
+*/
+typedef enum OutputFormat {
+    OUTPUT_ASCII,  // One "<ID>;<Value>\n" line per changed control
+    OUTPUT_BINARY  // One COBS framed binary frame per report, see bin_proto.h
+} OutputFormat_t;
+
+// The encoding used for controller output
+extern OutputFormat_t output_format;
+
+/**
+ * @brief When controller output is sent.
+*/
+typedef enum OutputMode {
+    OUTPUT_PUSH,  // Every change is published as it happens
+    OUTPUT_POLL   // Nothing is sent until a snapshot is requested, see uart_cmd.h
+} OutputMode_t;
+
+// When controller output is sent
+extern OutputMode_t output_mode;
+
+// Number every output frame so the reader can detect lost frames
+extern bool output_sequence;
+
+/**
+ * @brief The timestamp added to each output frame.
+*/
+typedef enum OutputStamp {
+    STAMP_NONE,     // No timestamp
+    STAMP_INGRESS,  // When the newest report in the frame arrived, in us
+    STAMP_LATENCY   // Microseconds from that report arriving to the UART write
+} OutputStamp_t;
+
+// The timestamp added to each output frame
+extern OutputStamp_t output_stamp;
+
+/**
+ * @brief Whether raw notifications are traced to the output, see trace_fmt.h.
+*/
+typedef enum OutputTrace {
+    TRACE_OFF,   // Only the controller output is sent
+    TRACE_ALSO,  // Every notification is traced next to the controller output
+    TRACE_ONLY   // Every notification is traced instead of the controller output
+} OutputTrace_t;
+
+// Whether raw notifications are traced to the output
+extern OutputTrace_t output_trace;
+
 // Tag for the GATT client. Used for logging globally, not just within gatt
 // client files.
 #define GATTC_TAG "STADIA_CON_CLIENT"
@@ -34,4 +100,95 @@ extern const uart_port_t uart_num;
 // Toggle debug logging for UART output
 #define UART_DEBUG false
 
+// Number of incoming reports that may be pending at once. Must be a power of
+// two no larger than REP_QUEUE_MAX_CAPACITY.
+#define REP_QUEUE_LEN 64
+
+// What to do with a new report when the report queue is full. One of
+// REP_QUEUE_DROP_OLDEST, REP_QUEUE_DROP_NEWEST or REP_QUEUE_BLOCK.
+#define REP_QUEUE_POLICY REP_QUEUE_DROP_OLDEST
+
+// How long the Bluetooth callback may wait for room under REP_QUEUE_BLOCK
+#define REP_QUEUE_BLOCK_MS 5
+
+// Merge waiting reports when publishing falls behind. Stick and trigger values
+// keep only their latest position while every button and D-pad edge is kept.
+#define REP_QUEUE_CONFLATE false
+
+// Rate in Hz of the snapshot timer. When non zero, stick and trigger changes
+// are only published on each tick of the timer, while buttons and the D-pad
+// still publish immediately. 0 publishes every change as it arrives.
+#define SNAPSHOT_RATE_HZ 0
+
+// Publish only the sticks and triggers that changed since the previous
+// snapshot, rather than every published control on every tick
+#define SNAPSHOT_CHANGED_ONLY true
+
+// Interval in milliseconds between keyframes, snapshots of every published
+// control sent in push mode so a reader can resynchronize after lost frames or
+// when it starts reading mid-stream. 0 disables keyframes.
+#define KEYFRAME_INTERVAL_MS 0
+
+// Set to 1 to time every stage of the report pipeline into the latency
+// histograms of lat_hist.h. When 0 the instrumentation compiles to nothing.
+#define LAT_HIST_ENABLED 0
+
+// Gaps between reports longer than this many connection intervals are counted
+// by the report rate monitor, see ble/rate_mon.h
+#define RATE_MON_GAP_INTERVALS 4
+
+// Discovery of the controller, see ble/discover.h. Without a bond, a device
+// matches if its advertised name starts with DISCOVER_NAME_PREFIX ("Stadia"
+// matches every Stadia controller) or, if DISCOVER_MATCH_APPEARANCE is true, if
+// it advertises the gamepad or joystick appearance. With DISCOVER_WHITELIST
+// true, scans only report bonded devices once one has bonded.
+#define DISCOVER_NAME_PREFIX remote_device_name
+#define DISCOVER_MATCH_APPEARANCE false
+#define DISCOVER_WHITELIST true
+
+// Set to 1 to keep the GATT handles of the controller's report in NVS once
+// found, so later connections to it enable notifications without a service
+// search, see ble/handle_cache.h
+#define HANDLE_CACHE_ENABLED 1
+
+// Reconnecting after a disconnection, see ble/reconnect.h. Direct connections
+// to the bonded controller are tried RECONNECT_DIRECT_TRIES times, waiting
+// RECONNECT_BACKOFF_MS after the first failure and twice as long after each
+// further one, up to RECONNECT_BACKOFF_MAX_MS, before scanning for it by name
+// in scans of RECONNECT_SCAN_S seconds.
+#define RECONNECT_DIRECT_TRIES 3
+#define RECONNECT_BACKOFF_MS 100
+#define RECONNECT_BACKOFF_MAX_MS 2000
+#define RECONNECT_SCAN_S 30
+
+// Setting up a connection, see ble/conn_setup.h. A service search or
+// subscription not answered within CONN_SETUP_TIMEOUT_MS is retried up to
+// CONN_SETUP_RETRIES times before the connection is closed.
+#define CONN_SETUP_TIMEOUT_MS 1500
+#define CONN_SETUP_RETRIES 2
+
+// Connection parameters, see ble/conn_params.h. While the pad is in use the
+// shortest interval the controller accepts is asked for, from
+// CONN_PARAMS_FAST_INTERVAL up. After CONN_PARAMS_IDLE_MS without input the
+// link relaxes to CONN_PARAMS_IDLE_INTERVAL with a slave latency of
+// CONN_PARAMS_IDLE_LATENCY events. Intervals are in units of 1.25 ms and the
+// supervision timeout CONN_PARAMS_TIMEOUT in units of 10 ms. Sticks and
+// triggers moving by no more than CONN_PARAMS_AXIS_DELTA counts are not
+// input. Set CONN_PARAMS_ENABLED to 0 to keep the controller's parameters.
+#define CONN_PARAMS_ENABLED 1
+#define CONN_PARAMS_FAST_INTERVAL 6
+#define CONN_PARAMS_IDLE_INTERVAL 24
+#define CONN_PARAMS_IDLE_LATENCY 4
+#define CONN_PARAMS_IDLE_MS 5000
+#define CONN_PARAMS_TIMEOUT 400
+#define CONN_PARAMS_AXIS_DELTA 2
+
+// Set to 1 to feed synthetic reports from the report generator (see
+// publish/rep_gen.h) into the pipeline in place of a controller. Bluetooth is
+// not started. Reports are generated every REP_GEN_INTERVAL_US microseconds
+// from the seed REP_GEN_SEED, with the generator's default scenario mix.
+#define REP_GEN_INJECT 0
+#define REP_GEN_INTERVAL_US 10000
+#define REP_GEN_SEED 1
+
 #endif /* #ifndef _GLOBALCONST_H_ */
@@ -6,24 +6,37 @@
 
 #include "ble/bt_init.h"
 #include "ble/auth_gap.h"
+#include "ble/reconnect.h"
+#include "ble/conn_setup.h"
+#include "ble/conn_params.h"
 #include "publish/rep_queue.h"
 #include "publish/con_state.h"
+#include "publish/uart_cmd.h"
+#include "publish/lat_hist.h"
+#include "publish/rep_gen.h"
+#include "ble/gattc.h"
 #include "globalconst.h"
 
-#include "freertos/freeRTOS.h"
-#include "freertos/semphr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "driver/uart.h"
+#include "esp_timer.h"
 
 // The incoming bluetooth report queue
 RepQueue_t *repQueue;
 
-// A counting semaphore used to notify the main thread that a new report is
-// available in the queue
-SemaphoreHandle_t repSem;
-
 // The controller state
 ConState_t state;
 
+// The most reports drained from the queue and published as one batch
+#define REP_BATCH_LEN 16
+
+// Notification bit set by the snapshot timer on every tick
+#define SNAPSHOT_NOTIFY_BIT (1u << 1)
+
+// Notification bit set by the keyframe timer on every tick
+#define KEYFRAME_NOTIFY_BIT (1u << 3)
+
 // The UART communication parameters
 uart_config_t uart_config = {
     .baud_rate = 115200,
@@ -34,15 +47,94 @@ uart_config_t uart_config = {
     .rx_flow_ctrl_thresh = 122,
 };
 
+#if SNAPSHOT_RATE_HZ > 0
+/**
+ * @brief Snapshot timer callback, wakes the publishing task for a snapshot.
+ * 
+ * @param arg The handle of the publishing task.
+*/
+static void snapshot_tick(void *arg) {
+    xTaskNotify((TaskHandle_t) arg, SNAPSHOT_NOTIFY_BIT, eSetBits);
+}
+#endif
+
+#if KEYFRAME_INTERVAL_MS > 0
+/**
+ * @brief Keyframe timer callback, wakes the publishing task for a keyframe.
+ * 
+ * @param arg The handle of the publishing task.
+*/
+static void keyframe_tick(void *arg) {
+    xTaskNotify((TaskHandle_t) arg, KEYFRAME_NOTIFY_BIT, eSetBits);
+}
+#endif
+
+#if REP_GEN_INJECT
+// Stack size and priority of the report generator task
+#define REP_GEN_STACK_SIZE 3072
+#define REP_GEN_PRIORITY   2
+
+/**
+ * @brief Report generator timer callback, wakes the generator task.
+ * 
+ * @param arg The handle of the generator task.
+*/
+static void rep_gen_tick(void *arg) {
+    xTaskNotifyGive((TaskHandle_t) arg);
+}
+
+/**
+ * @brief Task feeding synthetic reports into the pipeline through the same
+ *        path as controller notifications, one per timer tick.
+ * 
+ * @param arg Unused.
+*/
+static void rep_gen_task(void *arg) {
+    RepGenCfg_t cfg;
+    rep_gen_default_cfg(&cfg, REP_GEN_SEED);
+    cfg.interval_us = REP_GEN_INTERVAL_US;
+    static RepGen_t gen;
+    rep_gen_init(&gen, &cfg);
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        StadiaRep_t rep;
+        uint8_t raw[STADIA_REP_LEN];
+        rep_gen_next(&gen, &rep);
+        rep_gen_raw(&rep, raw);
+        gattc_handle_notify(raw, sizeof(raw));
+    }
+}
+#endif
+
 void app_main(void) {
     // Initialize the NVS storage for the Bluetooth controller
     bt_nvs_init();
-    // Initialize the Stadia Report Queue
-    repQueue = create_stadia_rep_queue();
+    // Initialize the Stadia Report Queue. This task is the consumer and is
+    // notified directly whenever a report is inserted.
+    repQueue = create_stadia_rep_queue(xTaskGetCurrentTaskHandle(),
+                                       REP_QUEUE_LEN, REP_QUEUE_POLICY,
+                                       pdMS_TO_TICKS(REP_QUEUE_BLOCK_MS));
+    if (repQueue == NULL) {
+        ESP_LOGE(GATTC_TAG, "invalid report queue configuration");
+        return;
+    }
+    set_rep_queue_conflation(repQueue, REP_QUEUE_CONFLATE);
     // Initialize the controller state
     init_controller(&state);
-    // Create the counting semaphore
-    repSem = xSemaphoreCreateCounting(INT8_MAX, 0);
+#if REP_GEN_INJECT
+    // Generate reports in place of the controller
+    TaskHandle_t gen_task;
+    xTaskCreate(rep_gen_task, "rep_gen", REP_GEN_STACK_SIZE, NULL,
+                REP_GEN_PRIORITY, &gen_task);
+    const esp_timer_create_args_t gen_timer_args = {
+        .callback = rep_gen_tick,
+        .arg = gen_task,
+        .name = "rep_gen",
+    };
+    esp_timer_handle_t gen_timer;
+    ESP_ERROR_CHECK(esp_timer_create(&gen_timer_args, &gen_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(gen_timer, REP_GEN_INTERVAL_US));
+#else
     // Initialize the Bluetooth controller
     bt_controller_init();
     // Initialize the Bluetooth stack
@@ -55,6 +147,13 @@ void app_main(void) {
     gattc_profile_init();
     // Initialize the security and authentication parameters
     esp_auth_init();
+    // Reconnect to the controller whenever the connection drops
+    reconnect_init();
+    // Time out and retry the steps of setting up each connection
+    conn_setup_init();
+    // Tighten the connection interval while the pad is in use
+    conn_params_init();
+#endif
     // Configure UART parameters
     ESP_ERROR_CHECK(uart_param_config(uart_num, &uart_config));
     // Setup UART buffered IO with event queue
@@ -63,15 +162,71 @@ void app_main(void) {
     // Install UART driver using an event queue here
     ESP_ERROR_CHECK(uart_driver_install(uart_num, uart_buffer_size, \
                                             uart_buffer_size, 10, &uart_queue, 0));
+    // Listen for commands from the device reading the output
+    uart_cmd_init(uart_queue, xTaskGetCurrentTaskHandle());
+#if SNAPSHOT_RATE_HZ > 0
+    // Start the snapshot timer. Ticks the task could not keep up with are
+    // skipped rather than bunched up.
+    const esp_timer_create_args_t snapshot_timer_args = {
+        .callback = snapshot_tick,
+        .arg = xTaskGetCurrentTaskHandle(),
+        .name = "snapshot",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_handle_t snapshot_timer;
+    ESP_ERROR_CHECK(esp_timer_create(&snapshot_timer_args, &snapshot_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(snapshot_timer,
+                                             1000000 / SNAPSHOT_RATE_HZ));
+#endif
+#if KEYFRAME_INTERVAL_MS > 0
+    // Start the keyframe timer
+    const esp_timer_create_args_t keyframe_timer_args = {
+        .callback = keyframe_tick,
+        .arg = xTaskGetCurrentTaskHandle(),
+        .name = "keyframe",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_handle_t keyframe_timer;
+    ESP_ERROR_CHECK(esp_timer_create(&keyframe_timer_args, &keyframe_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(keyframe_timer,
+                                             KEYFRAME_INTERVAL_MS * 1000));
+#endif
     // Start updating the controller state with incoming reports
+    StadiaRep_t batch[REP_BATCH_LEN];
+    TickType_t wait = portMAX_DELAY;
     while (1) {
-        // Wait for a new report to be available
-        xSemaphoreTake(repSem, portMAX_DELAY);
-        // Dequeue the report from the queue
-        StadiaRep_t *rep = dequeue_stadia_rep(repQueue);
-        // Update the controller state with the new report
-        update_controller(&state, rep);
-        // Free the report
-        free(rep);
+        // Wait for a new report, a snapshot or keyframe tick, a snapshot
+        // request, or a held control to be due
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, REP_QUEUE_NOTIFY_BIT | SNAPSHOT_NOTIFY_BIT |
+                        POLL_NOTIFY_BIT | KEYFRAME_NOTIFY_BIT, &bits, wait);
+        // Notifications collapse, so drain every report pending in the queue
+        size_t count;
+        while ((count = dequeue_stadia_rep_batch(repQueue, batch,
+                                                 REP_BATCH_LEN)) > 0) {
+#if LAT_HIST_ENABLED
+            // Time each report spent between arriving and leaving the queue
+            uint32_t now_us = (uint32_t) rep_clock_us();
+            for (size_t i = 0; i < count; i++) {
+                LAT_HIST_RECORD_US(LAT_QUEUE, now_us - batch[i].stamp_us);
+            }
+#endif
+            // Update the controller state with the new reports
+            update_controller_batch(&state, batch, count);
+        }
+        if ((bits & SNAPSHOT_NOTIFY_BIT) && output_mode == OUTPUT_PUSH) {
+            publish_snapshot(&state, SNAPSHOT_CHANGED_ONLY);
+        }
+        // Answer a snapshot request with the state after every report so far.
+        // Keyframes are the same snapshot, sent unprompted in push mode.
+        if ((bits & POLL_NOTIFY_BIT) ||
+            ((bits & KEYFRAME_NOTIFY_BIT) && output_mode == OUTPUT_PUSH)) {
+            publish_snapshot(&state, false);
+        }
+        // Publish the final value of rate limited controls once their interval
+        // has passed, and wake up again when the next one is due
+        int64_t next_us = publish_held_controls(&state);
+        wait = next_us < 0 ? portMAX_DELAY
+                           : pdMS_TO_TICKS(next_us / 1000) + 1;
     }
 }
\ No newline at end of file
@@ -0,0 +1,63 @@
+/**
+ * @file    bin_proto.c
+ * @brief   Checksum and framing helpers for the compact binary output protocol.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "bin_proto.h"
+
+uint16_t crc16_ccitt(const uint8_t* data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t) data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+size_t cobs_encode(const uint8_t* src, size_t len, uint8_t* dst) {
+    // Each code byte holds the distance to the next zero in the input
+    size_t code_pos = 0;
+    size_t out = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < len; i++) {
+        if (src[i] == 0) {
+            dst[code_pos] = code;
+            code_pos = out++;
+            code = 1;
+        } else {
+            dst[out++] = src[i];
+            code++;
+        }
+    }
+    dst[code_pos] = code;
+    dst[out++] = 0x00;
+    return out;
+}
+
+size_t cobs_decode(const uint8_t* src, size_t len, uint8_t* dst) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in < len) {
+        uint8_t code = src[in++];
+        if (code == 0 || in + code - 1 > len) {
+            return 0;
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            if (src[in] == 0) {
+                return 0;
+            }
+            dst[out++] = src[in++];
+        }
+        // A code below 0xFF stands for a zero, except at the very end
+        if (code < 0xFF && in < len) {
+            dst[out++] = 0x00;
+        }
+    }
+    return out;
+}
@@ -0,0 +1,149 @@
+/**
+ * @file    bin_proto.h
+ * @brief   Definitions for the compact binary output protocol.
+ * 
+ * As an alternative to the ASCII line format, controller changes can be output
+ * as binary frames. Each frame is built as:
+ *  - 1 byte frame type. If the BIN_FRAME_SEQ bit is set, it is followed by
+ *    a 1 byte sequence number, counting up by one per frame and wrapping
+ *    from 255 to 0.
+ *  - if the BIN_FRAME_STAMP or BIN_FRAME_LATENCY bit is set in the type, 4
+ *    bytes little endian of either the time the newest report in the frame
+ *    arrived, or the time from its arrival to the frame being written, in
+ *    microseconds.
+ *  - 3 bytes little endian bitmask of the controls in the frame, bit i being
+ *    the control at index i of publish_controls
+ *  - the raw 8 bit value of every control in the mask, in index order. The
+ *    D-pad is its direction (0-7 clockwise from N, 8 for none), buttons are
+ *    0 or 1, joysticks are two bytes x then y straight from the report (128 is
+ *    center, y grows downwards) and triggers are one byte (0-255).
+ *  - 2 bytes little endian CRC-16/CCITT-FALSE of everything above
+ * The frame is then COBS encoded and terminated with a 0x00 byte, so a reader
+ * can always resynchronize on the next 0x00.
+ * 
+ * Snapshot frames have the same layout as delta frames, but carry every
+ * published control rather than only the ones that changed. They are sent on
+ * request and periodically as keyframes, so a reader that lost frames or
+ * started reading mid-stream can recover the full state.
+ * 
+ * Answers to commands received on the UART port (see uart_cmd.h) use the same
+ * layout with an ACK or NAK frame type. Their bitmask is the set of published
+ * controls after the command, and they carry no values.
+ * 
+ * Trace frames (see trace_fmt.h) carry one raw notification instead: the frame
+ * type, with none of the flag bits, the TRACE_REC_LEN bytes of the record and
+ * the CRC. They have no mask and do not take a sequence number.
+ * 
+ * This file is shared with the host side decoder library.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef BIN_PROTO_H
+#define BIN_PROTO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Index of each control, as used by publish_controls and the binary
+ *        frame bitmask.
+*/
+typedef enum ConIdx {
+    CON_DPD,    // D-pad
+    CON_RSB,    // Right stick button
+    CON_OPT,    // Option button
+    CON_MEN,    // Menu button
+    CON_STB,    // Stadia button
+    CON_RTB,    // Right digital trigger
+    CON_LTB,    // Left digital trigger
+    CON_GAS,    // Google Assistant button
+    CON_CPT,    // Capture button
+    CON_LAB,    // A button
+    CON_LBB,    // B button
+    CON_LXB,    // X button
+    CON_LYB,    // Y button
+    CON_LBP,    // Left bumper
+    CON_RBP,    // Right bumper
+    CON_LSB,    // Left stick button
+    CON_LJS,    // Left joystick
+    CON_RJS,    // Right joystick
+    CON_LTR,    // Left trigger
+    CON_RTR,    // Right trigger
+    CON_NUM_CONTROLS
+} ConIdx_t;
+
+// Frame types
+#define BIN_FRAME_DELTA 0x01 // The controls that changed in one report
+#define BIN_FRAME_ACK   0x02 // A command was applied
+#define BIN_FRAME_NAK   0x03 // A command was rejected
+#define BIN_FRAME_SNAPSHOT 0x04 // Every published control, e.g. when polled
+#define BIN_FRAME_TRACE 0x05 // One raw notification, see trace_fmt.h
+
+// Set in the frame type when a sequence number follows it
+#define BIN_FRAME_SEQ 0x80
+
+// Set in the frame type when an arrival time or a latency follows it
+#define BIN_FRAME_STAMP   0x40
+#define BIN_FRAME_LATENCY 0x20
+
+// The frame type without the flags above
+#define BIN_FRAME_TYPE_MASK 0x1F
+
+// Size of the timestamp in a frame
+#define BIN_STAMP_LEN 4
+
+// Size of the control bitmask and of the CRC in a frame
+#define BIN_MASK_LEN 3
+#define BIN_CRC_LEN  2
+
+// Largest frame before encoding: type, sequence, timestamp, mask, every
+// control, CRC
+#define BIN_FRAME_MAX_LEN (2 + BIN_STAMP_LEN + BIN_MASK_LEN + CON_NUM_CONTROLS + \
+                           2 + BIN_CRC_LEN)
+
+// Largest frame after COBS encoding, including the 0x00 delimiter
+#define BIN_ENCODED_MAX_LEN (BIN_FRAME_MAX_LEN + BIN_FRAME_MAX_LEN / 254 + 2)
+
+/**
+ * @brief The number of value bytes a control takes in a frame.
+ * 
+ * @param idx The index of the control.
+ * @return 2 for joysticks, 1 for every other control.
+*/
+static inline size_t bin_value_len(uint8_t idx) {
+    return (idx == CON_LJS || idx == CON_RJS) ? 2 : 1;
+}
+
+/**
+ * @brief Compute the CRC-16/CCITT-FALSE of a buffer.
+ * 
+ * @param data The bytes to checksum.
+ * @param len The number of bytes in data.
+ * @return The CRC of the buffer.
+*/
+uint16_t crc16_ccitt(const uint8_t* data, size_t len);
+
+/**
+ * @brief COBS encode a buffer and append the 0x00 frame delimiter.
+ * 
+ * @param src The bytes to encode.
+ * @param len The number of bytes in src, at most 254.
+ * @param dst The buffer to write into, at least len + 2 bytes.
+ * @return The number of bytes written to dst, including the delimiter.
+*/
+size_t cobs_encode(const uint8_t* src, size_t len, uint8_t* dst);
+
+/**
+ * @brief Decode a COBS encoded frame.
+ * 
+ * @param src The encoded bytes, without the 0x00 delimiter.
+ * @param len The number of bytes in src.
+ * @param dst The buffer to write into, at least len bytes.
+ * @return The number of bytes written to dst, or 0 if src is malformed.
+*/
+size_t cobs_decode(const uint8_t* src, size_t len, uint8_t* dst);
+
+#endif /* #ifndef BIN_PROTO_H */
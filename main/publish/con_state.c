@@ -8,10 +8,12 @@
 */
 
 #include "con_state.h"
+#include "pct_table.h"
+#include "lat_hist.h"
+#include "trace_fmt.h"
 #include "driver/uart.h"
 #include "globalconst.h"
 #include "rom/ets_sys.h"
-#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <stdint.h>
@@ -19,90 +21,59 @@
 #include <stdbool.h>
 
 /**
- * @brief Convert a uint8_t value to a signed percentage for a joystick
+ * @brief Copy a control identifier and the following separator into a buffer.
  * 
- * This function takes a uint8_t value and converts it to a signed percentage
- * value. The input value is assumed to be in the range of 0 to 255, with 128
- * representing 0%. The output value is in the range of -100% to 100%.
- * 
- * @param val The uint8_t value to convert to a percentage.
- * @return The signed percentage value.
+ * @param id The 3 letter identifier of the control.
+ * @param buf The buffer to write into.
+ * @return The number of characters written.
 */
-float sign_pct(uint8_t val);
+static inline size_t put_id(const char* id, char* buf) {
+    buf[0] = id[0];
+    buf[1] = id[1];
+    buf[2] = id[2];
+    buf[3] = ';';
+    return 4;
+}
 
 /**
- * @brief Convert a uint8_t value to an unsigned percentage for a trigger
- * 
- * This function takes a uint8_t value and converts it to an unsigned percentage
- * value. The input value is assumed to be in the range of 0 to 255, with 0
- * representing 0%. The output value is in the range of 0% to 100%.
+ * @brief Copy a precomputed percentage string into a buffer.
  * 
- * @param val The uint8_t value to convert to a percentage.
- * @return The unsigned percentage value.
+ * @param pct The percentage string to copy.
+ * @param buf The buffer to write into.
+ * @return The number of characters written.
 */
-float unsign_pct(uint8_t val);
-
-float sign_pct(uint8_t val) {
-    return (float) ((int)val - 128) / 128.0 * 100.0;
+static inline size_t put_pct(const PctStr_t* pct, char* buf) {
+    memcpy(buf, pct->str, PCT_STR_MAX_LEN);
+    return pct->len;
 }
 
-float unsign_pct(uint8_t val) {
-    return (float) val / 255.0 * 100.0;
+size_t str_of_button(Button_t* button, char* buf) {
+    // button messages are in the format "ID;PRESSED\n"
+    size_t len = put_id(button->id, buf);
+    buf[len++] = button->pressed ? '1' : '0';
+    buf[len++] = '\n';
+    buf[len] = '\0';
+    return len;
 }
 
-char *str_of_button(Button_t* button) {
-    // button messages are in the format "ID;PRESSED\n"
-    char *str_bldr = malloc(sizeof(char) * 7);
-    char *place = str_bldr;
-    strncpy(str_bldr, button->id, 3);
-    place += 3;
-    strcpy(place, ";");
-    place += 1;
-    strcpy(place, button->pressed ? "1" : "0");
-    place += 1;
-    strcpy(place, "\n");
-    return str_bldr;
-}
-
-char *str_of_joystick(Joystick_t* joystick) {
+size_t str_of_joystick(Joystick_t* joystick, char* buf) {
     // joystick messages are in the format "ID;X;Y\n"
-    char *str_bldr = malloc(sizeof(char) * 19);
-    char *place = str_bldr;
-    strncpy(str_bldr, joystick->id, 3);
-    place += strlen(joystick->id);
-    strcpy(place, ";");
-    place += 1;
-    char *x_str = malloc(sizeof(char) * 6);
-    snprintf(x_str, 6, "%.2f", joystick->x);
-    strcpy(place, x_str);
-    place += strlen(x_str);
-    free(x_str);
-    strcpy(place, ";");
-    place += 1;
-    char *y_str = malloc(sizeof(char) * 6);
-    snprintf(y_str, 6, "%.2f", joystick->y);
-    strcpy(place, y_str);
-    place += strlen(y_str);
-    free(y_str);
-    strcpy(place, "\n");
-    return str_bldr;
-}
-
-char *str_of_trigger(Trigger_t* trigger) {
+    size_t len = put_id(joystick->id, buf);
+    len += put_pct(&sign_pct_str[joystick->x], buf + len);
+    buf[len++] = ';';
+    len += put_pct(&neg_sign_pct_str[joystick->y], buf + len);
+    buf[len++] = '\n';
+    buf[len] = '\0';
+    return len;
+}
+
+size_t str_of_trigger(Trigger_t* trigger, char* buf) {
     // trigger messages are in the format "ID;VAL\n"
-    char *str_bldr = malloc(sizeof(char) * 11);
-    char *place = str_bldr;
-    char *extnt_str = malloc(sizeof(char) * 5);
-    strncpy(str_bldr, trigger->id, 3);
-    place += 3;
-    strcpy(place, ";");
-    place += 1;
-    snprintf(extnt_str, 6, "%.2f", trigger->val);
-    strcpy(place, extnt_str);
-    place += strlen(extnt_str);
-    free(extnt_str);
-    strcpy(place, "\n");
-    return str_bldr;
+    size_t len = put_id(trigger->id, buf);
+    len += put_pct(&unsign_pct_str[trigger->val], buf + len);
+    buf[len++] = '\n';
+    buf[len] = '\0';
+    return len;
 }
 
 char *str_of_dpad_dir(DPadDir_t dir) {
@@ -147,83 +118,285 @@ char *str_of_dpad_dir(DPadDir_t dir) {
     }
 }
 
-char *str_of_dpad(DPad_t* dpad) {
+size_t str_of_dpad(DPad_t* dpad, char* buf) {
     // dpad messages are in the format "ID;DIR\n"
-    char *str_bldr = malloc(sizeof(char) * 7);
-    char *place = str_bldr;
-    strncpy(str_bldr, dpad->id, 3);
-    place += strlen(dpad->id);
-    strcpy(place, ";");
-    place += 1;
+    size_t len = put_id(dpad->id, buf);
     char *dir_str = str_of_dpad_dir(dpad->dir);
-    strcpy(place, dir_str);
-    place += strlen(dir_str);
-    strcpy(place, "\n");
-    return str_bldr;
+    buf[len++] = dir_str[0];
+    if (dir_str[1] != '\0') {
+        buf[len++] = dir_str[1];
+    }
+    buf[len++] = '\n';
+    buf[len] = '\0';
+    return len;
 }
 
-void update_button(Button_t* button, bool value, bool publish) {
-    if (button->pressed == value) {
+/**
+ * @brief Write a number in decimal into a buffer.
+ * 
+ * @param val The number to write.
+ * @param buf The buffer to write into, at least 10 characters.
+ * @return The number of characters written.
+*/
+static size_t put_uint(uint32_t val, char* buf) {
+    char digits[10];
+    size_t count = 0;
+    do {
+        digits[count++] = '0' + val % 10;
+        val /= 10;
+    } while (val != 0);
+    for (size_t i = 0; i < count; i++) {
+        buf[i] = digits[count - 1 - i];
+    }
+    return count;
+}
+
+size_t str_of_seq(uint8_t seq, char* buf) {
+    // sequence messages are in the format "SEQ;N\n"
+    size_t len = put_id("SEQ", buf);
+    len += put_uint(seq, buf + len);
+    buf[len++] = '\n';
+    buf[len] = '\0';
+    return len;
+}
+
+size_t str_of_stamp(OutputStamp_t stamp, uint32_t us, char* buf) {
+    // timestamp messages are in the format "TSU;US\n" or "LAT;US\n"
+    size_t len = put_id(stamp == STAMP_LATENCY ? "LAT" : "TSU", buf);
+    len += put_uint(us, buf + len);
+    buf[len++] = '\n';
+    buf[len] = '\0';
+    return len;
+}
+
+/**
+ * @brief Get the timestamp to output for a frame.
+ * 
+ * @param frame The frame about to be written.
+ * @return The arrival time of its newest report, or the time since then.
+*/
+static inline uint32_t frame_stamp(const ConFrame_t* frame) {
+    if (output_stamp == STAMP_LATENCY) {
+        return (uint32_t) rep_clock_us() - frame->stamp_us;
+    }
+    return frame->stamp_us;
+}
+
+/**
+ * @brief Write out the bytes collected in a frame and empty it.
+ * 
+ * @param frame The frame to write.
+*/
+static void write_frame(ConFrame_t* frame) {
+    if (frame->len == 0) {
         return;
     }
-    button->pressed = value;
-    if (publish) {
-        char *msg = str_of_button(button);
-        if (UART_DEBUG) {
-            ets_printf("%s", msg);
+    if (UART_DEBUG) {
+        if (frame->format == OUTPUT_BINARY) {
+            for (size_t i = 0; i < frame->len; i++) {
+                ets_printf("%02x", (uint8_t) frame->buf[i]);
+            }
+            ets_printf("\n");
+        } else {
+            ets_printf("%.*s", (int) frame->len, frame->buf);
+        }
+    }
+    LAT_HIST_START(write_start);
+    uart_write_bytes(uart_num, frame->buf, frame->len);
+    LAT_HIST_END(LAT_WRITE, write_start);
+    frame->len = 0;
+}
+
+char *reserve_frame(ConFrame_t* frame, size_t len) {
+    // Keep room for the timestamp message that may end the frame
+    if (CON_FRAME_MAX_LEN - CON_STAMP_MSG_MAX_LEN - frame->len < len) {
+        flush_frame(frame);
+    }
+    return frame->buf + frame->len;
+}
+
+/**
+ * @brief Encode the staged binary values of a frame as one binary frame.
+ * 
+ * @param frame The frame holding the staged values.
+*/
+static void encode_binary(ConFrame_t* frame) {
+    // An empty snapshot is still sent, so a poll is always answered
+    if (frame->bin_mask == 0 && frame->bin_type == BIN_FRAME_DELTA) {
+        return;
+    }
+    uint8_t raw[BIN_FRAME_MAX_LEN];
+    size_t len = 0;
+    raw[len++] = frame->bin_type;
+    if (output_sequence) {
+        raw[0] |= BIN_FRAME_SEQ;
+        raw[len++] = frame->seq++;
+    }
+    if (output_stamp != STAMP_NONE) {
+        raw[0] |= output_stamp == STAMP_LATENCY ? BIN_FRAME_LATENCY
+                                                : BIN_FRAME_STAMP;
+        uint32_t us = frame_stamp(frame);
+        raw[len++] = us & 0xFF;
+        raw[len++] = (us >> 8) & 0xFF;
+        raw[len++] = (us >> 16) & 0xFF;
+        raw[len++] = us >> 24;
+    }
+    raw[len++] = frame->bin_mask & 0xFF;
+    raw[len++] = (frame->bin_mask >> 8) & 0xFF;
+    raw[len++] = (frame->bin_mask >> 16) & 0xFF;
+    memcpy(raw + len, frame->bin_vals, frame->bin_len);
+    len += frame->bin_len;
+    uint16_t crc = crc16_ccitt(raw, len);
+    raw[len++] = crc & 0xFF;
+    raw[len++] = crc >> 8;
+    // Not reserve_frame, as flushing would encode the staged values again.
+    // Binary frames carry their own stamp, so need no room for one.
+    if (CON_FRAME_MAX_LEN - frame->len < BIN_ENCODED_MAX_LEN) {
+        write_frame(frame);
+    }
+    uint8_t *dst = (uint8_t *) frame->buf + frame->len;
+    frame->len += cobs_encode(raw, len, dst);
+    frame->bin_mask = 0;
+    frame->bin_len = 0;
+    frame->bin_type = BIN_FRAME_DELTA;
+}
+
+/**
+ * @brief Latch the selected output format if a frame is empty.
+ * 
+ * @param frame The frame about to receive output.
+*/
+static inline void latch_format(ConFrame_t* frame) {
+    if (frame->len == 0 && frame->bin_mask == 0) {
+        frame->format = output_format;
+    }
+}
+
+/**
+ * @brief Append a control's message to a frame, or stage its binary value.
+ * 
+ * @param frame The frame to publish into.
+ * @param idx The index of the control in publish_controls.
+ * @param control A pointer to the control matching idx.
+*/
+static void stage_control(ConFrame_t* frame, uint8_t idx, void* control) {
+    LAT_HIST_START(format_start);
+    latch_format(frame);
+    if (frame->format == OUTPUT_BINARY) {
+        // A control at or below one already staged belongs to a new report
+        if (frame->bin_mask >> idx) {
+            encode_binary(frame);
         }
-        uart_write_bytes(uart_num, msg, strlen(msg));
-        free(msg);
+        frame->bin_mask |= (uint32_t) 1 << idx;
+        uint8_t *val = frame->bin_vals + frame->bin_len;
+        if (idx == CON_DPD) {
+            val[0] = ((DPad_t *) control)->dir;
+        } else if (idx == CON_LJS || idx == CON_RJS) {
+            val[0] = ((Joystick_t *) control)->x;
+            val[1] = ((Joystick_t *) control)->y;
+        } else if (idx == CON_LTR || idx == CON_RTR) {
+            val[0] = ((Trigger_t *) control)->val;
+        } else {
+            val[0] = ((Button_t *) control)->pressed;
+        }
+        frame->bin_len += bin_value_len(idx);
+        LAT_HIST_END(LAT_FORMAT, format_start);
+        return;
+    }
+    char *dst = reserve_frame(frame, CON_SEQ_MSG_MAX_LEN + CON_MSG_MAX_LEN);
+    if (frame->len == 0 && output_sequence) {
+        // Every ASCII frame starts with its sequence number
+        frame->len += str_of_seq(frame->seq++, dst);
+        dst = frame->buf + frame->len;
     }
+    if (idx == CON_DPD) {
+        frame->len += str_of_dpad((DPad_t *) control, dst);
+    } else if (idx == CON_LJS || idx == CON_RJS) {
+        frame->len += str_of_joystick((Joystick_t *) control, dst);
+    } else if (idx == CON_LTR || idx == CON_RTR) {
+        frame->len += str_of_trigger((Trigger_t *) control, dst);
+    } else {
+        frame->len += str_of_button((Button_t *) control, dst);
+    }
+    LAT_HIST_END(LAT_FORMAT, format_start);
+}
+
+void publish_control(ConFrame_t* frame, uint8_t idx, void* control) {
+    if (!publish_controls[idx] || output_mode == OUTPUT_POLL ||
+        output_trace == TRACE_ONLY) {
+        return;
+    }
+    stage_control(frame, idx, control);
+}
+
+void flush_frame(ConFrame_t* frame) {
+    encode_binary(frame);
+    if (frame->len == 0) {
+        return;
+    }
+    if (frame->format == OUTPUT_ASCII && output_stamp != STAMP_NONE) {
+        // reserve_frame always leaves room for this last message
+        frame->len += str_of_stamp(output_stamp, frame_stamp(frame),
+                                   frame->buf + frame->len);
+    }
+    write_frame(frame);
+}
+
+void publish_trace(uint32_t stamp_us, const uint8_t* value, size_t len) {
+    TraceRec_t rec;
+    trace_rec_of_notify(&rec, stamp_us, value, len);
+    if (output_format == OUTPUT_ASCII) {
+        char line[TRACE_LINE_MAX_LEN];
+        uart_write_bytes(uart_num, line, str_of_trace_rec(&rec, line));
+        return;
+    }
+    uint8_t raw[1 + TRACE_REC_LEN + BIN_CRC_LEN];
+    raw[0] = BIN_FRAME_TRACE;
+    trace_put_rec(&rec, raw + 1);
+    uint16_t crc = crc16_ccitt(raw, 1 + TRACE_REC_LEN);
+    raw[1 + TRACE_REC_LEN] = crc & 0xFF;
+    raw[2 + TRACE_REC_LEN] = crc >> 8;
+    uint8_t frame[sizeof(raw) + 2];
+    uart_write_bytes(uart_num, frame, cobs_encode(raw, sizeof(raw), frame));
+}
+
+void update_button(Button_t* button, bool value, uint8_t idx,
+                   ConFrame_t* frame) {
+    if (button->pressed == value) {
+        return;
+    }
+    button->pressed = value;
+    publish_control(frame, idx, button);
     return;
 }
 
-void update_joystick(Joystick_t* joystick, float x, float y, bool publish) {
+void update_joystick(Joystick_t* joystick, uint8_t x, uint8_t y, uint8_t idx,
+                     ConFrame_t* frame) {
     if (joystick->x == x && joystick->y == y) {
         return;
     }
     joystick->x = x;
     joystick->y = y;
-    if (publish) {
-        char *msg = str_of_joystick(joystick);
-        if (UART_DEBUG) {
-            ets_printf("%s", msg);
-        }
-        uart_write_bytes(uart_num, msg, strlen(msg));
-        free(msg);
-    }
+    publish_control(frame, idx, joystick);
     return;
 }
 
-void update_trigger(Trigger_t* trigger, float value, bool publish) {
+void update_trigger(Trigger_t* trigger, uint8_t value, uint8_t idx,
+                    ConFrame_t* frame) {
     if (trigger->val == value) {
         return;
     }
     trigger->val = value;
-    if (publish) {
-        char *msg = str_of_trigger(trigger);
-        if (UART_DEBUG) {
-            ets_printf("%s", msg);
-        }
-        uart_write_bytes(uart_num, msg, strlen(msg));
-        free(msg);
-    }
+    publish_control(frame, idx, trigger);
     return;
 }
 
-void update_dpad(DPad_t* dpad, DPadDir_t dir, bool publish) {
+void update_dpad(DPad_t* dpad, DPadDir_t dir, uint8_t idx, ConFrame_t* frame) {
     if (dpad->dir == dir) {
         return;
     }
     dpad->dir = dir;
-    if (publish) {
-        char *msg = str_of_dpad(dpad);
-        if (UART_DEBUG) {
-            ets_printf("%s", msg);
-        }
-        uart_write_bytes(uart_num, msg, strlen(msg));
-        free(msg);
-    }
+    publish_control(frame, idx, dpad);
     return;
 }
 
@@ -244,52 +417,426 @@ void init_controller(ConState_t *state) {
     state->OPT = (Button_t) {"OPT", false};
     state->RBP = (Button_t) {"RBP", false};
     state->LBP = (Button_t) {"LBP", false};
-    state->LJS = (Joystick_t) {"LJS", 0.0, 0.0};
-    state->RJS = (Joystick_t) {"RJS", 0.0, 0.0};
-    state->LTR = (Trigger_t) {"LTR", 0.0};
-    state->RTR = (Trigger_t) {"RTR", 0.0};
+    state->LJS = (Joystick_t) {"LJS", 0x80, 0x80};
+    state->RJS = (Joystick_t) {"RJS", 0x80, 0x80};
+    state->LTR = (Trigger_t) {"LTR", 0x00};
+    state->RTR = (Trigger_t) {"RTR", 0x00};
     state->DPD = (DPad_t) {"DPD", (DPadDir_t) (0x08)};
+    // The raw report matching the values above: D-pad released, no buttons,
+    // sticks centered and triggers released
+    state->prev = (StadiaRep_t) {
+        .dpad = 0x08,
+        .stickX = 0x80, .stickY = 0x80, .stickZ = 0x80, .stickRz = 0x80,
+    };
+    state->out.len = 0;
+    state->out.bin_mask = 0;
+    state->out.bin_len = 0;
+    state->out.format = output_format;
+    state->out.bin_type = BIN_FRAME_DELTA;
+    state->out.seq = 0;
+    state->out.stamp_us = 0;
+    state->held = 0;
+    memset(state->last_pub, 0, sizeof(state->last_pub));
 }
 
-void update_controller(ConState_t* state, StadiaRep_t* rep) {
-    // Store an array indicating whether each component of the state changed
-    // We need to update every component of the state with correct report data
-    // We will go in order of the report structure
+/**
+ * Offset of every control in ConState_t, indexed like publish_controls.
+*/
+static const size_t control_offsets[CON_NUM_CONTROLS] = {
+    [CON_DPD] = offsetof(ConState_t, DPD),
+    [CON_RSB] = offsetof(ConState_t, RSB),
+    [CON_OPT] = offsetof(ConState_t, OPT),
+    [CON_MEN] = offsetof(ConState_t, MEN),
+    [CON_STB] = offsetof(ConState_t, STB),
+    [CON_RTB] = offsetof(ConState_t, RTB),
+    [CON_LTB] = offsetof(ConState_t, LTB),
+    [CON_GAS] = offsetof(ConState_t, GAS),
+    [CON_CPT] = offsetof(ConState_t, CPT),
+    [CON_LAB] = offsetof(ConState_t, LAB),
+    [CON_LBB] = offsetof(ConState_t, LBB),
+    [CON_LXB] = offsetof(ConState_t, LXB),
+    [CON_LYB] = offsetof(ConState_t, LYB),
+    [CON_LBP] = offsetof(ConState_t, LBP),
+    [CON_RBP] = offsetof(ConState_t, RBP),
+    [CON_LSB] = offsetof(ConState_t, LSB),
+    [CON_LJS] = offsetof(ConState_t, LJS),
+    [CON_RJS] = offsetof(ConState_t, RJS),
+    [CON_LTR] = offsetof(ConState_t, LTR),
+    [CON_RTR] = offsetof(ConState_t, RTR),
+};
+
+/**
+ * @brief Get a control of a controller state by its index.
+ * 
+ * @param state The controller state holding the control.
+ * @param idx The index of the control in publish_controls.
+ * @return A pointer to the Button_t, Joystick_t, Trigger_t or DPad_t.
+*/
+static inline void *control_of(ConState_t* state, uint8_t idx) {
+    return (char *) state + control_offsets[idx];
+}
+
+/**
+ * Buttons of the controller in the order they are published, with the report
+ * byte and bit that carry each one and its index in publish_controls.
+*/
+static const struct {
+    size_t offset;    // Offset of the Button_t in ConState_t
+    uint8_t mask;     // Bit of the button in its report byte
+    uint8_t pub_idx;  // Index of the button in publish_controls
+} buttons1_map[8] = {
+    {offsetof(ConState_t, RSB), 0x80, CON_RSB},
+    {offsetof(ConState_t, OPT), 0x40, CON_OPT},
+    {offsetof(ConState_t, MEN), 0x20, CON_MEN},
+    {offsetof(ConState_t, STB), 0x10, CON_STB},
+    {offsetof(ConState_t, RTB), 0x08, CON_RTB},
+    {offsetof(ConState_t, LTB), 0x04, CON_LTB},
+    {offsetof(ConState_t, GAS), 0x02, CON_GAS},
+    {offsetof(ConState_t, CPT), 0x01, CON_CPT},
+}, buttons2_map[7] = {
+    {offsetof(ConState_t, LAB), 0x40, CON_LAB},
+    {offsetof(ConState_t, LBB), 0x20, CON_LBB},
+    {offsetof(ConState_t, LXB), 0x10, CON_LXB},
+    {offsetof(ConState_t, LYB), 0x08, CON_LYB},
+    {offsetof(ConState_t, LBP), 0x04, CON_LBP},
+    {offsetof(ConState_t, RBP), 0x02, CON_RBP},
+    {offsetof(ConState_t, LSB), 0x01, CON_LSB},
+};
+
+/**
+ * Masks selecting report fields in the first 8 bytes of a report loaded as a
+ * single 64 bit word.
+*/
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define REP_BYTE(field) ((uint64_t) 0xFF << (8 * offsetof(StadiaRep_t, field)))
+#else
+#define REP_BYTE(field) \
+    ((uint64_t) 0xFF << (8 * (7 - offsetof(StadiaRep_t, field))))
+#endif
+#define REP_ANALOG_MASK  (REP_BYTE(stickX) | REP_BYTE(stickY) | \
+                          REP_BYTE(stickZ) | REP_BYTE(stickRz) | \
+                          REP_BYTE(brake))
+
+// Set to 0 to walk the analog group of every report, the baseline the skip is
+// measured against by host/bench/xor_bench.c
+#ifndef REP_XOR_SKIP
+#define REP_XOR_SKIP 1
+#endif
+
+/**
+ * @brief XOR the first 8 bytes of two reports as a single word.
+ * 
+ * The last two bytes (throttle and volume) are compared separately.
+ * 
+ * @param a The first report.
+ * @param b The second report.
+ * @return The XOR of the first 8 bytes of both reports.
+*/
+static inline uint64_t rep_xor(const StadiaRep_t* a, const StadiaRep_t* b) {
+    uint64_t wa, wb;
+    memcpy(&wa, a, sizeof(wa));
+    memcpy(&wb, b, sizeof(wb));
+    return wa ^ wb;
+}
+
+/**
+ * @brief Update the D-pad and buttons of a controller from a report.
+ * 
+ * Only the buttons whose bit differs from the previous report are touched.
+ * 
+ * @param state A pointer to the ConState_t struct to update.
+ * @param rep A pointer to the StadiaRep_t struct to update the controller with.
+*/
+static void update_digital(ConState_t* state, StadiaRep_t* rep) {
+    StadiaRep_t *prev = &state->prev;
 
     // DPAD UPDATE
-    assert (rep->dpad <= 8);
-    update_dpad(&state->DPD, (DPadDir_t) rep->dpad, publish_controls[0]);
+    if (rep->dpad != prev->dpad) {
+        assert (rep->dpad <= 8);
+        update_dpad(&state->DPD, (DPadDir_t) rep->dpad, CON_DPD, &state->out);
+    }
 
     // BUTTONS UPDATE
-    update_button(&state->RSB, (rep->buttons1 & 0x80) != 0, publish_controls[1]);
-    update_button(&state->OPT, (rep->buttons1 & 0x40) != 0, publish_controls[2]);
-    update_button(&state->MEN, (rep->buttons1 & 0x20) != 0, publish_controls[3]);
-    update_button(&state->STB, (rep->buttons1 & 0x10) != 0, publish_controls[4]);
-    update_button(&state->RTB, (rep->buttons1 & 0x08) != 0, publish_controls[5]);
-    update_button(&state->LTB, (rep->buttons1 & 0x04) != 0, publish_controls[6]);
-    update_button(&state->GAS, (rep->buttons1 & 0x02) != 0, publish_controls[7]);
-    update_button(&state->CPT, (rep->buttons1 & 0x01) != 0, publish_controls[8]);
-    update_button(&state->LAB, (rep->buttons2 & 0x40) != 0, publish_controls[9]);
-    update_button(&state->LBB, (rep->buttons2 & 0x20) != 0, publish_controls[10]);
-    update_button(&state->LXB, (rep->buttons2 & 0x10) != 0, publish_controls[11]);
-    update_button(&state->LYB, (rep->buttons2 & 0x08) != 0, publish_controls[12]);
-    update_button(&state->LBP, (rep->buttons2 & 0x04) != 0, publish_controls[13]);
-    update_button(&state->RBP, (rep->buttons2 & 0x02) != 0, publish_controls[14]);
-    update_button(&state->LSB, (rep->buttons2 & 0x01) != 0, publish_controls[15]);
+    uint8_t changed = rep->buttons1 ^ prev->buttons1;
+    for (size_t i = 0; changed != 0 && i < 8; i++) {
+        if (changed & buttons1_map[i].mask) {
+            update_button((Button_t *) ((char *) state + buttons1_map[i].offset),
+                          (rep->buttons1 & buttons1_map[i].mask) != 0,
+                          buttons1_map[i].pub_idx, &state->out);
+            changed &= ~buttons1_map[i].mask;
+        }
+    }
+    changed = rep->buttons2 ^ prev->buttons2;
+    for (size_t i = 0; changed != 0 && i < 7; i++) {
+        if (changed & buttons2_map[i].mask) {
+            update_button((Button_t *) ((char *) state + buttons2_map[i].offset),
+                          (rep->buttons2 & buttons2_map[i].mask) != 0,
+                          buttons2_map[i].pub_idx, &state->out);
+            changed &= ~buttons2_map[i].mask;
+        }
+    }
+
+    prev->dpad = rep->dpad;
+    prev->buttons1 = rep->buttons1;
+    prev->buttons2 = rep->buttons2;
+}
+
+/**
+ * @brief Check whether a raw axis value moved far enough to be published.
+ * 
+ * @param old The last accepted raw value.
+ * @param val The new raw value.
+ * @param rest The raw value of the axis at rest.
+ * @param min_delta The smallest change that counts as a move.
+ * @return true if the change should be published.
+*/
+static inline bool axis_moved(uint8_t old, uint8_t val, uint8_t rest,
+                              uint8_t min_delta) {
+    if (old == val) {
+        return false;
+    }
+    // Settling at rest or at either end of travel always goes through, so the
+    // published value never gets stuck just short of them
+    if (val == rest || val == 0x00 || val == 0xFF) {
+        return true;
+    }
+    int delta = (int) val - (int) old;
+    return delta >= min_delta || -delta >= min_delta;
+}
+
+/**
+ * @brief Apply the deadzone and change threshold of a joystick to raw values.
+ * 
+ * Inside the radial deadzone the stick reads as centered. Outside, a new
+ * position is only accepted once either axis moved by the minimum delta.
+ * 
+ * @param joystick The joystick holding the last accepted position.
+ * @param idx The index of the joystick in publish_controls.
+ * @param x The new raw x value, replaced by the filtered value.
+ * @param y The new raw y value, replaced by the filtered value.
+ * @return true if the filtered position should be applied.
+*/
+static bool filter_joystick(Joystick_t* joystick, uint8_t idx, uint8_t* x,
+                            uint8_t* y) {
+    int dx = (int) *x - 0x80;
+    int dy = (int) *y - 0x80;
+    int dz = control_deadzone[idx];
+    if (dx * dx + dy * dy <= dz * dz) {
+        *x = 0x80;
+        *y = 0x80;
+    }
+    return axis_moved(joystick->x, *x, 0x80, control_min_delta[idx]) ||
+           axis_moved(joystick->y, *y, 0x80, control_min_delta[idx]);
+}
+
+/**
+ * @brief Apply the deadzone and change threshold of a trigger to a raw value.
+ * 
+ * @param trigger The trigger holding the last accepted position.
+ * @param idx The index of the trigger in publish_controls.
+ * @param val The new raw value, replaced by the filtered value.
+ * @return true if the filtered position should be applied.
+*/
+static bool filter_trigger(Trigger_t* trigger, uint8_t idx, uint8_t* val) {
+    if (*val <= control_deadzone[idx]) {
+        *val = 0x00;
+    }
+    return axis_moved(trigger->val, *val, 0x00, control_min_delta[idx]);
+}
+
+/**
+ * @brief Decide whether a changed joystick or trigger is published right away.
+ * 
+ * In snapshot mode analog changes always wait for the next tick. Otherwise a
+ * control is held if it was published less than one interval of its maximum
+ * publish rate ago.
+ * 
+ * @param state The controller state holding the control.
+ * @param idx The index of the control in publish_controls.
+ * @return true if the control should be published now, false if it was held.
+*/
+static bool analog_due(ConState_t* state, uint8_t idx) {
+    uint32_t bit = (uint32_t) 1 << idx;
+    if (SNAPSHOT_RATE_HZ > 0) {
+        state->held |= bit;
+        return false;
+    }
+    if (control_max_rate_hz[idx] != 0) {
+        int64_t now = rep_clock_us();
+        if (now - state->last_pub[idx] < 1000000 / control_max_rate_hz[idx]) {
+            state->held |= bit;
+            return false;
+        }
+        state->last_pub[idx] = now;
+    }
+    state->held &= ~bit;
+    return true;
+}
+
+/**
+ * @brief Update the joysticks and triggers of a controller from a report.
+ * 
+ * Only the controls whose raw bytes differ from the previous report are
+ * touched, and only positions that pass the control's deadzone and change
+ * threshold are applied.
+ * 
+ * @param state A pointer to the ConState_t struct to update.
+ * @param rep A pointer to the StadiaRep_t struct to update the controller with.
+*/
+static void update_analog(ConState_t* state, StadiaRep_t* rep) {
+    StadiaRep_t *prev = &state->prev;
 
     // JOYSTICKS UPDATE
-    update_joystick(&state->LJS, sign_pct(rep->stickX), -sign_pct(rep->stickY),
-                    publish_controls[16]);
-    update_joystick(&state->RJS, sign_pct(rep->stickZ), -sign_pct(rep->stickRz),
-                    publish_controls[17]);
+    // Deadzones and thresholds are applied to the raw bytes, so filtered out
+    // jitter never reaches formatting. Held positions are stored without
+    // publishing and go out with the next snapshot or once their rate allows.
+    if (rep->stickX != prev->stickX || rep->stickY != prev->stickY) {
+        uint8_t x = rep->stickX;
+        uint8_t y = rep->stickY;
+        if (filter_joystick(&state->LJS, CON_LJS, &x, &y)) {
+            if (analog_due(state, CON_LJS)) {
+                update_joystick(&state->LJS, x, y, CON_LJS, &state->out);
+            } else {
+                state->LJS.x = x;
+                state->LJS.y = y;
+            }
+        }
+    }
+    if (rep->stickZ != prev->stickZ || rep->stickRz != prev->stickRz) {
+        uint8_t x = rep->stickZ;
+        uint8_t y = rep->stickRz;
+        if (filter_joystick(&state->RJS, CON_RJS, &x, &y)) {
+            if (analog_due(state, CON_RJS)) {
+                update_joystick(&state->RJS, x, y, CON_RJS, &state->out);
+            } else {
+                state->RJS.x = x;
+                state->RJS.y = y;
+            }
+        }
+    }
     
     // TRIGGERS UPDATE
-    update_trigger(&state->LTR, unsign_pct(rep->brake), publish_controls[18]);
-    update_trigger(&state->RTR, unsign_pct(rep->throttle), publish_controls[19]);
+    if (rep->brake != prev->brake) {
+        uint8_t val = rep->brake;
+        if (filter_trigger(&state->LTR, CON_LTR, &val)) {
+            if (analog_due(state, CON_LTR)) {
+                update_trigger(&state->LTR, val, CON_LTR, &state->out);
+            } else {
+                state->LTR.val = val;
+            }
+        }
+    }
+    if (rep->throttle != prev->throttle) {
+        uint8_t val = rep->throttle;
+        if (filter_trigger(&state->RTR, CON_RTR, &val)) {
+            if (analog_due(state, CON_RTR)) {
+                update_trigger(&state->RTR, val, CON_RTR, &state->out);
+            } else {
+                state->RTR.val = val;
+            }
+        }
+    }
+
+    prev->stickX = rep->stickX;
+    prev->stickY = rep->stickY;
+    prev->stickZ = rep->stickZ;
+    prev->stickRz = rep->stickRz;
+    prev->brake = rep->brake;
+    prev->throttle = rep->throttle;
+    prev->volume = rep->volume;
+}
+
+void update_controller(ConState_t* state, StadiaRep_t* rep) {
+    LAT_HIST_START(decode_start);
+    state->out.stamp_us = rep->stamp_us;
+    // The D-pad and buttons are three byte compares, cheaper to make than to
+    // skip. The six analog bytes are checked with one wide XOR against the
+    // previous report and skipped when none changed.
+    update_digital(state, rep);
+    if (!REP_XOR_SKIP || (rep_xor(rep, &state->prev) & REP_ANALOG_MASK) ||
+        rep->throttle != state->prev.throttle) {
+        update_analog(state, rep);
+    }
+    LAT_HIST_END(LAT_DECODE, decode_start);
+    flush_frame(&state->out);
+    return;
+}
 
+void update_controller_batch(ConState_t* state, StadiaRep_t* reps,
+                             size_t count) {
+    if (count == 0) {
+        return;
+    }
+    LAT_HIST_START(decode_start);
+    // Frames from a batch are stamped with its newest report
+    state->out.stamp_us = reps[count - 1].stamp_us;
+    // Edges are published in order, one report at a time
+    for (size_t i = 0; i < count; i++) {
+        update_digital(state, &reps[i]);
+    }
+    // Analog controls only publish where the batch left them
+    StadiaRep_t *last = &reps[count - 1];
+    if (!REP_XOR_SKIP || (rep_xor(last, &state->prev) & REP_ANALOG_MASK) ||
+        last->throttle != state->prev.throttle) {
+        update_analog(state, last);
+    }
+    LAT_HIST_END(LAT_DECODE, decode_start);
+    flush_frame(&state->out);
     return;
 }
 
+void publish_snapshot(ConState_t* state, bool changed_only) {
+    if (output_trace == TRACE_ONLY) {
+        return;
+    }
+    int64_t now = rep_clock_us();
+    latch_format(&state->out);
+    for (uint8_t idx = 0; idx < CON_NUM_CONTROLS; idx++) {
+        if (changed_only && !(state->held & ((uint32_t) 1 << idx))) {
+            continue;
+        }
+        if (publish_controls[idx]) {
+            stage_control(&state->out, idx, control_of(state, idx));
+        }
+        state->last_pub[idx] = now;
+    }
+    state->held = 0;
+    if (!changed_only && state->out.format == OUTPUT_BINARY) {
+        state->out.bin_type = BIN_FRAME_SNAPSHOT;
+    }
+    flush_frame(&state->out);
+    return;
+}
+
+int64_t publish_held_controls(ConState_t* state) {
+    // Held controls wait for the snapshot tick in snapshot mode
+    if (state->held == 0 || SNAPSHOT_RATE_HZ > 0) {
+        return -1;
+    }
+    int64_t now = rep_clock_us();
+    int64_t next = -1;
+    for (uint8_t idx = CON_LJS; idx <= CON_RTR; idx++) {
+        uint32_t bit = (uint32_t) 1 << idx;
+        if (!(state->held & bit)) {
+            continue;
+        }
+        int64_t wait = 0;
+        if (control_max_rate_hz[idx] != 0) {
+            wait = state->last_pub[idx] + 1000000 / control_max_rate_hz[idx]
+                   - now;
+        }
+        if (wait <= 0) {
+            publish_control(&state->out, idx, control_of(state, idx));
+            state->last_pub[idx] = now;
+            state->held &= ~bit;
+        } else if (next < 0 || wait < next) {
+            next = wait;
+        }
+    }
+    flush_frame(&state->out);
+    return next;
+}
+
 void print_controller(ConState_t* state) {
     ets_printf("==============================\n");
     ets_printf("      Controller State:\n");
@@ -308,10 +855,18 @@ void print_controller(ConState_t* state) {
     ets_printf("OPT: %d\n", state->OPT.pressed);
     ets_printf("RBP: %d\n", state->RBP.pressed);
     ets_printf("LBP: %d\n", state->LBP.pressed);
-    ets_printf("LJS: (%f, %f)\n", state->LJS.x, state->LJS.y);
-    ets_printf("RJS: (%f, %f)\n", state->RJS.x, state->RJS.y);
-    ets_printf("LTR: %f\n", state->LTR.val);
-    ets_printf("RTR: %f\n", state->RTR.val);
+    ets_printf("LJS: (%.*s, %.*s)\n",
+               sign_pct_str[state->LJS.x].len, sign_pct_str[state->LJS.x].str,
+               neg_sign_pct_str[state->LJS.y].len,
+               neg_sign_pct_str[state->LJS.y].str);
+    ets_printf("RJS: (%.*s, %.*s)\n",
+               sign_pct_str[state->RJS.x].len, sign_pct_str[state->RJS.x].str,
+               neg_sign_pct_str[state->RJS.y].len,
+               neg_sign_pct_str[state->RJS.y].str);
+    ets_printf("LTR: %.*s\n", unsign_pct_str[state->LTR.val].len,
+               unsign_pct_str[state->LTR.val].str);
+    ets_printf("RTR: %.*s\n", unsign_pct_str[state->RTR.val].len,
+               unsign_pct_str[state->RTR.val].str);
     ets_printf("DPD: %d\n", state->DPD.dir);
     ets_printf("==============================\n");
 }
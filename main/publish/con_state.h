@@ -13,6 +13,24 @@
 #include <stdint.h>
 #include <stddef.h>
 #include "rep_queue.h"
+#include "bin_proto.h"
+#include "globalconst.h"
+
+// Size of a buffer that holds any single control message, including the NUL.
+// The longest is a joystick, e.g. "LJS;-100.;-100.\n".
+#define CON_MSG_MAX_LEN 19
+
+// Size of a buffer that holds a sequence number message, including the NUL,
+// e.g. "SEQ;255\n".
+#define CON_SEQ_MSG_MAX_LEN 9
+
+// Size of a buffer that holds a timestamp message, including the NUL, e.g.
+// "TSU;4294967295\n". Room for one is always kept free at the end of a frame.
+#define CON_STAMP_MSG_MAX_LEN 16
+
+// Size of the output frame. One report publishes at most 20 messages, a batch
+// of reports can publish more, in which case the frame is flushed early.
+#define CON_FRAME_MAX_LEN 512
 
 /**
  * @brief Represents a button on the controller.
@@ -27,72 +45,74 @@ typedef struct Button {
 } Button_t;
 
 /**
- * @brief Returns the string representation of a button.
+ * @brief Writes the string representation of a button.
  * 
- * This function is used to return the string representation of a button. The
- * function takes a pointer to a Button_t struct and returns a pointer to a string
- * representation of the button.
+ * This function is used to write the string representation of a button. The
+ * function takes a pointer to a Button_t struct and writes its message into a
+ * caller provided buffer of at least CON_MSG_MAX_LEN characters.
  * 
  * @param button A pointer to the Button_t struct to get the string representation of.
- * @return A pointer to a string representation of the button.
+ * @param buf The buffer to write the NUL terminated message into.
+ * @return The length of the message, not counting the NUL.
 */
-char *str_of_button(Button_t* button);
+size_t str_of_button(Button_t* button, char* buf);
 
 /**
  * @brief Represents a joystick on the controller.
  * 
  * This struct is used to represent a joystick on the controller. It contains
- * two values, x and y, to represent the position of the joystick. Since we want 
- * to output joystick positions as ASCII, we store the x and y values as
- * perentages of maximum values. For example, a stick all the way left would be 
- * -100% along the x-axis, and a stick all the way up would be 100% along the
- * y-axis. Each stick also has a unique string identifier of length 2 to
- * represent the stick in ASCII.
+ * two values, x and y, to represent the position of the joystick. The values
+ * are kept as the raw bytes from the report, with 128 at the center, and are
+ * output as perentages of maximum values. For example, a stick all the way
+ * left would be -100% along the x-axis, and a stick all the way up would be
+ * 100% along the y-axis. Each stick also has a unique string identifier of
+ * length 2 to represent the stick in ASCII.
 */
 typedef struct Joystick {
     char id[3]; // The unique identifier of the joystick.
-    float x;    // The x position of the joystick as a percentage.
-    float y;    // The y position of the joystick as a percentage.
+    uint8_t x;  // The raw x position of the joystick.
+    uint8_t y;  // The raw y position of the joystick, down is positive.
 } Joystick_t;
 
 /**
- * @brief Returns the string representation of a joystick.
+ * @brief Writes the string representation of a joystick.
  * 
- * This function is used to return the string representation of a joystick. The
- * function takes a pointer to a Joystick_t struct and returns a pointer to a
- * string representation of the joystick.
+ * This function is used to write the string representation of a joystick. The
+ * function takes a pointer to a Joystick_t struct and writes its message into
+ * a caller provided buffer of at least CON_MSG_MAX_LEN characters.
  * 
  * @param joystick A pointer to the Joystick_t struct to get the string representation of.
- * @return A pointer to a string representation of the joystick.
+ * @param buf The buffer to write the NUL terminated message into.
+ * @return The length of the message, not counting the NUL.
 */
-char *str_of_joystick(Joystick_t* joystick);
+size_t str_of_joystick(Joystick_t* joystick, char* buf);
 
 /**
  * @brief Represents a trigger on the controller.
  * 
  * This struct is used to represent a trigger on the controller. It contains a
- * value to represent the position of the trigger. Since we want to output
- * trigger positions as ASCII, we store the trigger value as a percentage of the
- * maximum value. For example, a trigger pressed all the way down would be 100%.
- * Each trigger also has a unique string identifier of length 2 to represent the
- * trigger in ASCII.
+ * value to represent the position of the trigger. The value is kept as the raw
+ * byte from the report and is output as a percentage of the maximum value. For
+ * example, a trigger pressed all the way down would be 100%. Each trigger also
+ * has a unique string identifier of length 2 to represent the trigger in ASCII.
 */
 typedef struct Trigger {
     char id[3];   // The unique identifier of the trigger.
-    float val;    // The position of the trigger as a percentage.
+    uint8_t val;  // The raw position of the trigger.
 } Trigger_t;
 
 /**
- * @brief Returns the string representation of a trigger.
+ * @brief Writes the string representation of a trigger.
  * 
- * This function is used to return the string representation of a trigger. The
- * function takes a pointer to a Trigger_t struct and returns a pointer to a
- * string representation of the trigger.
+ * This function is used to write the string representation of a trigger. The
+ * function takes a pointer to a Trigger_t struct and writes its message into a
+ * caller provided buffer of at least CON_MSG_MAX_LEN characters.
  * 
  * @param trigger A pointer to the Trigger_t struct to get the string representation of.
- * @return A pointer to a string representation of the trigger.
+ * @param buf The buffer to write the NUL terminated message into.
+ * @return The length of the message, not counting the NUL.
 */
-char *str_of_trigger(Trigger_t* trigger);
+size_t str_of_trigger(Trigger_t* trigger, char* buf);
 
 /**
  * @brief Represents the possible compass directions of a D-pas.
@@ -138,23 +158,137 @@ typedef struct DPad {
 } DPad_t;
 
 /**
- * @brief Returns the string representation of a D-pad.
+ * @brief Writes the string representation of a D-pad.
  * 
- * This function is used to return the string representation of a D-pad. The
- * function takes a pointer to a DPad_t struct and returns a pointer to a string
- * representation of the D-pad.
+ * This function is used to write the string representation of a D-pad. The
+ * function takes a pointer to a DPad_t struct and writes its message into a
+ * caller provided buffer of at least CON_MSG_MAX_LEN characters.
  * 
  * @param dpad A pointer to the DPad_t struct to get the string representation of.
- * @return A pointer to a string representation of the D-pad.
+ * @param buf The buffer to write the NUL terminated message into.
+ * @return The length of the message, not counting the NUL.
+*/
+size_t str_of_dpad(DPad_t* dpad, char* buf);
+
+/**
+ * @brief An output frame collecting the messages published for one report.
+ * 
+ * Messages are appended to the frame as controls change, and the whole frame
+ * is handed to the UART driver in a single write once the report has been
+ * processed. This keeps the lines from one report contiguous on the wire and
+ * pays the driver's locking cost once per report instead of once per control.
+ * 
+ * With the binary output format, changed control values are first staged with
+ * their bitmask, and encoded into buf as one binary frame when the report is
+ * done. Controls are always updated in index order, so a control at or below
+ * the last staged index means a new report in a batch has started, and the
+ * staged frame is encoded before the new value is staged.
+ * 
+ * The output format can be switched at runtime, so it is latched when the
+ * first message enters an empty frame and kept until the frame is flushed.
+ * 
+ * When sequence numbers are enabled, every ASCII frame starts with a SEQ
+ * message and every binary frame carries a sequence byte. The number counts
+ * up by one per frame and wraps from 255 to 0, so the reader can tell when
+ * frames were lost.
+ * 
+ * When timestamps are enabled, every ASCII frame ends with a TSU message
+ * holding the arrival time of the newest report the frame was built from (for
+ * a batch, the newest report of the batch), or a LAT message holding the time
+ * from its arrival until the frame is written. Binary frames carry the same
+ * value in their header.
+*/
+typedef struct ConFrame {
+    char buf[CON_FRAME_MAX_LEN]; // The messages waiting to be written.
+    size_t len;                  // The number of characters in buf.
+    uint32_t bin_mask;           // Controls staged for the binary frame.
+    uint8_t bin_vals[BIN_FRAME_MAX_LEN]; // Values staged, in index order.
+    size_t bin_len;              // The number of bytes in bin_vals.
+    OutputFormat_t format;       // The output format of the frame.
+    uint8_t bin_type;            // The type of the staged binary frame.
+    uint8_t seq;                 // Sequence number of the next frame.
+    uint32_t stamp_us;           // Arrival time of the newest report.
+} ConFrame_t;
+
+/**
+ * @brief Writes the sequence number message that starts an ASCII frame.
+ * 
+ * @param seq The sequence number of the frame.
+ * @param buf The buffer to write the NUL terminated message into, at least
+ *            CON_SEQ_MSG_MAX_LEN characters.
+ * @return The length of the message, not counting the NUL.
+*/
+size_t str_of_seq(uint8_t seq, char* buf);
+
+/**
+ * @brief Writes the timestamp message that ends an ASCII frame.
+ * 
+ * @param stamp The output_stamp setting selecting the message, not STAMP_NONE.
+ * @param us The arrival time or latency in microseconds.
+ * @param buf The buffer to write the NUL terminated message into, at least
+ *            CON_STAMP_MSG_MAX_LEN characters.
+ * @return The length of the message, not counting the NUL.
+*/
+size_t str_of_stamp(OutputStamp_t stamp, uint32_t us, char* buf);
+
+/**
+ * @brief Reserve room at the end of a frame.
+ * 
+ * If the frame cannot fit the requested number of characters it is flushed
+ * first.
+ * 
+ * @param frame The frame to append to.
+ * @param len The number of characters needed, at most CON_FRAME_MAX_LEN.
+ * @return A buffer of at least len characters at the frame's end.
 */
-char *str_of_dpad(DPad_t* dpad);
+char *reserve_frame(ConFrame_t* frame, size_t len);
+
+/**
+ * @brief Publish the current value of a control into a frame.
+ * 
+ * Appends the control's ASCII message or stages its binary value, depending on
+ * the selected output format. Does nothing if the control is not published, or
+ * in poll mode, where controls are only output as part of a snapshot, or when
+ * notifications are traced instead of the controller output.
+ * 
+ * @param frame The frame to publish into.
+ * @param idx The index of the control in publish_controls.
+ * @param control A pointer to the Button_t, Joystick_t, Trigger_t or DPad_t
+ *                matching idx.
+*/
+void publish_control(ConFrame_t* frame, uint8_t idx, void* control);
+
+/**
+ * @brief Write out all messages collected in a frame and empty it.
+ * 
+ * @param frame The frame to flush.
+*/
+void flush_frame(ConFrame_t* frame);
+
+/**
+ * @brief Trace a raw notification to the output, see trace_fmt.h.
+ * 
+ * The record is written at once in the selected output format. It does not
+ * use a frame, so it may be called from the Bluetooth task while the
+ * publishing task fills its frame.
+ * 
+ * @param stamp_us The arrival time of the notification.
+ * @param value The notification bytes.
+ * @param len The length of the notification.
+*/
+void publish_trace(uint32_t stamp_us, const uint8_t* value, size_t len);
 
 /**
  * @brief Represents the state of the Google Stadia controller.
  * 
  * This struct is used to represent the state of the Google Stadia controller.
  * It contains all the buttons, joysticks, triggers, and D-pad of the controller,
- * with all of the unique identifiers for each control on the controller.
+ * with all of the unique identifiers for each control on the controller. The
+ * raw report behind the current state is kept so that a new report can be
+ * compared against it byte for byte, and only changed controls are touched.
+ * Joystick and trigger changes can be held back instead of published right
+ * away, either until the next snapshot tick or until their maximum publish
+ * rate allows them out again, and are tracked in a bitmask until then.
  * The identifiers go as follows:
  *  - D-pad: DP
  *  - Joysticks:
@@ -202,6 +336,11 @@ typedef struct ConState {
     Trigger_t LTR;  // The left trigger.
     Trigger_t RTR;  // The right trigger.
     DPad_t DPD;     // The D-pad.
+    StadiaRep_t prev; // The raw report the state was last updated from.
+    ConFrame_t out;   // Messages published for the report being processed.
+    uint32_t held;    // Controls changed but held back from publishing.
+    int64_t last_pub[CON_NUM_CONTROLS]; // When each control was last
+                                        // published, in microseconds.
 } ConState_t;
 
 /**
@@ -210,40 +349,50 @@ typedef struct ConState {
  * This function is used to update the state of a button with a new value fetched
  * from a report. The function takes a pointer to a Button_t struct and a boolean
  * value to update the button with. The function then updates the button's pressed
- * value with the new value.
+ * value with the new value. If the value changed, it is published into the output
+ * frame.
  * 
  * @param button A pointer to the Button_t struct to update.
  * @param val The new value to update the button with.
+ * @param idx The index of the button in publish_controls.
+ * @param frame The output frame to append the message to.
 */
-void update_button(Button_t* button, bool val, bool publish);
+void update_button(Button_t* button, bool val, uint8_t idx, ConFrame_t* frame);
 
 /**
  * @brief Update the state of a joystick with new values fetched from a report.
  * 
  * This function is used to update the state of a joystick with new values fetched
- * from a report. The function takes a pointer to a Joystick_t struct and two float
+ * from a report. The function takes a pointer to a Joystick_t struct and two raw
  * values to update the joystick with. The function then updates the joystick's x
- * and y values with the new values.
+ * and y values with the new values. If either changed, the joystick is published
+ * into the output frame.
  * 
  * @param joystick A pointer to the Joystick_t struct to update.
- * @param x The new x value to update the joystick with.
- * @param y The new y value to update the joystick with.
+ * @param x The new raw x value to update the joystick with.
+ * @param y The new raw y value to update the joystick with.
+ * @param idx The index of the joystick in publish_controls.
+ * @param frame The output frame to append the message to.
 */
-void update_joystick(Joystick_t* joystick, float x, float y, bool publish);
+void update_joystick(Joystick_t* joystick, uint8_t x, uint8_t y, uint8_t idx,
+                     ConFrame_t* frame);
 
 /**
  * @brief Update the state of a trigger with a new value fetched from a report.
  * 
  * This function is used to update the state of a trigger with a new value fetched
- * from a report. The function takes a pointer to a Trigger_t struct and a float
+ * from a report. The function takes a pointer to a Trigger_t struct and a raw
  * value to update the trigger with. The function then updates the trigger's val
- * value with the new value.
+ * value with the new value. If the value changed, it is published into the
+ * output frame.
  * 
  * @param trigger A pointer to the Trigger_t struct to update.
- * @param val The new value to update the trigger with.
- * @param pressed The new pressed value to update the trigger with.
+ * @param val The new raw value to update the trigger with.
+ * @param idx The index of the trigger in publish_controls.
+ * @param frame The output frame to append the message to.
 */
-void update_trigger(Trigger_t* trigger, float val, bool publish);
+void update_trigger(Trigger_t* trigger, uint8_t val, uint8_t idx,
+                    ConFrame_t* frame);
 
 /**
  * @brief Update the state of a D-pad with a new value fetched from a report.
@@ -251,12 +400,15 @@ void update_trigger(Trigger_t* trigger, float val, bool publish);
  * This function is used to update the state of a D-pad with a new value fetched
  * from a report. The function takes a pointer to a DPad_t struct and a DPadDir_t
  * value to update the D-pad with. The function then updates the D-pad's dir value
- * with the new value.
+ * with the new value. If the direction changed, it is published into the output
+ * frame.
  * 
  * @param dpad A pointer to the DPad_t struct to update.
  * @param dir The new value to update the D-pad with.
+ * @param idx The index of the D-pad in publish_controls.
+ * @param frame The output frame to append the message to.
 */
-void update_dpad(DPad_t* dpad, DPadDir_t dir, bool publish);
+void update_dpad(DPad_t* dpad, DPadDir_t dir, uint8_t idx, ConFrame_t* frame);
 
 /**
  * @brief Initialize the controller state representation with default values.
@@ -277,12 +429,61 @@ void init_controller(ConState_t* state);
  * The function takes a pointer to a ConState_t struct and a pointer to a StadiaRep_t
  * struct to update the controller with. The function then updates the controller's
  * buttons, joysticks, triggers, and D-pad with the new values from the report.
+ * All messages published for the report are written to the UART at once.
  * 
  * @param state A pointer to the ConState_t struct to update.
  * @param rep A pointer to the StadiaRep_t struct to update the controller with.
 */
 void update_controller(ConState_t* state, StadiaRep_t* rep);
 
+/**
+ * @brief Update the state of a controller with a batch of reports.
+ * 
+ * This function is used to apply several reports received together, such as
+ * all the reports drained from the queue in one go. Every D-pad and button
+ * change is applied and published in report order, so no press or release is
+ * lost. Joysticks and triggers are only updated once, from the last report, so
+ * only their net change over the batch is published. The messages for the whole
+ * batch are written to the UART together.
+ * 
+ * @param state A pointer to the ConState_t struct to update.
+ * @param reps The reports to update the controller with, oldest first.
+ * @param count The number of reports in reps.
+*/
+void update_controller_batch(ConState_t* state, StadiaRep_t* reps,
+                             size_t count);
+
+/**
+ * @brief Publish a snapshot of the controller state.
+ * 
+ * This function is used in snapshot mode, where joystick and trigger changes
+ * are held until the next tick of the snapshot timer, and to answer snapshot
+ * requests in poll mode. Either every published control or only the controls
+ * held since the last snapshot are published, and the messages are written to
+ * the UART together. A snapshot of every published control is sent as a
+ * BIN_FRAME_SNAPSHOT frame with the binary output format. Nothing is sent
+ * while notifications are traced instead of the controller output.
+ * 
+ * @param state A pointer to the ConState_t struct to publish.
+ * @param changed_only True to only publish the controls held since the last
+ *                     snapshot, false to publish every control.
+*/
+void publish_snapshot(ConState_t* state, bool changed_only);
+
+/**
+ * @brief Publish the joysticks and triggers whose rate limit has expired.
+ * 
+ * A joystick or trigger that changes faster than its maximum publish rate
+ * allows is held, and its latest value is published by this function once its
+ * interval has passed. This guarantees the final value of a burst of changes
+ * is always published.
+ * 
+ * @param state A pointer to the ConState_t struct to publish.
+ * @return The number of microseconds until the next held control is due, or
+ *         -1 if no control is held.
+*/
+int64_t publish_held_controls(ConState_t* state);
+
 /**
  * @brief Print a controller state to the console for debugging puposes.
  * 
@@ -0,0 +1,95 @@
+/**
+ * @file    lat_hist.c
+ * @brief   Method implementations for the report pipeline latency histograms
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "lat_hist.h"
+#include "freertos/FreeRTOS.h"
+#include <stdio.h>
+#include <string.h>
+
+// The histogram of every stage
+static LatHist_t latHists[LAT_NUM_STAGES];
+
+// Guards latHists, recorded from the Bluetooth and report tasks while the UART
+// command task reads and clears them
+static portMUX_TYPE hist_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Name of every stage in the summaries
+static const char *const lat_stage_names[LAT_NUM_STAGES] = {
+    [LAT_LOAD]   = "LOAD",
+    [LAT_INSERT] = "INSERT",
+    [LAT_QUEUE]  = "QUEUE",
+    [LAT_DECODE] = "DECODE",
+    [LAT_FORMAT] = "FORMAT",
+    [LAT_WRITE]  = "WRITE",
+};
+
+void lat_hist_record(LatStage_t stage, uint32_t ticks) {
+    LatHist_t *hist = &latHists[stage];
+    // Bucket i holds [2^i, 2^(i+1)), with 0 counted in the first bucket
+    uint32_t bucket = ticks == 0 ? 0 : 31 - __builtin_clz(ticks);
+    taskENTER_CRITICAL(&hist_lock);
+    hist->buckets[bucket]++;
+    hist->count++;
+    if (ticks > hist->max) {
+        hist->max = ticks;
+    }
+    taskEXIT_CRITICAL(&hist_lock);
+}
+
+const LatHist_t *lat_hist_get(LatStage_t stage) {
+    return &latHists[stage];
+}
+
+uint32_t lat_hist_percentile(const LatHist_t* hist, uint32_t pct) {
+    if (hist->count == 0) {
+        return 0;
+    }
+    // The rank of the percentile, rounded up so p100 is the last measurement
+    uint64_t rank = ((uint64_t) hist->count * pct + 99) / 100;
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LAT_HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            uint32_t upper = i == 31 ? UINT32_MAX : (((uint32_t) 2 << i) - 1);
+            return upper < hist->max ? upper : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+size_t str_of_lat_hist(LatStage_t stage, char* buf, size_t len) {
+    // Summarized from a copy, so the count and buckets agree
+    taskENTER_CRITICAL(&hist_lock);
+    LatHist_t copy = latHists[stage];
+    taskEXIT_CRITICAL(&hist_lock);
+    const LatHist_t *hist = &copy;
+    uint32_t ticks_per_us = lat_hist_ticks_per_us();
+    // Durations are converted to nanoseconds for output
+    unsigned long p50 = (uint64_t) lat_hist_percentile(hist, 50) * 1000 /
+                        ticks_per_us;
+    unsigned long p99 = (uint64_t) lat_hist_percentile(hist, 99) * 1000 /
+                        ticks_per_us;
+    unsigned long max = (uint64_t) hist->max * 1000 / ticks_per_us;
+    int n = snprintf(buf, len, "HST;%s;%lu;%lu;%lu;%lu\n",
+                     lat_stage_names[stage], (unsigned long) hist->count,
+                     p50, p99, max);
+    if (n < 0) {
+        return 0;
+    }
+    return (size_t) n < len ? (size_t) n : len - 1;
+}
+
+void lat_hist_reset(void) {
+    taskENTER_CRITICAL(&hist_lock);
+    memset(latHists, 0, sizeof(latHists));
+    taskEXIT_CRITICAL(&hist_lock);
+}
@@ -0,0 +1,148 @@
+/**
+ * @file    lat_hist.h
+ * @brief   Latency histograms for each stage of the report pipeline.
+ * 
+ * Every stage between a notification arriving and its output being written to
+ * the UART can be timed, and each measurement is counted in a log2 histogram:
+ * bucket i counts the measurements from 2^i up to 2^(i+1) ticks. Ticks are CPU
+ * cycles on the ESP32, and nanoseconds of the monotonic clock on a host build.
+ * From the histogram the median, 99th percentile and maximum of each stage can
+ * be read at any time without storing individual measurements.
+ * 
+ * All instrumentation goes through the LAT_HIST_* macros, which compile to
+ * nothing unless LAT_HIST_ENABLED is set in globalconst.h.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef LAT_HIST_H
+#define LAT_HIST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "globalconst.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#else
+#include <time.h>
+#endif
+
+/**
+ * @brief The timed stages of the report pipeline.
+*/
+typedef enum LatStage {
+    LAT_LOAD,       // load_stadia_rep in the notification handler
+    LAT_INSERT,     // ingest_stadia_rep in the notification handler
+    LAT_QUEUE,      // Report arrival until taken from the queue
+    LAT_DECODE,     // update_controller, formatting included
+    LAT_FORMAT,     // Formatting or staging a single control
+    LAT_WRITE,      // uart_write_bytes
+    LAT_NUM_STAGES
+} LatStage_t;
+
+// Number of buckets in each histogram, enough for any 32 bit tick count
+#define LAT_HIST_BUCKETS 32
+
+/**
+ * @brief The histogram of one stage.
+*/
+typedef struct LatHist {
+    uint32_t buckets[LAT_HIST_BUCKETS]; // Measurements per power of two.
+    uint32_t count;                     // Number of measurements.
+    uint32_t max;                       // Longest measurement, in ticks.
+} LatHist_t;
+
+/**
+ * @brief Read the tick counter used for measurements.
+ * 
+ * @return The current tick count.
+*/
+static inline uint32_t lat_hist_now(void) {
+#ifdef ESP_PLATFORM
+    return esp_cpu_get_cycle_count();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t) ts.tv_sec * 1000000000u + (uint32_t) ts.tv_nsec;
+#endif
+}
+
+/**
+ * @brief The number of ticks in a microsecond.
+ * 
+ * @return The tick rate of lat_hist_now.
+*/
+static inline uint32_t lat_hist_ticks_per_us(void) {
+#ifdef ESP_PLATFORM
+    return esp_rom_get_cpu_ticks_per_us();
+#else
+    return 1000;
+#endif
+}
+
+/**
+ * @brief Count a measurement in the histogram of a stage.
+ * 
+ * Stages may be recorded from any task, and read and cleared from another.
+ * 
+ * @param stage The stage measured.
+ * @param ticks The duration of the stage in ticks.
+*/
+void lat_hist_record(LatStage_t stage, uint32_t ticks);
+
+/**
+ * @brief Get the histogram of a stage.
+ * 
+ * @param stage The stage.
+ * @return The histogram, updated live as measurements are recorded.
+*/
+const LatHist_t *lat_hist_get(LatStage_t stage);
+
+/**
+ * @brief Estimate a percentile of a histogram.
+ * 
+ * @param hist The histogram.
+ * @param pct The percentile, from 0 to 100.
+ * @return The upper bound in ticks of the bucket holding the percentile,
+ *         capped at the maximum measured, or 0 if the histogram is empty.
+*/
+uint32_t lat_hist_percentile(const LatHist_t* hist, uint32_t pct);
+
+/**
+ * @brief Write the summary of a stage's histogram.
+ * 
+ * The summary is in the format "HST;<STAGE>;<COUNT>;<P50>;<P99>;<MAX>\n" with
+ * the durations in nanoseconds.
+ * 
+ * @param stage The stage.
+ * @param buf The buffer to write the NUL terminated summary into.
+ * @param len The size of buf.
+ * @return The length of the summary, not counting the NUL.
+*/
+size_t str_of_lat_hist(LatStage_t stage, char* buf, size_t len);
+
+/**
+ * @brief Clear the histograms of every stage.
+*/
+void lat_hist_reset(void);
+
+#if LAT_HIST_ENABLED
+// Start timing a stage, declaring a variable holding the start tick
+#define LAT_HIST_START(name) uint32_t name = lat_hist_now()
+// Record the time since LAT_HIST_START for a stage
+#define LAT_HIST_END(stage, name) \
+    lat_hist_record((stage), lat_hist_now() - (name))
+// Record a duration measured in microseconds for a stage
+#define LAT_HIST_RECORD_US(stage, us) \
+    lat_hist_record((stage), (uint32_t) (us) * lat_hist_ticks_per_us())
+#else
+#define LAT_HIST_START(name)
+#define LAT_HIST_END(stage, name) ((void) 0)
+#define LAT_HIST_RECORD_US(stage, us) ((void) 0)
+#endif
+
+#endif /* #ifndef LAT_HIST_H */
@@ -0,0 +1,219 @@
+/**
+ * @file    pct_table.c
+ * @brief   Precomputed ASCII percentages for every raw joystick and trigger
+ *          value.
+ * 
+ * Each entry is what snprintf(buf, 6, "%.2f", pct) produces for the percentage
+ * of its index, computed in single precision as the controller state used to:
+ *  - sign_pct_str:     (float) ((int) val - 128) / 128.0 * 100.0
+ *  - neg_sign_pct_str: -sign_pct_str
+ *  - unsign_pct_str:   (float) val / 255.0 * 100.0
+ * host/test/pct_table_test.c checks every entry against that formatting.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "pct_table.h"
+
+const PctStr_t sign_pct_str[256] = {
+    {"-100.", 5},  {"-99.2", 5},  {"-98.4", 5},  {"-97.6", 5},
+    {"-96.8", 5},  {"-96.0", 5},  {"-95.3", 5},  {"-94.5", 5},
+    {"-93.7", 5},  {"-92.9", 5},  {"-92.1", 5},  {"-91.4", 5},
+    {"-90.6", 5},  {"-89.8", 5},  {"-89.0", 5},  {"-88.2", 5},
+    {"-87.5", 5},  {"-86.7", 5},  {"-85.9", 5},  {"-85.1", 5},
+    {"-84.3", 5},  {"-83.5", 5},  {"-82.8", 5},  {"-82.0", 5},
+    {"-81.2", 5},  {"-80.4", 5},  {"-79.6", 5},  {"-78.9", 5},
+    {"-78.1", 5},  {"-77.3", 5},  {"-76.5", 5},  {"-75.7", 5},
+    {"-75.0", 5},  {"-74.2", 5},  {"-73.4", 5},  {"-72.6", 5},
+    {"-71.8", 5},  {"-71.0", 5},  {"-70.3", 5},  {"-69.5", 5},
+    {"-68.7", 5},  {"-67.9", 5},  {"-67.1", 5},  {"-66.4", 5},
+    {"-65.6", 5},  {"-64.8", 5},  {"-64.0", 5},  {"-63.2", 5},
+    {"-62.5", 5},  {"-61.7", 5},  {"-60.9", 5},  {"-60.1", 5},
+    {"-59.3", 5},  {"-58.5", 5},  {"-57.8", 5},  {"-57.0", 5},
+    {"-56.2", 5},  {"-55.4", 5},  {"-54.6", 5},  {"-53.9", 5},
+    {"-53.1", 5},  {"-52.3", 5},  {"-51.5", 5},  {"-50.7", 5},
+    {"-50.0", 5},  {"-49.2", 5},  {"-48.4", 5},  {"-47.6", 5},
+    {"-46.8", 5},  {"-46.0", 5},  {"-45.3", 5},  {"-44.5", 5},
+    {"-43.7", 5},  {"-42.9", 5},  {"-42.1", 5},  {"-41.4", 5},
+    {"-40.6", 5},  {"-39.8", 5},  {"-39.0", 5},  {"-38.2", 5},
+    {"-37.5", 5},  {"-36.7", 5},  {"-35.9", 5},  {"-35.1", 5},
+    {"-34.3", 5},  {"-33.5", 5},  {"-32.8", 5},  {"-32.0", 5},
+    {"-31.2", 5},  {"-30.4", 5},  {"-29.6", 5},  {"-28.9", 5},
+    {"-28.1", 5},  {"-27.3", 5},  {"-26.5", 5},  {"-25.7", 5},
+    {"-25.0", 5},  {"-24.2", 5},  {"-23.4", 5},  {"-22.6", 5},
+    {"-21.8", 5},  {"-21.0", 5},  {"-20.3", 5},  {"-19.5", 5},
+    {"-18.7", 5},  {"-17.9", 5},  {"-17.1", 5},  {"-16.4", 5},
+    {"-15.6", 5},  {"-14.8", 5},  {"-14.0", 5},  {"-13.2", 5},
+    {"-12.5", 5},  {"-11.7", 5},  {"-10.9", 5},  {"-10.1", 5},
+    {"-9.38", 5},  {"-8.59", 5},  {"-7.81", 5},  {"-7.03", 5},
+    {"-6.25", 5},  {"-5.47", 5},  {"-4.69", 5},  {"-3.91", 5},
+    {"-3.12", 5},  {"-2.34", 5},  {"-1.56", 5},  {"-0.78", 5},
+    {"0.00", 4},   {"0.78", 4},   {"1.56", 4},   {"2.34", 4},
+    {"3.12", 4},   {"3.91", 4},   {"4.69", 4},   {"5.47", 4},
+    {"6.25", 4},   {"7.03", 4},   {"7.81", 4},   {"8.59", 4},
+    {"9.38", 4},   {"10.16", 5},  {"10.94", 5},  {"11.72", 5},
+    {"12.50", 5},  {"13.28", 5},  {"14.06", 5},  {"14.84", 5},
+    {"15.62", 5},  {"16.41", 5},  {"17.19", 5},  {"17.97", 5},
+    {"18.75", 5},  {"19.53", 5},  {"20.31", 5},  {"21.09", 5},
+    {"21.88", 5},  {"22.66", 5},  {"23.44", 5},  {"24.22", 5},
+    {"25.00", 5},  {"25.78", 5},  {"26.56", 5},  {"27.34", 5},
+    {"28.12", 5},  {"28.91", 5},  {"29.69", 5},  {"30.47", 5},
+    {"31.25", 5},  {"32.03", 5},  {"32.81", 5},  {"33.59", 5},
+    {"34.38", 5},  {"35.16", 5},  {"35.94", 5},  {"36.72", 5},
+    {"37.50", 5},  {"38.28", 5},  {"39.06", 5},  {"39.84", 5},
+    {"40.62", 5},  {"41.41", 5},  {"42.19", 5},  {"42.97", 5},
+    {"43.75", 5},  {"44.53", 5},  {"45.31", 5},  {"46.09", 5},
+    {"46.88", 5},  {"47.66", 5},  {"48.44", 5},  {"49.22", 5},
+    {"50.00", 5},  {"50.78", 5},  {"51.56", 5},  {"52.34", 5},
+    {"53.12", 5},  {"53.91", 5},  {"54.69", 5},  {"55.47", 5},
+    {"56.25", 5},  {"57.03", 5},  {"57.81", 5},  {"58.59", 5},
+    {"59.38", 5},  {"60.16", 5},  {"60.94", 5},  {"61.72", 5},
+    {"62.50", 5},  {"63.28", 5},  {"64.06", 5},  {"64.84", 5},
+    {"65.62", 5},  {"66.41", 5},  {"67.19", 5},  {"67.97", 5},
+    {"68.75", 5},  {"69.53", 5},  {"70.31", 5},  {"71.09", 5},
+    {"71.88", 5},  {"72.66", 5},  {"73.44", 5},  {"74.22", 5},
+    {"75.00", 5},  {"75.78", 5},  {"76.56", 5},  {"77.34", 5},
+    {"78.12", 5},  {"78.91", 5},  {"79.69", 5},  {"80.47", 5},
+    {"81.25", 5},  {"82.03", 5},  {"82.81", 5},  {"83.59", 5},
+    {"84.38", 5},  {"85.16", 5},  {"85.94", 5},  {"86.72", 5},
+    {"87.50", 5},  {"88.28", 5},  {"89.06", 5},  {"89.84", 5},
+    {"90.62", 5},  {"91.41", 5},  {"92.19", 5},  {"92.97", 5},
+    {"93.75", 5},  {"94.53", 5},  {"95.31", 5},  {"96.09", 5},
+    {"96.88", 5},  {"97.66", 5},  {"98.44", 5},  {"99.22", 5}
+};
+
+const PctStr_t neg_sign_pct_str[256] = {
+    {"100.0", 5},  {"99.22", 5},  {"98.44", 5},  {"97.66", 5},
+    {"96.88", 5},  {"96.09", 5},  {"95.31", 5},  {"94.53", 5},
+    {"93.75", 5},  {"92.97", 5},  {"92.19", 5},  {"91.41", 5},
+    {"90.62", 5},  {"89.84", 5},  {"89.06", 5},  {"88.28", 5},
+    {"87.50", 5},  {"86.72", 5},  {"85.94", 5},  {"85.16", 5},
+    {"84.38", 5},  {"83.59", 5},  {"82.81", 5},  {"82.03", 5},
+    {"81.25", 5},  {"80.47", 5},  {"79.69", 5},  {"78.91", 5},
+    {"78.12", 5},  {"77.34", 5},  {"76.56", 5},  {"75.78", 5},
+    {"75.00", 5},  {"74.22", 5},  {"73.44", 5},  {"72.66", 5},
+    {"71.88", 5},  {"71.09", 5},  {"70.31", 5},  {"69.53", 5},
+    {"68.75", 5},  {"67.97", 5},  {"67.19", 5},  {"66.41", 5},
+    {"65.62", 5},  {"64.84", 5},  {"64.06", 5},  {"63.28", 5},
+    {"62.50", 5},  {"61.72", 5},  {"60.94", 5},  {"60.16", 5},
+    {"59.38", 5},  {"58.59", 5},  {"57.81", 5},  {"57.03", 5},
+    {"56.25", 5},  {"55.47", 5},  {"54.69", 5},  {"53.91", 5},
+    {"53.12", 5},  {"52.34", 5},  {"51.56", 5},  {"50.78", 5},
+    {"50.00", 5},  {"49.22", 5},  {"48.44", 5},  {"47.66", 5},
+    {"46.88", 5},  {"46.09", 5},  {"45.31", 5},  {"44.53", 5},
+    {"43.75", 5},  {"42.97", 5},  {"42.19", 5},  {"41.41", 5},
+    {"40.62", 5},  {"39.84", 5},  {"39.06", 5},  {"38.28", 5},
+    {"37.50", 5},  {"36.72", 5},  {"35.94", 5},  {"35.16", 5},
+    {"34.38", 5},  {"33.59", 5},  {"32.81", 5},  {"32.03", 5},
+    {"31.25", 5},  {"30.47", 5},  {"29.69", 5},  {"28.91", 5},
+    {"28.12", 5},  {"27.34", 5},  {"26.56", 5},  {"25.78", 5},
+    {"25.00", 5},  {"24.22", 5},  {"23.44", 5},  {"22.66", 5},
+    {"21.88", 5},  {"21.09", 5},  {"20.31", 5},  {"19.53", 5},
+    {"18.75", 5},  {"17.97", 5},  {"17.19", 5},  {"16.41", 5},
+    {"15.62", 5},  {"14.84", 5},  {"14.06", 5},  {"13.28", 5},
+    {"12.50", 5},  {"11.72", 5},  {"10.94", 5},  {"10.16", 5},
+    {"9.38", 4},   {"8.59", 4},   {"7.81", 4},   {"7.03", 4},
+    {"6.25", 4},   {"5.47", 4},   {"4.69", 4},   {"3.91", 4},
+    {"3.12", 4},   {"2.34", 4},   {"1.56", 4},   {"0.78", 4},
+    {"-0.00", 5},  {"-0.78", 5},  {"-1.56", 5},  {"-2.34", 5},
+    {"-3.12", 5},  {"-3.91", 5},  {"-4.69", 5},  {"-5.47", 5},
+    {"-6.25", 5},  {"-7.03", 5},  {"-7.81", 5},  {"-8.59", 5},
+    {"-9.38", 5},  {"-10.1", 5},  {"-10.9", 5},  {"-11.7", 5},
+    {"-12.5", 5},  {"-13.2", 5},  {"-14.0", 5},  {"-14.8", 5},
+    {"-15.6", 5},  {"-16.4", 5},  {"-17.1", 5},  {"-17.9", 5},
+    {"-18.7", 5},  {"-19.5", 5},  {"-20.3", 5},  {"-21.0", 5},
+    {"-21.8", 5},  {"-22.6", 5},  {"-23.4", 5},  {"-24.2", 5},
+    {"-25.0", 5},  {"-25.7", 5},  {"-26.5", 5},  {"-27.3", 5},
+    {"-28.1", 5},  {"-28.9", 5},  {"-29.6", 5},  {"-30.4", 5},
+    {"-31.2", 5},  {"-32.0", 5},  {"-32.8", 5},  {"-33.5", 5},
+    {"-34.3", 5},  {"-35.1", 5},  {"-35.9", 5},  {"-36.7", 5},
+    {"-37.5", 5},  {"-38.2", 5},  {"-39.0", 5},  {"-39.8", 5},
+    {"-40.6", 5},  {"-41.4", 5},  {"-42.1", 5},  {"-42.9", 5},
+    {"-43.7", 5},  {"-44.5", 5},  {"-45.3", 5},  {"-46.0", 5},
+    {"-46.8", 5},  {"-47.6", 5},  {"-48.4", 5},  {"-49.2", 5},
+    {"-50.0", 5},  {"-50.7", 5},  {"-51.5", 5},  {"-52.3", 5},
+    {"-53.1", 5},  {"-53.9", 5},  {"-54.6", 5},  {"-55.4", 5},
+    {"-56.2", 5},  {"-57.0", 5},  {"-57.8", 5},  {"-58.5", 5},
+    {"-59.3", 5},  {"-60.1", 5},  {"-60.9", 5},  {"-61.7", 5},
+    {"-62.5", 5},  {"-63.2", 5},  {"-64.0", 5},  {"-64.8", 5},
+    {"-65.6", 5},  {"-66.4", 5},  {"-67.1", 5},  {"-67.9", 5},
+    {"-68.7", 5},  {"-69.5", 5},  {"-70.3", 5},  {"-71.0", 5},
+    {"-71.8", 5},  {"-72.6", 5},  {"-73.4", 5},  {"-74.2", 5},
+    {"-75.0", 5},  {"-75.7", 5},  {"-76.5", 5},  {"-77.3", 5},
+    {"-78.1", 5},  {"-78.9", 5},  {"-79.6", 5},  {"-80.4", 5},
+    {"-81.2", 5},  {"-82.0", 5},  {"-82.8", 5},  {"-83.5", 5},
+    {"-84.3", 5},  {"-85.1", 5},  {"-85.9", 5},  {"-86.7", 5},
+    {"-87.5", 5},  {"-88.2", 5},  {"-89.0", 5},  {"-89.8", 5},
+    {"-90.6", 5},  {"-91.4", 5},  {"-92.1", 5},  {"-92.9", 5},
+    {"-93.7", 5},  {"-94.5", 5},  {"-95.3", 5},  {"-96.0", 5},
+    {"-96.8", 5},  {"-97.6", 5},  {"-98.4", 5},  {"-99.2", 5}
+};
+
+const PctStr_t unsign_pct_str[256] = {
+    {"0.00", 4},   {"0.39", 4},   {"0.78", 4},   {"1.18", 4},
+    {"1.57", 4},   {"1.96", 4},   {"2.35", 4},   {"2.75", 4},
+    {"3.14", 4},   {"3.53", 4},   {"3.92", 4},   {"4.31", 4},
+    {"4.71", 4},   {"5.10", 4},   {"5.49", 4},   {"5.88", 4},
+    {"6.27", 4},   {"6.67", 4},   {"7.06", 4},   {"7.45", 4},
+    {"7.84", 4},   {"8.24", 4},   {"8.63", 4},   {"9.02", 4},
+    {"9.41", 4},   {"9.80", 4},   {"10.20", 5},  {"10.59", 5},
+    {"10.98", 5},  {"11.37", 5},  {"11.76", 5},  {"12.16", 5},
+    {"12.55", 5},  {"12.94", 5},  {"13.33", 5},  {"13.73", 5},
+    {"14.12", 5},  {"14.51", 5},  {"14.90", 5},  {"15.29", 5},
+    {"15.69", 5},  {"16.08", 5},  {"16.47", 5},  {"16.86", 5},
+    {"17.25", 5},  {"17.65", 5},  {"18.04", 5},  {"18.43", 5},
+    {"18.82", 5},  {"19.22", 5},  {"19.61", 5},  {"20.00", 5},
+    {"20.39", 5},  {"20.78", 5},  {"21.18", 5},  {"21.57", 5},
+    {"21.96", 5},  {"22.35", 5},  {"22.75", 5},  {"23.14", 5},
+    {"23.53", 5},  {"23.92", 5},  {"24.31", 5},  {"24.71", 5},
+    {"25.10", 5},  {"25.49", 5},  {"25.88", 5},  {"26.27", 5},
+    {"26.67", 5},  {"27.06", 5},  {"27.45", 5},  {"27.84", 5},
+    {"28.24", 5},  {"28.63", 5},  {"29.02", 5},  {"29.41", 5},
+    {"29.80", 5},  {"30.20", 5},  {"30.59", 5},  {"30.98", 5},
+    {"31.37", 5},  {"31.76", 5},  {"32.16", 5},  {"32.55", 5},
+    {"32.94", 5},  {"33.33", 5},  {"33.73", 5},  {"34.12", 5},
+    {"34.51", 5},  {"34.90", 5},  {"35.29", 5},  {"35.69", 5},
+    {"36.08", 5},  {"36.47", 5},  {"36.86", 5},  {"37.25", 5},
+    {"37.65", 5},  {"38.04", 5},  {"38.43", 5},  {"38.82", 5},
+    {"39.22", 5},  {"39.61", 5},  {"40.00", 5},  {"40.39", 5},
+    {"40.78", 5},  {"41.18", 5},  {"41.57", 5},  {"41.96", 5},
+    {"42.35", 5},  {"42.75", 5},  {"43.14", 5},  {"43.53", 5},
+    {"43.92", 5},  {"44.31", 5},  {"44.71", 5},  {"45.10", 5},
+    {"45.49", 5},  {"45.88", 5},  {"46.27", 5},  {"46.67", 5},
+    {"47.06", 5},  {"47.45", 5},  {"47.84", 5},  {"48.24", 5},
+    {"48.63", 5},  {"49.02", 5},  {"49.41", 5},  {"49.80", 5},
+    {"50.20", 5},  {"50.59", 5},  {"50.98", 5},  {"51.37", 5},
+    {"51.76", 5},  {"52.16", 5},  {"52.55", 5},  {"52.94", 5},
+    {"53.33", 5},  {"53.73", 5},  {"54.12", 5},  {"54.51", 5},
+    {"54.90", 5},  {"55.29", 5},  {"55.69", 5},  {"56.08", 5},
+    {"56.47", 5},  {"56.86", 5},  {"57.25", 5},  {"57.65", 5},
+    {"58.04", 5},  {"58.43", 5},  {"58.82", 5},  {"59.22", 5},
+    {"59.61", 5},  {"60.00", 5},  {"60.39", 5},  {"60.78", 5},
+    {"61.18", 5},  {"61.57", 5},  {"61.96", 5},  {"62.35", 5},
+    {"62.75", 5},  {"63.14", 5},  {"63.53", 5},  {"63.92", 5},
+    {"64.31", 5},  {"64.71", 5},  {"65.10", 5},  {"65.49", 5},
+    {"65.88", 5},  {"66.27", 5},  {"66.67", 5},  {"67.06", 5},
+    {"67.45", 5},  {"67.84", 5},  {"68.24", 5},  {"68.63", 5},
+    {"69.02", 5},  {"69.41", 5},  {"69.80", 5},  {"70.20", 5},
+    {"70.59", 5},  {"70.98", 5},  {"71.37", 5},  {"71.76", 5},
+    {"72.16", 5},  {"72.55", 5},  {"72.94", 5},  {"73.33", 5},
+    {"73.73", 5},  {"74.12", 5},  {"74.51", 5},  {"74.90", 5},
+    {"75.29", 5},  {"75.69", 5},  {"76.08", 5},  {"76.47", 5},
+    {"76.86", 5},  {"77.25", 5},  {"77.65", 5},  {"78.04", 5},
+    {"78.43", 5},  {"78.82", 5},  {"79.22", 5},  {"79.61", 5},
+    {"80.00", 5},  {"80.39", 5},  {"80.78", 5},  {"81.18", 5},
+    {"81.57", 5},  {"81.96", 5},  {"82.35", 5},  {"82.75", 5},
+    {"83.14", 5},  {"83.53", 5},  {"83.92", 5},  {"84.31", 5},
+    {"84.71", 5},  {"85.10", 5},  {"85.49", 5},  {"85.88", 5},
+    {"86.27", 5},  {"86.67", 5},  {"87.06", 5},  {"87.45", 5},
+    {"87.84", 5},  {"88.24", 5},  {"88.63", 5},  {"89.02", 5},
+    {"89.41", 5},  {"89.80", 5},  {"90.20", 5},  {"90.59", 5},
+    {"90.98", 5},  {"91.37", 5},  {"91.76", 5},  {"92.16", 5},
+    {"92.55", 5},  {"92.94", 5},  {"93.33", 5},  {"93.73", 5},
+    {"94.12", 5},  {"94.51", 5},  {"94.90", 5},  {"95.29", 5},
+    {"95.69", 5},  {"96.08", 5},  {"96.47", 5},  {"96.86", 5},
+    {"97.25", 5},  {"97.65", 5},  {"98.04", 5},  {"98.43", 5},
+    {"98.82", 5},  {"99.22", 5},  {"99.61", 5},  {"100.0", 5}
+};
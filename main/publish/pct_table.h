@@ -0,0 +1,52 @@
+/**
+ * @file    pct_table.h
+ * @brief   Precomputed ASCII percentages for every raw joystick and trigger
+ *          value.
+ * 
+ * The output format shows stick and trigger positions as percentages printed
+ * with "%.2f" and cut to 5 characters. Since the controller only reports 8 bit
+ * values there are only 256 possible strings per axis type, so they are
+ * computed once ahead of time instead of with float math on every message.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef PCT_TABLE_H
+#define PCT_TABLE_H
+
+#include <stdint.h>
+
+// Longest percentage string, e.g. "-100." or "33.59"
+#define PCT_STR_MAX_LEN 5
+
+/**
+ * @brief A percentage in ASCII and its length.
+ * 
+ * The string is not NUL terminated when it is PCT_STR_MAX_LEN long.
+*/
+typedef struct PctStr {
+    char str[PCT_STR_MAX_LEN]; // The characters of the percentage.
+    uint8_t len;               // The number of characters used in str.
+} PctStr_t;
+
+/**
+ * Raw stick value to signed percentage, with 128 as 0%:
+ * (val - 128) / 128 * 100. Used for the x axis of both sticks.
+*/
+extern const PctStr_t sign_pct_str[256];
+
+/**
+ * Raw stick value to the negated signed percentage. The stick y axis reports
+ * down as positive, so it is flipped to make up positive. Note that the center
+ * value prints as "-0.00".
+*/
+extern const PctStr_t neg_sign_pct_str[256];
+
+/**
+ * Raw trigger value to unsigned percentage, with 0 as 0%: val / 255 * 100.
+*/
+extern const PctStr_t unsign_pct_str[256];
+
+#endif /* #ifndef PCT_TABLE_H */
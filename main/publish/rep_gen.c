@@ -0,0 +1,194 @@
+/**
+ * @file    rep_gen.c
+ * @brief   Method implementations for the synthetic report generator
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "rep_gen.h"
+
+#include <string.h>
+
+// Raw value of a centered stick axis and of a released D-pad
+#define GEN_CENTER   0x80
+#define GEN_DPAD_OFF 0x08
+
+// Face buttons in the second button byte: A, B, X and Y
+static const uint8_t face_buttons[4] = {0x40, 0x20, 0x10, 0x08};
+
+// First quarter of a sine wave of amplitude 127, sampled at 65 points
+static const uint8_t quarter_sine[65] = {
+      0,   3,   6,   9,  12,  16,  19,  22,  25,  28,  31,  34,  37,  40,
+     43,  46,  49,  51,  54,  57,  60,  63,  65,  68,  71,  73,  76,  78,
+     81,  83,  85,  88,  90,  92,  94,  96,  98, 100, 102, 104, 106, 107,
+    109, 111, 112, 113, 115, 116, 117, 118, 120, 121, 122, 122, 123, 124,
+    125, 125, 126, 126, 126, 127, 127, 127, 127,
+};
+
+/**
+ * @brief Integer sine.
+ * 
+ * @param phase The angle, 256 steps per turn.
+ * @return The sine of the angle scaled to -127 to 127.
+*/
+static int sine(uint8_t phase) {
+    uint8_t quarter = phase >> 6;
+    uint8_t step = phase & 0x3F;
+    int val = quarter_sine[(quarter & 1) ? 64 - step : step];
+    return quarter & 2 ? -val : val;
+}
+
+/**
+ * @brief Advance the xorshift32 random generator.
+ * 
+ * @param gen The generator.
+ * @return The next pseudo random number.
+*/
+static uint32_t next_rand(RepGen_t* gen) {
+    uint32_t x = gen->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    gen->rng = x;
+    return x;
+}
+
+/**
+ * @brief Pick the scenario of a new segment by the configured weights.
+ * 
+ * @param gen The generator.
+*/
+static void pick_scenario(RepGen_t* gen) {
+    uint32_t total = 0;
+    for (int i = 0; i < REP_GEN_NUM_SCENARIOS; i++) {
+        total += gen->cfg.weights[i];
+    }
+    gen->scenario = REP_GEN_REST;
+    if (total == 0) {
+        return;
+    }
+    uint32_t pick = next_rand(gen) % total;
+    for (int i = 0; i < REP_GEN_NUM_SCENARIOS; i++) {
+        if (pick < gen->cfg.weights[i]) {
+            gen->scenario = i;
+            return;
+        }
+        pick -= gen->cfg.weights[i];
+    }
+}
+
+/**
+ * @brief Release every control of a report.
+ * 
+ * @param rep The report.
+*/
+static void rest_rep(StadiaRep_t* rep) {
+    rep->dpad = GEN_DPAD_OFF;
+    rep->buttons1 = 0;
+    rep->buttons2 = 0;
+    rep->stickX = GEN_CENTER;
+    rep->stickY = GEN_CENTER;
+    rep->stickZ = GEN_CENTER;
+    rep->stickRz = GEN_CENTER;
+    rep->brake = 0;
+    rep->throttle = 0;
+    rep->volume = 0;
+}
+
+void rep_gen_default_cfg(RepGenCfg_t* cfg, uint32_t seed) {
+    cfg->seed = seed;
+    cfg->interval_us = 10000;
+    cfg->segment_ms = 2000;
+    for (int i = 0; i < REP_GEN_NUM_SCENARIOS; i++) {
+        cfg->weights[i] = 1;
+    }
+    cfg->period_ms = 1000;
+    cfg->mash_hz = 8;
+}
+
+void rep_gen_init(RepGen_t* gen, const RepGenCfg_t* cfg) {
+    memset(gen, 0, sizeof(*gen));
+    gen->cfg = *cfg;
+    if (gen->cfg.period_ms == 0) {
+        gen->cfg.period_ms = 1;
+    }
+    // xorshift never leaves 0, so 0 is swapped for a fixed seed
+    gen->rng = cfg->seed ? cfg->seed : 0x9E3779B9;
+    rest_rep(&gen->rep);
+    pick_scenario(gen);
+}
+
+void rep_gen_next(RepGen_t* gen, StadiaRep_t* rep) {
+    gen->now_us += gen->cfg.interval_us;
+    gen->segment_us += gen->cfg.interval_us;
+    if (gen->segment_us >= gen->cfg.segment_ms * 1000) {
+        gen->segment_us = 0;
+        pick_scenario(gen);
+        rest_rep(&gen->rep);
+    }
+    StadiaRep_t *out = &gen->rep;
+    // Position within the current cycle, 256 steps per cycle
+    uint32_t period_us = gen->cfg.period_ms * 1000;
+    uint8_t phase = (uint64_t) (gen->segment_us % period_us) * 256 / period_us;
+    uint32_t rnd = next_rand(gen);
+
+    switch (gen->scenario) {
+        case REP_GEN_REST:
+            // Each axis flickers one count off center now and then
+            out->stickX = GEN_CENTER + ((rnd & 0x07) == 0) - ((rnd & 0x38) == 0);
+            out->stickY = GEN_CENTER + ((rnd & 0x1C0) == 0);
+            out->stickZ = GEN_CENTER - ((rnd & 0xE00) == 0);
+            out->stickRz = GEN_CENTER + ((rnd & 0x7000) == 0);
+            break;
+        case REP_GEN_SWEEP: {
+            // A triangle wave over the full travel of the axis
+            int tri = phase < 128 ? phase * 2 : (255 - phase) * 2;
+            out->stickX = tri;
+            out->stickY = GEN_CENTER;
+            out->stickZ = GEN_CENTER;
+            out->stickRz = 255 - tri;
+            break;
+        }
+        case REP_GEN_CIRCLE:
+            out->stickX = GEN_CENTER + sine(phase + 64);
+            out->stickY = GEN_CENTER + sine(phase);
+            out->stickZ = GEN_CENTER + sine(phase + 64);
+            out->stickRz = GEN_CENTER - sine(phase);
+            break;
+        case REP_GEN_RAMP: {
+            int tri = phase < 128 ? phase * 2 : (255 - phase) * 2;
+            out->brake = tri;
+            out->throttle = 255 - tri;
+            break;
+        }
+        case REP_GEN_MASH: {
+            // Each press holds a button for the first half of its period
+            uint32_t press_us = gen->cfg.mash_hz ? 1000000 / gen->cfg.mash_hz
+                                                 : UINT32_MAX;
+            uint32_t press = gen->segment_us / press_us;
+            bool down = gen->segment_us % press_us < press_us / 2;
+            out->buttons2 = down ? face_buttons[press % 4] : 0;
+            out->dpad = (press / 4) % 9;
+            break;
+        }
+        default:
+            break;
+    }
+    out->stamp_us = (uint32_t) gen->now_us;
+    *rep = *out;
+}
+
+void rep_gen_raw(const StadiaRep_t* rep, uint8_t* buffer) {
+    buffer[0] = rep->dpad;
+    buffer[1] = rep->buttons1;
+    buffer[2] = rep->buttons2;
+    buffer[3] = rep->stickX;
+    buffer[4] = rep->stickY;
+    buffer[5] = rep->stickZ;
+    buffer[6] = rep->stickRz;
+    buffer[7] = rep->brake;
+    buffer[8] = rep->throttle;
+    buffer[9] = rep->volume;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file    rep_gen.h
+ * @brief   Generator of synthetic controller reports for load and soak tests.
+ * 
+ * The generator plays a mix of scenarios that resemble a player on the pad:
+ *  - REST: sticks centered and triggers released, with the one count flicker
+ *    a resting Stadia pad shows on its stick axes.
+ *  - SWEEP: both sticks sweep smoothly from one end of an axis to the other
+ *    and back, the left stick horizontally and the right stick vertically.
+ *  - CIRCLE: both sticks turn full circles at the edge of their travel, in
+ *    opposite directions.
+ *  - RAMP: both triggers are pressed in and released at an even speed.
+ *  - MASH: the face buttons are hammered at a set number of presses per
+ *    second while the D-pad rolls around.
+ * Play is split into segments of a fixed length, and each segment runs one
+ * scenario picked at random with the weights of the configuration. All
+ * randomness comes from a seeded xorshift generator and all motion from
+ * integer arithmetic, so the same configuration always produces the same
+ * reports on the host and on the target.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef REP_GEN_H
+#define REP_GEN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rep_queue.h"
+
+/**
+ * @brief The scenarios the generator can play.
+*/
+typedef enum RepGenScenario {
+    REP_GEN_REST,    // Resting pad with stick jitter
+    REP_GEN_SWEEP,   // Smooth stick sweeps
+    REP_GEN_CIRCLE,  // Circular stick motion
+    REP_GEN_RAMP,    // Trigger ramps
+    REP_GEN_MASH,    // Button mashing
+    REP_GEN_NUM_SCENARIOS
+} RepGenScenario_t;
+
+/**
+ * @brief The configuration of a generator.
+*/
+typedef struct RepGenCfg {
+    uint32_t seed;          // Seed of the random generator, 0 is replaced.
+    uint32_t interval_us;   // Time between two reports.
+    uint32_t segment_ms;    // Length of each scenario segment.
+    uint8_t weights[REP_GEN_NUM_SCENARIOS]; // Relative share of segments per
+                                            // scenario. All 0 plays REST.
+    uint32_t period_ms;     // Time for one sweep, circle or ramp cycle.
+    uint16_t mash_hz;       // Button presses per second when mashing.
+} RepGenCfg_t;
+
+/**
+ * @brief The state of a generator.
+*/
+typedef struct RepGen {
+    RepGenCfg_t cfg;            // The configuration.
+    uint32_t rng;               // State of the random generator.
+    RepGenScenario_t scenario;  // Scenario of the current segment.
+    uint32_t segment_us;        // Time into the current segment.
+    uint64_t now_us;            // Time of the last report.
+    StadiaRep_t rep;            // The last report.
+} RepGen_t;
+
+/**
+ * @brief Fill in the default configuration: a 100 Hz report rate, an even mix
+ *        of every scenario in 2 second segments, 1 second cycles and 8 presses
+ *        per second.
+ * 
+ * @param cfg The configuration to fill in.
+ * @param seed The seed of the random generator.
+*/
+void rep_gen_default_cfg(RepGenCfg_t* cfg, uint32_t seed);
+
+/**
+ * @brief Start a generator.
+ * 
+ * @param gen The generator.
+ * @param cfg Its configuration, copied into the generator.
+*/
+void rep_gen_init(RepGen_t* gen, const RepGenCfg_t* cfg);
+
+/**
+ * @brief Generate the next report.
+ * 
+ * @param gen The generator.
+ * @param rep Set to the report. Its stamp_us is the generator's time, which
+ *            starts at 0 and advances by interval_us per report.
+*/
+void rep_gen_next(RepGen_t* gen, StadiaRep_t* rep);
+
+/**
+ * @brief Write a report in the byte layout of a controller notification, the
+ *        inverse of load_stadia_rep.
+ * 
+ * @param rep The report.
+ * @param buffer The buffer to write into, STADIA_REP_LEN bytes.
+*/
+void rep_gen_raw(const StadiaRep_t* rep, uint8_t* buffer);
+
+#endif /* #ifndef REP_GEN_H */
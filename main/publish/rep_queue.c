@@ -13,38 +13,48 @@
 
 #include "rep_queue.h"
 
-#include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
-#include "freeRTOS/FreeRTOS.h"
-#include "freeRTOS/semphr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
 
-// Synchronize access to the queue
-SemaphoreHandle_t repQueueMutex;
+// The clock reports are timestamped with
+static RepClock_t repClock = esp_timer_get_time;
 
-StadiaRep_t *load_stadia_rep(uint8_t* buffer, size_t len) {
+// Backing storage for the report queue. There is only ever one queue, so it
+// lives in static memory rather than on the heap.
+static RepQueue_t repQueueStorage;
+
+bool load_stadia_rep(StadiaRep_t *rep, const uint8_t *buffer, size_t len) {
     // Expexted length of controller report is 10 bytes
-    if (len != 10) {
-        return NULL;
-    }
-    StadiaRep_t *newRep = malloc(sizeof(StadiaRep_t));
-    if (newRep == NULL) {
-        return NULL;
+    if (len != STADIA_REP_LEN) {
+        return false;
     }
-    newRep->dpad = buffer[0];
-    newRep->buttons1 = buffer[1];
-    newRep->buttons2 = buffer[2];
-    newRep->stickX = buffer[3];
-    newRep->stickY = buffer[4];
-    newRep->stickZ = buffer[5];
-    newRep->stickRz = buffer[6];
-    newRep->brake = buffer[7];
-    newRep->throttle = buffer[8];
-    newRep->volume = buffer[9];
-    return newRep;
+    rep->dpad = buffer[0];
+    rep->buttons1 = buffer[1];
+    rep->buttons2 = buffer[2];
+    rep->stickX = buffer[3];
+    rep->stickY = buffer[4];
+    rep->stickZ = buffer[5];
+    rep->stickRz = buffer[6];
+    rep->brake = buffer[7];
+    rep->throttle = buffer[8];
+    rep->volume = buffer[9];
+    return true;
 }
 
-void print_stadia_rep(StadiaRep_t* rep) {
+void set_rep_clock(RepClock_t clock) {
+    repClock = clock != NULL ? clock : esp_timer_get_time;
+}
+
+int64_t rep_clock_us(void) {
+    return repClock();
+}
+
+void print_stadia_rep(const StadiaRep_t *rep) {
     printf("Dpad: %x\n", rep->dpad);
     printf("Buttons1: %x\n", rep->buttons1);
     printf("Buttons2: %x\n", rep->buttons2);
@@ -55,66 +65,291 @@ void print_stadia_rep(StadiaRep_t* rep) {
     printf("Brake: %x\n", rep->brake);
     printf("Throttle: %x\n", rep->throttle);
     printf("Volume: %x\n", rep->volume);
+    printf("Stamp: %lu us\n", (unsigned long) rep->stamp_us);
 }
 
-RepQueue_t *create_stadia_rep_queue() {
-    RepQueue_t *newQueue = malloc(sizeof(RepQueue_t));
-    if (newQueue == NULL) {
+RepQueue_t *create_stadia_rep_queue(TaskHandle_t consumer, size_t capacity,
+                                    RepQueuePolicy_t policy,
+                                    TickType_t block_ticks) {
+    // Capacity must be a non-zero power of two that fits the storage
+    if (capacity == 0 || capacity > REP_QUEUE_MAX_CAPACITY ||
+        (capacity & (capacity - 1)) != 0) {
         return NULL;
     }
-    repQueueMutex = xSemaphoreCreateMutex();
-    if (repQueueMutex == NULL) {
-        free(newQueue);
-        return NULL;
+    RepQueue_t *newQueue = &repQueueStorage;
+    if (policy == REP_QUEUE_BLOCK && newQueue->space == NULL) {
+        newQueue->space = xSemaphoreCreateBinary();
+        if (newQueue->space == NULL) {
+            return NULL;
+        }
     }
-    newQueue->head = NULL;
-    newQueue->tail = NULL;
-    newQueue->size = 0;
+    atomic_init(&newQueue->head, 0);
+    atomic_init(&newQueue->tail, 0);
+    atomic_init(&newQueue->waiting, false);
+    newQueue->mask = capacity - 1;
+    newQueue->policy = policy;
+    newQueue->block_ticks = block_ticks;
+    newQueue->consumer = consumer;
+    newQueue->pending_lock = (portMUX_TYPE) portMUX_INITIALIZER_UNLOCKED;
+    set_rep_queue_conflation(newQueue, false);
+    reset_rep_queue_stats(newQueue);
     return newQueue;
 }
 
-void insert_stadia_rep(RepQueue_t *queue, StadiaRep_t *rep) {
-    xSemaphoreTake(repQueueMutex, portMAX_DELAY);
-    RepQueueElement_t *newElement = malloc(sizeof(RepQueueElement_t));
-    if (newElement == NULL) {
-        xSemaphoreGive(repQueueMutex);
-        return;
+/**
+ * @brief Wait for the consumer to free a slot in a full queue.
+ * 
+ * @param queue The queue to wait on.
+ * @param tail The producer's current tail index.
+ * @return true if there is room in the queue, false if the wait timed out.
+*/
+static bool wait_for_space(RepQueue_t *queue, uint32_t tail) {
+    TickType_t start = xTaskGetTickCount();
+    while (1) {
+        // Announce the wait before re-checking so a dequeue in between is
+        // guaranteed to give the semaphore
+        atomic_store(&queue->waiting, true);
+        uint32_t head = atomic_load(&queue->head);
+        if (tail - head <= queue->mask) {
+            atomic_store(&queue->waiting, false);
+            return true;
+        }
+        TickType_t waited = xTaskGetTickCount() - start;
+        if (waited >= queue->block_ticks ||
+            xSemaphoreTake(queue->space, queue->block_ticks - waited) != pdTRUE) {
+            atomic_store(&queue->waiting, false);
+            return false;
+        }
+    }
+}
+
+/**
+ * @brief Copy a report into the ring, applying the overflow policy.
+ * 
+ * Does not notify the consumer or count the report as enqueued.
+ * 
+ * @param queue The queue to insert into.
+ * @param rep The StadiaRep to insert.
+ * @param may_block False to treat REP_QUEUE_BLOCK as REP_QUEUE_DROP_NEWEST,
+ *                  for callers inside a critical section.
+ * @return true if the report was inserted, false if it was dropped.
+*/
+static bool push_rep(RepQueue_t *queue, const StadiaRep_t *rep,
+                     bool may_block) {
+    // Only the producer writes tail, so a relaxed load is enough. The acquire
+    // on head pairs with the consumer's release once it is done with a slot.
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail - head > queue->mask) {
+        switch (queue->policy) {
+            case REP_QUEUE_DROP_OLDEST:
+                // Step head past the oldest report. If the consumer claimed it
+                // first there is room already and nothing is lost.
+                if (atomic_compare_exchange_strong(&queue->head, &head,
+                                                   head + 1)) {
+                    atomic_fetch_add_explicit(&queue->dropped, 1,
+                                              memory_order_relaxed);
+                }
+                break;
+            case REP_QUEUE_BLOCK:
+                if (may_block && wait_for_space(queue, tail)) {
+                    break;
+                }
+                // Timed out, drop the new report
+                // fall through
+            case REP_QUEUE_DROP_NEWEST:
+            default:
+                atomic_fetch_add_explicit(&queue->dropped, 1,
+                                          memory_order_relaxed);
+                return false;
+        }
+        head = atomic_load_explicit(&queue->head, memory_order_acquire);
     }
-    newElement->rep = rep;
-    newElement->next = NULL;
-    if (queue->size == 0) {
-        queue->head = newElement;
-        queue->tail = newElement;
-    } else {
-        queue->tail->next = newElement;
-        queue->tail = newElement;
+    queue->buf[tail & queue->mask] = *rep;
+    // Publish the slot to the consumer
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    uint32_t pending = tail + 1 - head;
+    if (pending > atomic_load_explicit(&queue->high_water,
+                                       memory_order_relaxed)) {
+        atomic_store_explicit(&queue->high_water, pending,
+                              memory_order_relaxed);
     }
-    queue->size++;
-    xSemaphoreGive(repQueueMutex);
-    xSemaphoreGive(repSem);
+    return true;
 }
 
-StadiaRep_t *dequeue_stadia_rep(RepQueue_t *queue) {
-    xSemaphoreTake(repQueueMutex, portMAX_DELAY);
-    if (queue->size == 0) {
-        xSemaphoreGive(repQueueMutex);
-        return NULL;
+bool insert_stadia_rep(RepQueue_t *queue, const StadiaRep_t *rep) {
+    if (!push_rep(queue, rep, true)) {
+        return false;
+    }
+    atomic_fetch_add_explicit(&queue->enqueued, 1, memory_order_relaxed);
+    xTaskNotify(queue->consumer, REP_QUEUE_NOTIFY_BIT, eSetBits);
+    return true;
+}
+
+void set_rep_queue_conflation(RepQueue_t *queue, bool enable) {
+    queue->conflate = enable;
+    queue->has_pending = false;
+    queue->has_last = false;
+}
+
+/**
+ * @brief Check whether two reports differ in any D-pad or button bit.
+ * 
+ * @param a The first report.
+ * @param b The second report.
+ * @return true if a press or release happened between the two reports.
+*/
+static bool has_digital_edge(const StadiaRep_t *a, const StadiaRep_t *b) {
+    return a->dpad != b->dpad || a->buttons1 != b->buttons1 ||
+           a->buttons2 != b->buttons2;
+}
+
+bool ingest_stadia_rep(RepQueue_t *queue, const StadiaRep_t *rep) {
+    // Identical consecutive reports carry nothing new
+    if (queue->has_last && memcmp(&queue->last, rep, STADIA_REP_LEN) == 0) {
+        atomic_fetch_add_explicit(&queue->duplicates, 1, memory_order_relaxed);
+        return false;
+    }
+    queue->last = *rep;
+    queue->has_last = true;
+    if (!queue->conflate) {
+        return insert_stadia_rep(queue, rep);
+    }
+    taskENTER_CRITICAL(&queue->pending_lock);
+    if (queue->has_pending && !has_digital_edge(&queue->pending, rep)) {
+        // Only analog values moved, keep the latest ones
+        atomic_fetch_add_explicit(&queue->conflated, 1, memory_order_relaxed);
+    } else if (queue->has_pending) {
+        // Keep the state before the edge as its own report. This happens in
+        // the critical section so the consumer cannot take the new pending
+        // report ahead of it.
+        push_rep(queue, &queue->pending, false);
+    }
+    queue->pending = *rep;
+    queue->has_pending = true;
+    taskEXIT_CRITICAL(&queue->pending_lock);
+    atomic_fetch_add_explicit(&queue->enqueued, 1, memory_order_relaxed);
+    xTaskNotify(queue->consumer, REP_QUEUE_NOTIFY_BIT, eSetBits);
+    return true;
+}
+
+/**
+ * @brief Take the pending conflated report if the ring is empty.
+ * 
+ * @param queue The queue to take the report from.
+ * @param rep The StadiaRep to copy the pending report into.
+ * @return true if a report was taken, false otherwise.
+*/
+static bool take_pending(RepQueue_t *queue, StadiaRep_t *rep) {
+    bool taken = false;
+    taskENTER_CRITICAL(&queue->pending_lock);
+    // The producer may have pushed into the ring since it was found empty.
+    // Those reports are older than the pending one and must go first.
+    if (queue->has_pending &&
+        atomic_load_explicit(&queue->head, memory_order_acquire) ==
+        atomic_load_explicit(&queue->tail, memory_order_acquire)) {
+        *rep = queue->pending;
+        queue->has_pending = false;
+        taken = true;
+    }
+    taskEXIT_CRITICAL(&queue->pending_lock);
+    return taken;
+}
+
+bool dequeue_stadia_rep(RepQueue_t *queue, StadiaRep_t *rep) {
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    while (1) {
+        uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        if (head == tail) {
+            if (queue->conflate && take_pending(queue, rep)) {
+                return true;
+            }
+            if (atomic_load_explicit(&queue->tail, memory_order_acquire) ==
+                tail) {
+                return false;
+            }
+            // The producer pushed an edge report while the pending slot was
+            // checked, go back and take it from the ring
+            head = atomic_load_explicit(&queue->head, memory_order_acquire);
+            continue;
+        }
+        *rep = queue->buf[head & queue->mask];
+        // Claim the slot. This only fails if the producer dropped the report
+        // while it was being copied, in which case the copy is discarded and
+        // the next oldest report is tried.
+        if (atomic_compare_exchange_weak_explicit(&queue->head, &head, head + 1,
+                                                  memory_order_acq_rel,
+                                                  memory_order_acquire)) {
+            break;
+        }
     }
-    RepQueueElement_t *element = queue->head;
-    StadiaRep_t *rep = element->rep;
-    queue->head = element->next;
-    free(element);
-    queue->size--;
-    xSemaphoreGive(repQueueMutex);
-    return rep;
+    // Wake the producer if it is blocked waiting for room
+    if (atomic_load(&queue->waiting) &&
+        atomic_exchange(&queue->waiting, false)) {
+        xSemaphoreGive(queue->space);
+    }
+    return true;
+}
+
+size_t dequeue_stadia_rep_batch(RepQueue_t *queue, StadiaRep_t out[],
+                                size_t max) {
+    size_t count = 0;
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    while (max > 0) {
+        uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        count = tail - head < max ? tail - head : max;
+        for (size_t i = 0; i < count; i++) {
+            out[i] = queue->buf[(head + i) & queue->mask];
+        }
+        // Claim the whole run at once. As in dequeue_stadia_rep this only
+        // fails if the producer dropped the oldest report during the copy.
+        if (atomic_compare_exchange_weak_explicit(&queue->head, &head,
+                                                  head + count,
+                                                  memory_order_acq_rel,
+                                                  memory_order_acquire)) {
+            break;
+        }
+    }
+    if (count > 0 && atomic_load(&queue->waiting) &&
+        atomic_exchange(&queue->waiting, false)) {
+        xSemaphoreGive(queue->space);
+    }
+    // The pending conflated report is newer than anything in the ring. If the
+    // producer pushed more edges meanwhile it is left for the next batch.
+    if (queue->conflate && count < max && take_pending(queue, &out[count])) {
+        count++;
+    }
+    return count;
+}
+
+void get_rep_queue_stats(RepQueue_t *queue, RepQueueStats_t *stats) {
+    stats->enqueued = atomic_load_explicit(&queue->enqueued,
+                                           memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&queue->dropped,
+                                          memory_order_relaxed);
+    stats->high_water = atomic_load_explicit(&queue->high_water,
+                                             memory_order_relaxed);
+    stats->conflated = atomic_load_explicit(&queue->conflated,
+                                            memory_order_relaxed);
+    stats->duplicates = atomic_load_explicit(&queue->duplicates,
+                                             memory_order_relaxed);
+}
+
+void reset_rep_queue_stats(RepQueue_t *queue) {
+    atomic_store(&queue->enqueued, 0);
+    atomic_store(&queue->dropped, 0);
+    atomic_store(&queue->high_water, 0);
+    atomic_store(&queue->conflated, 0);
+    atomic_store(&queue->duplicates, 0);
 }
 
 void print_rep_queue(RepQueue_t *queue) {
-    xSemaphoreTake(repQueueMutex, portMAX_DELAY);
-    RepQueueElement_t *current = queue->head;
-    while (current != NULL) {
-        print_stadia_rep(current->rep);
-        current = current->next;
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    for (uint32_t i = head; i != tail; i++) {
+        print_stadia_rep(&queue->buf[i & queue->mask]);
+    }
+    if (queue->conflate && queue->has_pending) {
+        print_stadia_rep(&queue->pending);
     }
-    xSemaphoreGive(repQueueMutex);
 }
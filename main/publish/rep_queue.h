@@ -16,12 +16,12 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "freertos/semphr.h"
 
-// Load in the global counting sempahore for the report queue
-extern SemaphoreHandle_t repSem;
-
 /**
  * STADIA HID REPORT STRUCTURE
  * The HID report from the Stadia controller is a 10 byte sequence. The bytes 
@@ -38,8 +38,15 @@ extern SemaphoreHandle_t repSem;
  *  - Byte 10: 3 bits for volume, play/pause, 5 bits of padding. (Used when a
  *             headset is connected directly to the controller. Not used in this
  *             project.)
+ * 
+ * The report is followed by the time it arrived, which is not part of the HID
+ * report. Comparisons between reports only look at the first STADIA_REP_LEN
+ * bytes.
 */
 
+// Length of the HID report from the controller
+#define STADIA_REP_LEN 10
+
 typedef struct StadiaRep {
     uint8_t dpad;
     uint8_t buttons1;
@@ -51,46 +58,115 @@ typedef struct StadiaRep {
     uint8_t brake;
     uint8_t throttle;
     uint8_t volume;
+    uint32_t stamp_us; // Arrival time from rep_clock_us, truncated to 32 bits
 } StadiaRep_t;
 
+/**
+ * @brief A clock returning the time in microseconds.
+*/
+typedef int64_t (*RepClock_t)(void);
+
+/**
+ * @brief Replace the clock used to timestamp reports and time the output.
+ * 
+ * Lets a host build drive the whole pipeline from a deterministic clock.
+ * 
+ * @param clock The clock to use, or NULL to restore esp_timer_get_time.
+*/
+void set_rep_clock(RepClock_t clock);
+
+/**
+ * @brief Read the clock used to timestamp reports and time the output.
+ * 
+ * @return The current time in microseconds.
+*/
+int64_t rep_clock_us(void);
+
 /**
  * @brief Load a StadiaRep from a buffer.
  * 
  * @param rep The StadiaRep to load into.
  * @param buffer The buffer to load from.
  * @param len The length of the buffer.
- * @return a pointer to the StadiaRep if successful, NULL otherwise.
+ * @return true if the buffer held a valid report, false otherwise.
 */
-StadiaRep_t *load_stadia_rep(uint8_t* buffer, size_t len);
+bool load_stadia_rep(StadiaRep_t *rep, const uint8_t *buffer, size_t len);
 
 /**
  * @brief Print a StadiaRep to the console for debugging.
  * 
  * @param rep A pointer to the StadiaRep to print.
 */
-void print_stadia_rep(StadiaRep_t* rep);
+void print_stadia_rep(const StadiaRep_t *rep);
+
+// Maximum number of report slots in the queue. The storage is statically
+// allocated at this size; the capacity actually used is set at creation.
+#define REP_QUEUE_MAX_CAPACITY 256
+
+// Notification bit set on the consumer task when a report is inserted
+#define REP_QUEUE_NOTIFY_BIT (1u << 0)
 
 /**
- * @brief A queue element for a queue of stadia reports.
- * 
- * This struct is used to store a StadiaRep and a pointer to the next element
- * in the queue.
+ * @brief What to do with a new report when the queue is full.
+*/
+typedef enum RepQueuePolicy {
+    REP_QUEUE_DROP_OLDEST, // Discard the oldest queued report to make room.
+    REP_QUEUE_DROP_NEWEST, // Discard the incoming report.
+    REP_QUEUE_BLOCK        // Wait up to a timeout for room, then drop newest.
+} RepQueuePolicy_t;
+
+/**
+ * @brief Counters describing the traffic through a RepQueue.
 */
-typedef struct RepQueueElement {
-    StadiaRep_t *rep;
-    struct RepQueueElement *next;
-} RepQueueElement_t;
+typedef struct RepQueueStats {
+    uint32_t enqueued;   // Reports inserted into the queue.
+    uint32_t dropped;    // Reports discarded by the overflow policy.
+    uint32_t high_water; // Largest number of reports pending at once.
+    uint32_t conflated;  // Reports merged into a newer report at ingress.
+    uint32_t duplicates; // Reports identical to the previous one, discarded.
+} RepQueueStats_t;
 
 /*
  * @brief A queue of Stadia reports.
  * 
- * This struct is used to store a queue of Stadia reports. The queue is a 
- * singly linked list of StadiaQueueElements.
+ * This struct is a bounded single-producer/single-consumer ring of Stadia
+ * reports stored by value. The producer (the Bluedroid callback) only writes
+ * tail and the consumer only writes head, so no lock is needed. Both indices
+ * run freely and are reduced modulo the capacity on access. The one exception
+ * is the drop-oldest policy, where the producer advances head past the report
+ * it discards; for that reason the consumer claims each slot with a
+ * compare-and-swap on head and retries if the producer got there first. The
+ * consumer task is woken with a direct task notification on every insert.
+ * 
+ * With conflation enabled, reports enter through ingest_stadia_rep, which
+ * holds the newest report in a single pending slot instead of the ring. Newer
+ * reports with the same D-pad and button bits overwrite the analog values in
+ * the pending slot; a report that changes any of those bits first pushes the
+ * pending slot into the ring, so every press and release edge is delivered.
+ * The ring then only grows with edges and a lagging consumer always sees the
+ * latest stick and trigger positions.
 */
 typedef struct RepQueue {
-    RepQueueElement_t *head;
-    RepQueueElement_t *tail;
-    size_t size;
+    StadiaRep_t buf[REP_QUEUE_MAX_CAPACITY];
+    atomic_uint_least32_t head;  // Index of the next report to dequeue
+    atomic_uint_least32_t tail;  // Index of the next free slot
+    uint32_t mask;               // Capacity - 1, capacity is a power of two
+    RepQueuePolicy_t policy;     // Overflow policy
+    TickType_t block_ticks;      // Producer wait limit for REP_QUEUE_BLOCK
+    SemaphoreHandle_t space;     // Given by the consumer to a blocked producer
+    atomic_bool waiting;         // Set while the producer waits for room
+    TaskHandle_t consumer;       // Task notified when a report is inserted
+    atomic_uint_least32_t enqueued;   // Statistics, written by the producer
+    atomic_uint_least32_t dropped;
+    atomic_uint_least32_t high_water;
+    atomic_uint_least32_t conflated;
+    atomic_uint_least32_t duplicates;
+    bool conflate;               // Merge reports at ingress
+    portMUX_TYPE pending_lock;   // Guards the pending slot
+    StadiaRep_t pending;         // Newest merged report when conflating
+    bool has_pending;            // True if pending holds a report
+    StadiaRep_t last;            // Last report accepted at ingress
+    bool has_last;               // True if last holds a report
 } RepQueue_t;
 
 // The global report queue
@@ -99,25 +175,97 @@ extern RepQueue_t *repQueue;
 /**
  * @brief Create a new StadiaQueue.
  * 
- * @return a pointer to the new StadiaQueue.
+ * The queue storage is statically allocated, so this only resets it.
+ * 
+ * @param consumer The task to notify when a new report is inserted.
+ * @param capacity The number of reports the queue can hold. Must be a power
+ *                 of two no larger than REP_QUEUE_MAX_CAPACITY.
+ * @param policy What to do with a new report when the queue is full.
+ * @param block_ticks How long the producer may wait for room under
+ *                    REP_QUEUE_BLOCK. Ignored by the other policies.
+ * @return a pointer to the new StadiaQueue, NULL if the parameters are invalid.
 */
-RepQueue_t *create_stadia_rep_queue();
+RepQueue_t *create_stadia_rep_queue(TaskHandle_t consumer, size_t capacity,
+                                    RepQueuePolicy_t policy,
+                                    TickType_t block_ticks);
 
 /**
  * @brief Insert a StadiaRep into the queue.
  * 
+ * When the queue is full the queue's overflow policy decides the outcome. Only
+ * REP_QUEUE_BLOCK can block. Must only be called from the single producer.
+ * 
+ * @param queue The queue to insert into.
+ * @param rep The StadiaRep to insert. It is copied into the queue.
+ * @return true if the report was inserted, false if it was dropped.
+*/
+bool insert_stadia_rep(RepQueue_t *queue, const StadiaRep_t *rep);
+
+/**
+ * @brief Enable or disable report conflation at ingress.
+ * 
+ * Must be called before the producer starts inserting reports.
+ * 
+ * @param queue The queue to configure.
+ * @param enable True to merge reports at ingress, false to queue every report.
+*/
+void set_rep_queue_conflation(RepQueue_t *queue, bool enable);
+
+/**
+ * @brief Pass a newly received StadiaRep into the queue.
+ * 
+ * This is the ingress stage used by the Bluetooth callback. A report identical
+ * to the previous one is discarded. If conflation is enabled the report is
+ * merged with the pending report as described for RepQueue_t, otherwise it is
+ * inserted as with insert_stadia_rep. Must only be called from the single
+ * producer.
+ * 
  * @param queue The queue to insert into.
- * @param rep The StadiaRep to insert.
+ * @param rep The StadiaRep to insert. It is copied into the queue.
+ * @return true if the report was accepted, false if it was discarded.
 */
-void insert_stadia_rep(RepQueue_t *queue, StadiaRep_t *rep);
+bool ingest_stadia_rep(RepQueue_t *queue, const StadiaRep_t *rep);
 
 /**
  * @brief Dequeue a StadiaRep from the queue.
  * 
+ * Never blocks. Must only be called from the single consumer.
+ * 
  * @param queue The queue to remove from.
- * @return a pointer to the StadiaRep that was removed.
+ * @param rep The StadiaRep to copy the removed report into.
+ * @return true if a report was removed, false if the queue was empty.
+*/
+bool dequeue_stadia_rep(RepQueue_t *queue, StadiaRep_t *rep);
+
+/**
+ * @brief Dequeue every pending StadiaRep from the queue, up to a limit.
+ * 
+ * All reports in the ring are claimed with a single update of head, so the
+ * synchronization cost is paid once per batch instead of once per report.
+ * Never blocks. Must only be called from the single consumer.
+ * 
+ * @param queue The queue to remove from.
+ * @param out The array to copy the removed reports into, oldest first.
+ * @param max The number of entries in out.
+ * @return the number of reports removed.
+*/
+size_t dequeue_stadia_rep_batch(RepQueue_t *queue, StadiaRep_t out[],
+                                size_t max);
+
+/**
+ * @brief Read the traffic counters of a RepQueue.
+ * 
+ * @param queue The queue to read the counters of.
+ * @param stats The struct to copy the counters into.
+*/
+void get_rep_queue_stats(RepQueue_t *queue, RepQueueStats_t *stats);
+
+/**
+ * @brief Reset the traffic counters of a RepQueue to zero.
+ * 
+ * @param queue The queue to reset the counters of.
 */
-StadiaRep_t *dequeue_stadia_rep(RepQueue_t *queue);
+void reset_rep_queue_stats(RepQueue_t *queue);
 
 /**
  * @brief Print a RepQueue to the console for debugging.
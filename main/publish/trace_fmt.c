@@ -0,0 +1,149 @@
+/**
+ * @file    trace_fmt.c
+ * @brief   Encoding and parsing of raw notification traces.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "trace_fmt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Hex digits of the ASCII trace lines
+static const char hex_digits[] = "0123456789ABCDEF";
+
+void trace_rec_of_notify(TraceRec_t* rec, uint32_t stamp_us,
+                         const uint8_t* value, size_t len) {
+    rec->stamp_us = stamp_us;
+    rec->len = len > UINT8_MAX ? UINT8_MAX : len;
+    size_t kept = len < TRACE_PAYLOAD_LEN ? len : TRACE_PAYLOAD_LEN;
+    memcpy(rec->payload, value, kept);
+    memset(rec->payload + kept, 0, TRACE_PAYLOAD_LEN - kept);
+}
+
+size_t trace_put_header(uint8_t* buf) {
+    memcpy(buf, "STRC", 4);
+    buf[4] = TRACE_VERSION;
+    buf[5] = TRACE_PAYLOAD_LEN;
+    buf[6] = 0;
+    buf[7] = 0;
+    return TRACE_HEADER_LEN;
+}
+
+bool trace_check_header(const uint8_t* buf, size_t len) {
+    return len >= TRACE_HEADER_LEN && memcmp(buf, "STRC", 4) == 0 &&
+           buf[4] == TRACE_VERSION && buf[5] == TRACE_PAYLOAD_LEN;
+}
+
+size_t trace_put_rec(const TraceRec_t* rec, uint8_t* buf) {
+    buf[0] = rec->stamp_us & 0xFF;
+    buf[1] = (rec->stamp_us >> 8) & 0xFF;
+    buf[2] = (rec->stamp_us >> 16) & 0xFF;
+    buf[3] = rec->stamp_us >> 24;
+    buf[4] = rec->len;
+    memcpy(buf + 5, rec->payload, TRACE_PAYLOAD_LEN);
+    return TRACE_REC_LEN;
+}
+
+void trace_get_rec(const uint8_t* buf, TraceRec_t* rec) {
+    rec->stamp_us = buf[0] | (uint32_t) buf[1] << 8 |
+                    (uint32_t) buf[2] << 16 | (uint32_t) buf[3] << 24;
+    rec->len = buf[4];
+    memcpy(rec->payload, buf + 5, TRACE_PAYLOAD_LEN);
+}
+
+/**
+ * @brief Write an unsigned number in decimal.
+ * 
+ * @param val The number.
+ * @param buf The buffer to write into, at least 10 bytes.
+ * @return The number of digits written.
+*/
+static size_t put_dec(uint32_t val, char* buf) {
+    char digits[10];
+    size_t count = 0;
+    do {
+        digits[count++] = '0' + val % 10;
+        val /= 10;
+    } while (val > 0);
+    for (size_t i = 0; i < count; i++) {
+        buf[i] = digits[count - 1 - i];
+    }
+    return count;
+}
+
+size_t str_of_trace_rec(const TraceRec_t* rec, char* buf) {
+    // Trace messages are in the format "TRC;US;LEN;HEX\n"
+    size_t len = 0;
+    memcpy(buf, "TRC;", 4);
+    len += 4;
+    len += put_dec(rec->stamp_us, buf + len);
+    buf[len++] = ';';
+    len += put_dec(rec->len, buf + len);
+    buf[len++] = ';';
+    for (size_t i = 0; i < TRACE_PAYLOAD_LEN; i++) {
+        buf[len++] = hex_digits[rec->payload[i] >> 4];
+        buf[len++] = hex_digits[rec->payload[i] & 0x0F];
+    }
+    buf[len++] = '\n';
+    return len;
+}
+
+/**
+ * @brief Parse one hex digit.
+ * 
+ * @param c The character.
+ * @return The value of the digit, or -1 if c is not a hex digit.
+*/
+static int hex_val(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+bool trace_rec_of_str(const char* line, TraceRec_t* rec) {
+    if (strncmp(line, "TRC;", 4) != 0 || line[4] < '0' || line[4] > '9') {
+        return false;
+    }
+    char *end;
+    unsigned long stamp = strtoul(line + 4, &end, 10);
+    if (*end != ';' || stamp > UINT32_MAX || end[1] < '0' || end[1] > '9') {
+        return false;
+    }
+    unsigned long len = strtoul(end + 1, &end, 10);
+    if (*end != ';' || len > UINT8_MAX) {
+        return false;
+    }
+    const char *hex = end + 1;
+    for (size_t i = 0; i < TRACE_PAYLOAD_LEN; i++) {
+        int hi = hex_val(hex[2 * i]);
+        int lo = hi < 0 ? -1 : hex_val(hex[2 * i + 1]);
+        if (lo < 0) {
+            return false;
+        }
+        rec->payload[i] = hi << 4 | lo;
+    }
+    const char *rest = hex + 2 * TRACE_PAYLOAD_LEN;
+    if (*rest == '\r') {
+        rest++;
+    }
+    if (*rest == '\n') {
+        rest++;
+    }
+    if (*rest != '\0') {
+        return false;
+    }
+    rec->stamp_us = stamp;
+    rec->len = len;
+    return true;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file    trace_fmt.h
+ * @brief   Format of raw notification traces.
+ * 
+ * A trace records every notification the controller sent, as it arrived, so
+ * a session can be replayed through the publish pipeline later. A trace file
+ * is a TRACE_HEADER_LEN byte header followed by TRACE_REC_LEN byte records:
+ *  - header: the 4 bytes "STRC", 1 byte format version (TRACE_VERSION), 1 byte
+ *    payload size (TRACE_PAYLOAD_LEN) and 2 reserved 0 bytes.
+ *  - record: 4 bytes little endian arrival time in microseconds (the report's
+ *    stamp_us, wrapping every ~71 minutes), 1 byte length of the notification
+ *    as received, and TRACE_PAYLOAD_LEN bytes holding its first bytes, padded
+ *    with 0. The length lets malformed notifications be replayed as well.
+ * 
+ * The firmware sends one record per notification when output_trace is set.
+ * With the ASCII output a record is the line "TRC;<US>;<LEN>;<HEX>\n", HEX
+ * being the payload as 20 upper case hex digits. With the binary output it is
+ * a BIN_FRAME_TRACE frame: the frame type, the record bytes and the CRC, COBS
+ * encoded like every other frame (see bin_proto.h). The host trace_capture
+ * tool turns either stream into a trace file.
+ * 
+ * This file is shared with the host side tools.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef TRACE_FMT_H
+#define TRACE_FMT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Version of the trace file format
+#define TRACE_VERSION 1
+
+// Size of the trace file header
+#define TRACE_HEADER_LEN 8
+
+// Notification bytes kept per record, the size of a controller report
+#define TRACE_PAYLOAD_LEN 10
+
+// Size of one record: arrival time, length and payload
+#define TRACE_REC_LEN (4 + 1 + TRACE_PAYLOAD_LEN)
+
+// Longest ASCII trace line, "TRC;<US>;<LEN>;<HEX>\n"
+#define TRACE_LINE_MAX_LEN (4 + 10 + 1 + 3 + 1 + 2 * TRACE_PAYLOAD_LEN + 1)
+
+/**
+ * @brief One traced notification.
+*/
+typedef struct TraceRec {
+    uint32_t stamp_us;                  // Arrival time in microseconds.
+    uint8_t len;                        // Length of the notification.
+    uint8_t payload[TRACE_PAYLOAD_LEN]; // Its first bytes, padded with 0.
+} TraceRec_t;
+
+/**
+ * @brief Fill in a record from a received notification.
+ * 
+ * @param rec The record to fill in.
+ * @param stamp_us The arrival time of the notification.
+ * @param value The notification bytes.
+ * @param len The length of the notification. Lengths above 255 are saturated.
+*/
+void trace_rec_of_notify(TraceRec_t* rec, uint32_t stamp_us,
+                         const uint8_t* value, size_t len);
+
+/**
+ * @brief Write the trace file header.
+ * 
+ * @param buf The buffer to write into, at least TRACE_HEADER_LEN bytes.
+ * @return TRACE_HEADER_LEN.
+*/
+size_t trace_put_header(uint8_t* buf);
+
+/**
+ * @brief Check a trace file header.
+ * 
+ * @param buf The start of the file.
+ * @param len The number of bytes in buf.
+ * @return true if buf starts with a header of this version.
+*/
+bool trace_check_header(const uint8_t* buf, size_t len);
+
+/**
+ * @brief Write a record in its binary form.
+ * 
+ * @param rec The record.
+ * @param buf The buffer to write into, at least TRACE_REC_LEN bytes.
+ * @return TRACE_REC_LEN.
+*/
+size_t trace_put_rec(const TraceRec_t* rec, uint8_t* buf);
+
+/**
+ * @brief Read a record from its binary form.
+ * 
+ * @param buf The TRACE_REC_LEN bytes of the record.
+ * @param rec The record to fill in.
+*/
+void trace_get_rec(const uint8_t* buf, TraceRec_t* rec);
+
+/**
+ * @brief Write a record as an ASCII trace line.
+ * 
+ * @param rec The record.
+ * @param buf The buffer to write into, at least TRACE_LINE_MAX_LEN bytes.
+ * @return The length of the line, which is not NUL terminated.
+*/
+size_t str_of_trace_rec(const TraceRec_t* rec, char* buf);
+
+/**
+ * @brief Parse an ASCII trace line.
+ * 
+ * @param line The NUL terminated line, with or without its '\n'.
+ * @param rec The record to fill in.
+ * @return true if the line is a valid trace line.
+*/
+bool trace_rec_of_str(const char* line, TraceRec_t* rec);
+
+#endif /* #ifndef TRACE_FMT_H */
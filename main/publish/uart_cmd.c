@@ -0,0 +1,335 @@
+/**
+ * @file    uart_cmd.c
+ * @brief   Method implementations for the UART command channel
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#include "uart_cmd.h"
+#include "bin_proto.h"
+#include "lat_hist.h"
+#include "ble/rate_mon.h"
+#include "globalconst.h"
+#include "driver/uart.h"
+#include "esp_log.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+// Stack size and priority of the command task
+#define UART_CMD_STACK_SIZE 3072
+#define UART_CMD_PRIORITY   1
+
+// Identifier of every control, indexed like publish_controls
+static const char control_ids[CON_NUM_CONTROLS][4] = {
+    "DPD", "RSB", "OPT", "MEN", "STB", "RTB", "LTB", "GAS", "CPT", "LAB",
+    "LBB", "LXB", "LYB", "LBP", "RBP", "LSB", "LJS", "RJS", "LTR", "RTR",
+};
+
+/**
+ * @brief Find a control by its identifier.
+ * 
+ * @param id The identifier, e.g. "LJS".
+ * @return The index of the control, or -1 if there is none.
+*/
+static int find_control(const char* id) {
+    for (int idx = 0; idx < CON_NUM_CONTROLS; idx++) {
+        if (strcmp(id, control_ids[idx]) == 0) {
+            return idx;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Check whether a control is a joystick or a trigger.
+ * 
+ * @param idx The index of the control, or -1.
+ * @return true for a joystick or trigger.
+*/
+static inline bool is_analog(int idx) {
+    return idx >= CON_LJS && idx <= CON_RTR;
+}
+
+/**
+ * @brief Parse a decimal number no larger than a maximum.
+ * 
+ * @param str The NUL terminated field to parse.
+ * @param max The largest value accepted.
+ * @param val Set to the parsed number on success.
+ * @return true if the field is a number no larger than max.
+*/
+static bool parse_num(const char* str, unsigned long max, unsigned long* val) {
+    char *end;
+    if (str == NULL || *str < '0' || *str > '9') {
+        return false;
+    }
+    *val = strtoul(str, &end, 10);
+    return *end == '\0' && *val <= max;
+}
+
+bool exec_uart_cmd(char* line) {
+    // Split the line into its ';' separated fields
+    char *fields[5] = {NULL};
+    size_t count = 0;
+    char *save;
+    for (char *tok = strtok_r(line, ";", &save); tok != NULL;
+         tok = strtok_r(NULL, ";", &save)) {
+        if (count == 5) {
+            return false;
+        }
+        fields[count++] = tok;
+    }
+    if (count == 0) {
+        return false;
+    }
+
+    unsigned long a, b;
+    if (strcmp(fields[0], "SUB") == 0 && count == 3) {
+        // SUB;<ID>;<0|1>
+        if (!parse_num(fields[2], 1, &a)) {
+            return false;
+        }
+        if (strcmp(fields[1], "ALL") == 0) {
+            for (int idx = 0; idx < CON_NUM_CONTROLS; idx++) {
+                publish_controls[idx] = a;
+            }
+            return true;
+        }
+        int idx = find_control(fields[1]);
+        if (idx < 0) {
+            return false;
+        }
+        publish_controls[idx] = a;
+        return true;
+    } else if (strcmp(fields[0], "THR") == 0 && count == 4) {
+        // THR;<ID>;<DZ>;<DELTA>
+        int idx = find_control(fields[1]);
+        if (!is_analog(idx) || !parse_num(fields[2], UINT8_MAX, &a) ||
+            !parse_num(fields[3], UINT8_MAX, &b)) {
+            return false;
+        }
+        control_deadzone[idx] = a;
+        control_min_delta[idx] = b;
+        return true;
+    } else if (strcmp(fields[0], "RTE") == 0 && count == 3) {
+        // RTE;<ID>;<HZ>
+        int idx = find_control(fields[1]);
+        if (!is_analog(idx) || !parse_num(fields[2], UINT16_MAX, &a)) {
+            return false;
+        }
+        control_max_rate_hz[idx] = a;
+        return true;
+    } else if (strcmp(fields[0], "FMT") == 0 && count == 2) {
+        // FMT;<ASC|BIN>
+        if (strcmp(fields[1], "ASC") == 0) {
+            output_format = OUTPUT_ASCII;
+        } else if (strcmp(fields[1], "BIN") == 0) {
+            output_format = OUTPUT_BINARY;
+        } else {
+            return false;
+        }
+        return true;
+    } else if (strcmp(fields[0], "MOD") == 0 && count == 2) {
+        // MOD;<PSH|POL>
+        if (strcmp(fields[1], "PSH") == 0) {
+            output_mode = OUTPUT_PUSH;
+        } else if (strcmp(fields[1], "POL") == 0) {
+            output_mode = OUTPUT_POLL;
+        } else {
+            return false;
+        }
+        return true;
+    } else if (strcmp(fields[0], "SEQ") == 0 && count == 2) {
+        // SEQ;<0|1>
+        if (!parse_num(fields[1], 1, &a)) {
+            return false;
+        }
+        output_sequence = a;
+        return true;
+    } else if (strcmp(fields[0], "TSU") == 0 && count == 2) {
+        // TSU;<NON|ING|LAT>
+        if (strcmp(fields[1], "NON") == 0) {
+            output_stamp = STAMP_NONE;
+        } else if (strcmp(fields[1], "ING") == 0) {
+            output_stamp = STAMP_INGRESS;
+        } else if (strcmp(fields[1], "LAT") == 0) {
+            output_stamp = STAMP_LATENCY;
+        } else {
+            return false;
+        }
+        return true;
+    } else if (strcmp(fields[0], "TRC") == 0 && count == 2) {
+        // TRC;<OFF|ALS|ONL>
+        if (strcmp(fields[1], "OFF") == 0) {
+            output_trace = TRACE_OFF;
+        } else if (strcmp(fields[1], "ALS") == 0) {
+            output_trace = TRACE_ALSO;
+        } else if (strcmp(fields[1], "ONL") == 0) {
+            output_trace = TRACE_ONLY;
+        } else {
+            return false;
+        }
+        return true;
+    } else if (strcmp(fields[0], "HST") == 0 && count <= 2) {
+        // HST to dump the latency histograms, HST;RST to clear them. The
+        // summaries are text, so they are only sent with the ASCII output.
+        if (!LAT_HIST_ENABLED) {
+            return false;
+        }
+        if (count == 2) {
+            if (strcmp(fields[1], "RST") != 0) {
+                return false;
+            }
+            lat_hist_reset();
+            return true;
+        }
+        if (output_format != OUTPUT_ASCII) {
+            return false;
+        }
+        char msg[64];
+        for (int stage = 0; stage < LAT_NUM_STAGES; stage++) {
+            uart_write_bytes(uart_num, msg,
+                             str_of_lat_hist(stage, msg, sizeof(msg)));
+        }
+        return true;
+    } else if (strcmp(fields[0], "RAT") == 0 && count <= 2) {
+        // RAT to dump the report rate statistics, RAT;RST to clear them
+        if (count == 2) {
+            if (strcmp(fields[1], "RST") != 0) {
+                return false;
+            }
+            rate_mon_clear();
+            return true;
+        }
+        if (output_format != OUTPUT_ASCII) {
+            return false;
+        }
+        char msg[96];
+        uart_write_bytes(uart_num, msg, str_of_rate_mon(msg, sizeof(msg)));
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Write the answer to a command to the UART port.
+ * 
+ * @param cmd The first field of the command.
+ * @param ok True if the command was applied.
+*/
+static void reply_uart_cmd(const char* cmd, bool ok) {
+    if (output_format == OUTPUT_BINARY) {
+        // Binary answers carry the publish mask in effect after the command
+        uint32_t mask = 0;
+        for (int idx = 0; idx < CON_NUM_CONTROLS; idx++) {
+            mask |= (uint32_t) publish_controls[idx] << idx;
+        }
+        uint8_t raw[1 + BIN_MASK_LEN + BIN_CRC_LEN];
+        raw[0] = ok ? BIN_FRAME_ACK : BIN_FRAME_NAK;
+        raw[1] = mask & 0xFF;
+        raw[2] = (mask >> 8) & 0xFF;
+        raw[3] = (mask >> 16) & 0xFF;
+        uint16_t crc = crc16_ccitt(raw, 1 + BIN_MASK_LEN);
+        raw[4] = crc & 0xFF;
+        raw[5] = crc >> 8;
+        uint8_t frame[sizeof(raw) + 2];
+        uart_write_bytes(uart_num, frame, cobs_encode(raw, sizeof(raw), frame));
+        return;
+    }
+    // ASCII answers are "ACK;<CMD>\n" or "NAK;<CMD>\n"
+    char msg[4 + 4 + 1];
+    size_t len = 0;
+    memcpy(msg, ok ? "ACK;" : "NAK;", 4);
+    len += 4;
+    size_t cmd_len = strlen(cmd);
+    memcpy(msg + len, cmd, cmd_len);
+    len += cmd_len;
+    msg[len++] = '\n';
+    uart_write_bytes(uart_num, msg, len);
+}
+
+// The event queue of the UART port and the task answering snapshot requests
+static QueueHandle_t cmd_queue;
+static TaskHandle_t cmd_publisher;
+
+/**
+ * @brief Task reading command lines from the UART port and applying them.
+ * 
+ * @param arg Unused.
+*/
+static void uart_cmd_task(void* arg) {
+    QueueHandle_t uart_queue = cmd_queue;
+    char line[UART_CMD_MAX_LEN + 1];
+    size_t len = 0;
+    bool overflow = false;
+    uint8_t data[64];
+    uart_event_t event;
+    while (1) {
+        if (!xQueueReceive(uart_queue, &event, portMAX_DELAY)) {
+            continue;
+        }
+        if (event.type == UART_FIFO_OVF || event.type == UART_BUFFER_FULL) {
+            // Input was lost, drop it all and the partial line with it
+            ESP_LOGE(GATTC_TAG, "UART command input overflow");
+            uart_flush_input(uart_num);
+            xQueueReset(uart_queue);
+            len = 0;
+            overflow = true;
+            continue;
+        }
+        if (event.type != UART_DATA) {
+            continue;
+        }
+        size_t left = event.size;
+        while (left > 0) {
+            int got = uart_read_bytes(uart_num, data,
+                                      left < sizeof(data) ? left : sizeof(data),
+                                      0);
+            if (got <= 0) {
+                break;
+            }
+            left -= got;
+            for (int i = 0; i < got; i++) {
+                char c = data[i];
+                if (c == '\r') {
+                    continue;
+                }
+                if (c == UART_CMD_POLL && len == 0) {
+                    // Snapshot request, answered by the publishing task
+                    xTaskNotify(cmd_publisher, POLL_NOTIFY_BIT, eSetBits);
+                    continue;
+                }
+                if (c != '\n') {
+                    if (len < UART_CMD_MAX_LEN) {
+                        line[len++] = c;
+                    } else {
+                        overflow = true;
+                    }
+                    continue;
+                }
+                // End of command
+                line[len] = '\0';
+                // Keep the command name for the answer, parsing splits line
+                char cmd[4] = {0};
+                size_t cmd_len = strcspn(line, ";");
+                memcpy(cmd, line, cmd_len < 3 ? cmd_len : 3);
+                bool ok = !overflow && exec_uart_cmd(line);
+                if (len > 0 || overflow) {
+                    reply_uart_cmd(cmd, ok);
+                }
+                len = 0;
+                overflow = false;
+            }
+        }
+    }
+}
+
+void uart_cmd_init(QueueHandle_t uart_queue, TaskHandle_t publisher) {
+    cmd_queue = uart_queue;
+    cmd_publisher = publisher;
+    xTaskCreate(uart_cmd_task, "uart_cmd", UART_CMD_STACK_SIZE, NULL,
+                UART_CMD_PRIORITY, NULL);
+}
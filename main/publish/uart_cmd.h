@@ -0,0 +1,83 @@
+/**
+ * @file    uart_cmd.h
+ * @brief   Method prototypes for the UART command channel, which lets the
+ *          device reading the output change what is published at runtime.
+ * 
+ * Commands are ASCII lines sent to the UART port, in the same style as the
+ * output: fields separated by ';' and terminated by '\n' ('\r' is ignored).
+ *  - SUB;<ID>;<0|1>            Stop (0) or start (1) publishing a control. ID
+ *                              is a control identifier such as LJS, or ALL.
+ *  - THR;<ID>;<DZ>;<DELTA>     Set the deadzone and minimum change in raw
+ *                              counts (0-255) of a joystick or trigger.
+ *  - RTE;<ID>;<HZ>             Set the maximum publish rate of a joystick or
+ *                              trigger, 0 for no limit.
+ *  - FMT;<ASC|BIN>             Switch between the ASCII and binary output.
+ *  - MOD;<PSH|POL>             Switch between publishing every change (push)
+ *                              and only publishing snapshots on request (poll).
+ *  - SEQ;<0|1>                 Stop (0) or start (1) numbering output frames.
+ *  - TSU;<NON|ING|LAT>         Add no timestamp, the report arrival time, or
+ *                              the arrival to write latency to output frames.
+ *  - TRC;<OFF|ALS|ONL>         Stop tracing raw notifications, trace them
+ *                              next to the controller output, or instead of
+ *                              it. See trace_fmt.h.
+ *  - HST[;RST]                 Dump the pipeline latency histograms as one
+ *                              "HST;..." line per stage (ASCII output only),
+ *                              or clear them. See lat_hist.h.
+ *  - RAT[;RST]                 Dump the rate and jitter of the controller's
+ *                              reports as a "RAT;..." line (ASCII output
+ *                              only), or clear them. See ble/rate_mon.h.
+ * 
+ * A single '?' byte outside of a command line requests a snapshot of every
+ * published control. It is not answered with ACK or NAK, the snapshot is the
+ * answer. Snapshots can be requested in either mode, and serve as on demand
+ * keyframes in push mode. Requests arriving before
+ * the previous one is answered are answered with a single snapshot.
+ * 
+ * Each command is answered once it has been applied. With the ASCII output the
+ * answer is "ACK;<CMD>\n" or "NAK;<CMD>\n", where CMD is the command's first
+ * field. With the binary output the answer is a BIN_FRAME_ACK or BIN_FRAME_NAK
+ * frame, see bin_proto.h.
+ * 
+ * @version V1.0
+ * @author  Edward Speer
+ * @date    10/16/26
+*/
+
+#ifndef UART_CMD_H
+#define UART_CMD_H
+
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+// Longest command line accepted, not counting the '\n'
+#define UART_CMD_MAX_LEN 32
+
+// Notification bit set on the publishing task when a snapshot is requested.
+// Must differ from the other bits the publishing task waits on.
+#define POLL_NOTIFY_BIT (1u << 2)
+
+// The byte requesting a snapshot
+#define UART_CMD_POLL '?'
+
+/**
+ * @brief Parse and apply one command line.
+ * 
+ * @param line The NUL terminated command, without the '\n'. Modified while
+ *             parsing.
+ * @return true if the command was valid and applied, false otherwise.
+*/
+bool exec_uart_cmd(char* line);
+
+/**
+ * @brief Start the task that reads and answers commands from the UART port.
+ * 
+ * @param uart_queue The event queue created by uart_driver_install for the
+ *                   output UART port.
+ * @param publisher The task publishing the controller state, notified with
+ *                  POLL_NOTIFY_BIT when a snapshot is requested.
+*/
+void uart_cmd_init(QueueHandle_t uart_queue, TaskHandle_t publisher);
+
+#endif /* #ifndef UART_CMD_H */